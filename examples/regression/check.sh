@@ -0,0 +1,57 @@
+#!/bin/sh
+# Regression tests of booster on the small fixtures of this directory (see README.md): make check (in src/)
+# usage: check.sh <booster binary>
+
+BOOSTER=$1
+DIR=$(cd "$(dirname "$0")" && pwd)
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+nb_failed=0
+
+# check <name> <expected output> <output of the command> <command...>: runs the command, and compares its output
+check() {
+  name=$1; expected=$2; output=$3; shift 3
+  if ! "$@" >"$OUT/$name.log" 2>&1; then
+    echo "FAILED $name: the command failed"; cat "$OUT/$name.log"; nb_failed=$((nb_failed + 1))
+  elif ! diff "$expected" "$output" >"$OUT/$name.diff"; then
+    echo "FAILED $name: the output differs from $expected"; head -5 "$OUT/$name.diff"; nb_failed=$((nb_failed + 1))
+  else
+    echo "ok $name"
+  fi
+}
+
+# FBP of the Day intervals (fbp_intervals.c), against the supports of the hashtables it replaced
+check fbp "$DIR/FBP.nw" "$OUT/fbp.nw" "$BOOSTER" -q -a fbp -i "$DIR/ref.nw" -b "$DIR/boot.nw" -o "$OUT/fbp.nw"
+check fbp_threads "$DIR/FBP.nw" "$OUT/fbp_threads.nw" env OMP_NUM_THREADS=4 "$BOOSTER" -q -a fbp -@ 4 -i "$DIR/ref.nw" -b "$DIR/boot.nw" -o "$OUT/fbp_threads.nw"
+
+# shard_and_merge <algo> <output>: the supports of 3 shards of the bootstrap trees, written to partial result files
+# and merged (partial_result.c)
+shard_and_merge() {
+  for i in 0 1 2; do
+    "$BOOSTER" -q -a "$1" --shard $i/3 --partial "$OUT/$1.part$i" -i "$DIR/ref.nw" -b "$DIR/boot.nw" || return 1
+  done
+  "$BOOSTER" -q -a "$1" -i "$DIR/ref.nw" --merge -o "$2" "$OUT/$1.part0" "$OUT/$1.part1" "$OUT/$1.part2"
+}
+
+# TBE and rapid TBE, against the classic TBE of the original booster
+check tbe "$DIR/TBE.nw" "$OUT/tbe.nw" "$BOOSTER" -q -a tbe -i "$DIR/ref.nw" -b "$DIR/boot.nw" -o "$OUT/tbe.nw"
+check rtbe "$DIR/TBE.nw" "$OUT/rtbe.nw" "$BOOSTER" -q -a rtbe -i "$DIR/ref.nw" -b "$DIR/boot.nw" -o "$OUT/rtbe.nw"
+
+# --shard, --partial and --merge give the supports of a single run
+check merge_tbe "$DIR/TBE.nw" "$OUT/merge_tbe.nw" shard_and_merge tbe "$OUT/merge_tbe.nw"
+check merge_rtbe "$DIR/TBE.nw" "$OUT/merge_rtbe.nw" shard_and_merge rtbe "$OUT/merge_rtbe.nw"
+check merge_fbp "$DIR/FBP.nw" "$OUT/merge_fbp.nw" shard_and_merge fbp "$OUT/merge_fbp.nw"
+
+# convert_and_run <algo> <output>: the supports of the bootstrap trees converted to a binary set (booster convert)
+convert_and_run() {
+  "$BOOSTER" convert -q -b "$DIR/boot.nw" -o "$OUT/boot.btr" || return 1
+  "$BOOSTER" -q -a "$1" -i "$DIR/ref.nw" -b "$OUT/boot.btr" -o "$2"
+}
+
+# the binary bootstrap sets give the supports of the text ones
+check convert_tbe "$DIR/TBE.nw" "$OUT/convert_tbe.nw" convert_and_run tbe "$OUT/convert_tbe.nw"
+check convert_rtbe "$DIR/TBE.nw" "$OUT/convert_rtbe.nw" convert_and_run rtbe "$OUT/convert_rtbe.nw"
+check convert_fbp "$DIR/FBP.nw" "$OUT/convert_fbp.nw" convert_and_run fbp "$OUT/convert_fbp.nw"
+
+if [ $nb_failed -gt 0 ]; then echo "$nb_failed regression test(s) failed"; exit 1; fi
+echo "All the regression tests passed"
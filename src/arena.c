@@ -0,0 +1,112 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "arena.h"
+#include "io.h"
+
+#include <string.h>
+#include <stdio.h>
+
+
+static ArenaBlock* arena_new_block(size_t size) {
+	ArenaBlock* block = (ArenaBlock*) malloc(sizeof(ArenaBlock));
+	block->data = (char*) malloc(size);
+	if (block->data == NULL) {
+		fprintf(stderr,"Fatal error: can not allocate %lu bytes. Aborting.\n", (unsigned long) size);
+		Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+	}
+	block->size = size;
+	block->used = 0;
+	block->next = NULL;
+	return block;
+}
+
+
+Arena* arena_new(size_t block_size) {
+	Arena* arena = (Arena*) malloc(sizeof(Arena));
+	arena->block_size = block_size;
+	arena->first = arena->current = arena_new_block(block_size);
+	return arena;
+}
+
+
+void* arena_alloc(Arena* arena, size_t size) {
+	ArenaBlock* block = arena->current;
+	void* result;
+	size = (size + ARENA_ALIGNMENT - 1) & ~((size_t) ARENA_ALIGNMENT - 1);
+
+	if (block->used + size > block->size) {
+		/* moving to the next block, kept from before the last reset, or to a new one if it is too small */
+		if (block->next == NULL || block->next->size < size) {
+			ArenaBlock* new_block = arena_new_block(size > arena->block_size ? size : arena->block_size);
+			new_block->next = block->next;
+			block->next = new_block;
+		}
+		block = arena->current = block->next;
+	}
+	result = block->data + block->used;
+	block->used += size;
+	return result;
+}
+
+
+void* arena_calloc(Arena* arena, size_t nmemb, size_t size) {
+	void* result = arena_alloc(arena, nmemb * size);
+	memset(result, 0, nmemb * size);
+	return result;
+}
+
+
+char* arena_strndup(Arena* arena, const char* str, size_t n) {
+	size_t length = strnlen(str, n);
+	char* result = (char*) arena_alloc(arena, length + 1);
+	memcpy(result, str, length);
+	result[length] = '\0';
+	return result;
+}
+
+
+char* arena_strdup(Arena* arena, const char* str) {
+	return arena_strndup(arena, str, strlen(str));
+}
+
+
+void arena_reset(Arena* arena) {
+	ArenaBlock* block;
+	for (block = arena->first; block != NULL; block = block->next) block->used = 0;
+	arena->current = arena->first;
+}
+
+
+void arena_free(Arena* arena) {
+	ArenaBlock* block = arena->first, *next;
+	while (block != NULL) {
+		next = block->next;
+		free(block->data);
+		free(block);
+		block = next;
+	}
+	free(arena);
+}
@@ -0,0 +1,72 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stdlib.h>
+
+/* A bump allocator: memory is taken from large blocks, and is never given back piece by piece.
+   The whole arena is emptied at once with arena_reset(), which keeps the blocks for the next allocations.
+
+   It is used to build the bootstrap trees: each thread owns an arena in which it parses a tree, and resets
+   it once the tree has been compared to the reference tree. Thus, after the first trees, building a tree
+   doesn't call malloc() anymore, and dropping it is done in constant time.
+   An arena is not thread safe: it must be used by one thread at a time. */
+
+#define ARENA_BLOCK_SIZE	(1 << 22)	/* default size of the blocks */
+#define ARENA_ALIGNMENT		16		/* all the allocations are aligned on this */
+
+typedef struct __ArenaBlock {
+	struct __ArenaBlock* next;
+	size_t size;		/* size of the data */
+	size_t used;		/* number of bytes of data already given */
+	char* data;
+} ArenaBlock;
+
+typedef struct __Arena {
+	ArenaBlock* first;
+	ArenaBlock* current;	/* the block in which we are allocating */
+	size_t block_size;
+} Arena;
+
+Arena* arena_new(size_t block_size);
+
+/* returns size bytes of memory from the arena, valid until arena_reset() or arena_free() */
+void* arena_alloc(Arena* arena, size_t size);
+
+/* same as arena_alloc, memory initialized to 0 */
+void* arena_calloc(Arena* arena, size_t nmemb, size_t size);
+
+/* duplicates the first n chars of str (or less if str is shorter) into the arena */
+char* arena_strndup(Arena* arena, const char* str, size_t n);
+char* arena_strdup(Arena* arena, const char* str);
+
+/* makes all the memory of the arena available again, without freeing its blocks */
+void arena_reset(Arena* arena);
+
+void arena_free(Arena* arena);
+
+#endif /* _ARENA_H_ */
@@ -0,0 +1,370 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+/* Benchmarks of the hot paths of booster, on synthetic reference and bootstrap trees (make bench).
+
+   For each shape, number of taxa and number of threads, a reference tree and a set of bootstrap trees (the
+   reference with perturbed leaves) are generated as NH strings, and the kernels are timed on them:
+     parse_nh          NH parsing of the bootstrap trees (with the taxon ids of their leaves)
+     prepare_rapid_TI  preparation of the parsed trees for the rapid transfer index
+     rapid_ti          compute_transfer_indices_new()
+     classic_ti        transfer distances of the classic TBE (tbe_workspace.h)
+     fbp               FBP found edges (fbp_intervals.h)
+   The results are JSON lines on stdout, one per kernel and setting:
+     {"version":..., "kernel":..., "shape":..., "taxa":..., "threads":..., "pinned":..., "trees":..., "seconds":..., "wall_seconds":...}
+   where seconds is the time spent in the kernel summed over the trees (and threads), and wall_seconds the
+   elapsed time of the whole pass over the trees that runs it. By default the numbers of threads are the
+   powers of 2 up to the number of cpus, so that the wall times give the scaling curve; with -N the threads
+   are pinned to the NUMA nodes as with booster --numa. */
+
+#include "tree.h"
+#include "rapid_transfer.h"
+#include "fbp_intervals.h"
+#include "tbe_workspace.h"
+#include "numa.h"
+#include <omp.h>
+#include <getopt.h>
+
+/* the shapes of the synthetic trees */
+enum { SHAPE_CATERPILLAR, SHAPE_BALANCED, SHAPE_RANDOM, SHAPE_ROGUES, NB_SHAPES };
+static const char *shape_names[NB_SHAPES] = { "caterpillar", "balanced", "random", "rogues" };
+
+/* with -N, the NUMA nodes on which the threads of the kernels are pinned */
+static NumaTopology *numa = NULL;
+
+/* a growing NH string */
+typedef struct {
+  char *s;
+  int length;
+  int capacity;
+} NHString;
+
+static void nh_append(NHString *nh, const char *str){
+  int l = strlen(str);
+  if(nh->length + l + 1 > nh->capacity){
+    nh->capacity = 2 * (nh->length + l + 1);
+    nh->s = (char*) realloc(nh->s, nh->capacity);
+  }
+  memcpy(nh->s + nh->length, str, l + 1);
+  nh->length += l;
+}
+
+static void nh_append_leaf(NHString *nh, int taxon){
+  char name[32];
+  sprintf(name, "t%d:0.01", taxon);
+  nh_append(nh, name);
+}
+
+/* splitmix64: the benchmarks do not depend on the state of the prng of booster */
+static unsigned long long bench_rand(unsigned long long *state){
+  unsigned long long x = (*state += 0x9E3779B97F4A7C15ULL);
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+/* the clade of the leaves leaves[lo..hi-1]: split in halves (balanced), or at a random point (random, the
+   state being the same for all the trees of a set, so that they share their shape) */
+static void nh_clade(NHString *nh, const int *leaves, int lo, int hi, bool random, unsigned long long *state){
+  if(hi - lo == 1){ nh_append_leaf(nh, leaves[lo]); return; }
+  int mid = random ? lo + 1 + (int) (bench_rand(state) % (hi - lo - 1)) : (lo + hi) / 2;
+  nh_append(nh, "(");
+  nh_clade(nh, leaves, lo, mid, random, state);
+  nh_append(nh, ",");
+  nh_clade(nh, leaves, mid, hi, random, state);
+  nh_append(nh, "):0.01");
+}
+
+/* the NH string of the tree of the given shape on the n leaves, in this order */
+static char* gen_nh_tree(int shape, const int *leaves, int n, unsigned long long shape_seed){
+  NHString nh = { NULL, 0, 0 };
+  int i;
+  nh_append(&nh, "");
+  if(shape == SHAPE_CATERPILLAR){
+    /* ((((t0,t1),t2),t3),...): built iteratively, it is as deep as the number of taxa */
+    for(i = 0; i < n - 1; i++) nh_append(&nh, "(");
+    nh_append_leaf(&nh, leaves[0]);
+    for(i = 1; i < n; i++){
+      nh_append(&nh, ",");
+      nh_append_leaf(&nh, leaves[i]);
+      nh_append(&nh, i < n - 1 ? "):0.01" : ")");
+    }
+  }else{
+    unsigned long long state = shape_seed;
+    int mid = n / 2;
+    if(shape == SHAPE_RANDOM) mid = 1 + (int) (bench_rand(&state) % (n - 1));
+    nh_append(&nh, "(");
+    nh_clade(&nh, leaves, 0, mid, shape == SHAPE_RANDOM, &state);
+    nh_append(&nh, ",");
+    nh_clade(&nh, leaves, mid, n, shape == SHAPE_RANDOM, &state);
+    nh_append(&nh, ")");
+  }
+  nh_append(&nh, ";");
+  return nh.s;
+}
+
+/* a bootstrap tree: the shape of the reference, whose leaves are perturbed by n/10 swaps of neighbours in
+   the order of the leaves, and for the rogues shape by moving n/20 taxa to random places */
+static char* gen_nh_boot_tree(int shape, int n, unsigned long long shape_seed, unsigned long long *state){
+  int *leaves = (int*) malloc(n * sizeof(int));
+  int i, j, tmp;
+  char *nh;
+  for(i = 0; i < n; i++) leaves[i] = i;
+  for(i = 0; i < n / 10; i++){
+    j = (int) (bench_rand(state) % (n - 1));
+    tmp = leaves[j]; leaves[j] = leaves[j + 1]; leaves[j + 1] = tmp;
+  }
+  if(shape == SHAPE_ROGUES)
+    for(i = 0; i < n / 20 + 1; i++){
+      int from = (int) (bench_rand(state) % n), to = (int) (bench_rand(state) % n);
+      int rogue = leaves[from];
+      if(from < to) memmove(leaves + from, leaves + from + 1, (to - from) * sizeof(int));
+      else memmove(leaves + to + 1, leaves + to, (from - to) * sizeof(int));
+      leaves[to] = rogue;
+    }
+  nh = gen_nh_tree(shape, leaves, n, shape_seed);
+  free(leaves);
+  return nh;
+}
+
+
+/* parses s in the arena (reset first), with the taxon ids of the leaves */
+static Tree* bench_parse(char *s, Arena *arena, char **taxname_lookup_table, map_t taxid_map){
+  arena_reset(arena);
+  Tree *tree = parse_nh_buffer(s, strlen(s), arena);
+  tree->taxname_lookup_table = taxname_lookup_table;
+  set_leaf_taxon_ids(tree, taxid_map);
+  return tree;
+}
+
+static void print_result(const char *kernel, int shape, int n, int threads, int nb_trees, double seconds, double wall){
+  printf("{\"version\":\"%s\", \"kernel\":\"%s\", \"shape\":\"%s\", \"taxa\":%d, \"threads\":%d, \"pinned\":%s, \"trees\":%d, \"seconds\":%.6f, \"wall_seconds\":%.6f}\n",
+         VERSION, kernel, shape_names[shape], n, threads, numa ? "true" : "false", nb_trees, seconds, wall);
+  fflush(stdout);
+}
+
+/* times the kernels on one setting */
+static void bench_setting(int shape, int n, int threads, int nb_trees, int classic_max, unsigned long long seed){
+  unsigned long long state = seed, shape_seed = bench_rand(&state);
+  int *leaves = (int*) malloc(n * sizeof(int));
+  char **boot = (char**) malloc(nb_trees * sizeof(char*));
+  char **taxname_lookup_table = NULL;
+  int i;
+  for(i = 0; i < n; i++) leaves[i] = i;
+  char *ref_string = gen_nh_tree(shape, leaves, n, shape_seed);
+  for(i = 0; i < nb_trees; i++) boot[i] = gen_nh_boot_tree(shape, n, shape_seed, &state);
+  free(leaves);
+
+  bool classic = n <= classic_max;
+  Tree *ref_tree = complete_parse_nh_buffer(ref_string, strlen(ref_string), &taxname_lookup_table, NULL, !classic, NULL);
+  map_t taxid_map = build_taxid_hashmap(taxname_lookup_table, n);
+  int m = ref_tree->nb_edges;
+  double t_parse = 0, t_prepare = 0, t_rapid = 0, t_classic = 0, t_fbp = 0, wall, start;
+  omp_set_num_threads(threads);
+
+  /* rapid TBE: parsing, preparation and transfer indices */
+  start = omp_get_wtime();
+  #pragma omp parallel reduction(+:t_parse, t_prepare, t_rapid)
+  {
+  NumaAffinity *saved = NULL; /* given back at the end of the region: the next ones pin the threads again */
+  if(numa) numa_pin_thread(numa, omp_get_thread_num(), omp_get_num_threads(), &saved);
+  Arena *arena = arena_new(ARENA_BLOCK_SIZE);
+  RapidTIContext *ctx = new_rapidTI_context(ref_tree);
+  int *ti = (int*) malloc(m * sizeof(int));
+  #pragma omp for schedule(dynamic)
+  for(i = 0; i < nb_trees; i++){
+    double t0 = omp_get_wtime();
+    Tree *alt_tree = bench_parse(boot[i], arena, taxname_lookup_table, taxid_map);
+    double t1 = omp_get_wtime();
+    prepare_rapid_TI(alt_tree);
+    double t2 = omp_get_wtime();
+    compute_transfer_indices_new(ref_tree, n, m, alt_tree, ti, ctx);
+    double t3 = omp_get_wtime();
+    t_parse += t1 - t0; t_prepare += t2 - t1; t_rapid += t3 - t2;
+    free_tree(alt_tree);
+  }
+  free(ti);
+  free_rapidTI_context(ctx);
+  arena_free(arena);
+  numa_unpin_thread(saved);
+  }
+  wall = omp_get_wtime() - start;
+  print_result("parse_nh", shape, n, threads, nb_trees, t_parse, wall);
+  print_result("prepare_rapid_TI", shape, n, threads, nb_trees, t_prepare, wall);
+  print_result("rapid_ti", shape, n, threads, nb_trees, t_rapid, wall);
+
+  /* classic TBE: its matrices are quadratic in the number of taxa */
+  if(classic){
+    start = omp_get_wtime();
+    #pragma omp parallel reduction(+:t_classic)
+    {
+    NumaAffinity *saved = NULL;
+    if(numa) numa_pin_thread(numa, omp_get_thread_num(), omp_get_num_threads(), &saved);
+    Arena *arena = arena_new(ARENA_BLOCK_SIZE);
+    TBEWorkspace *ws = new_tbe_workspace(ref_tree, 2 * n - 2);
+    #pragma omp for schedule(dynamic)
+    for(i = 0; i < nb_trees; i++){
+      arena_reset(arena);
+      Tree *alt_tree = complete_parse_nh_buffer(boot[i], strlen(boot[i]), &taxname_lookup_table, taxid_map, false, arena);
+      double t0 = omp_get_wtime();
+      tbe_min_distances(ws, ref_tree, alt_tree);
+      t_classic += omp_get_wtime() - t0;
+      free_tree(alt_tree);
+    }
+    free_tbe_workspace(ws);
+    arena_free(arena);
+    numa_unpin_thread(saved);
+    }
+    print_result("classic_ti", shape, n, threads, nb_trees, t_classic, omp_get_wtime() - start);
+  }
+
+  /* FBP */
+  FBPWorkspace *ref_ws = new_fbp_workspace(ref_tree->nb_nodes);
+  FBPIndex *index = new_fbp_index(ref_tree, ref_ws);
+  free_fbp_workspace(ref_ws);
+  start = omp_get_wtime();
+  #pragma omp parallel reduction(+:t_fbp)
+  {
+  NumaAffinity *saved = NULL;
+  if(numa) numa_pin_thread(numa, omp_get_thread_num(), omp_get_num_threads(), &saved);
+  Arena *arena = arena_new(ARENA_BLOCK_SIZE);
+  FBPWorkspace *ws = new_fbp_workspace(ref_tree->nb_nodes);
+  int *found = (int*) malloc(2 * n * sizeof(int));
+  #pragma omp for schedule(dynamic)
+  for(i = 0; i < nb_trees; i++){
+    Tree *alt_tree = bench_parse(boot[i], arena, taxname_lookup_table, taxid_map);
+    double t0 = omp_get_wtime();
+    fbp_found_edges(index, alt_tree, ws, found);
+    t_fbp += omp_get_wtime() - t0;
+    free_tree(alt_tree);
+  }
+  free(found);
+  free_fbp_workspace(ws);
+  arena_free(arena);
+  numa_unpin_thread(saved);
+  }
+  print_result("fbp", shape, n, threads, nb_trees, t_fbp, omp_get_wtime() - start);
+  free_fbp_index(index);
+
+  free_tree(ref_tree);
+  free(ref_string);
+  for(i = 0; i < nb_trees; i++) free(boot[i]);
+  free(boot);
+  free_taxid_hashmap(taxid_map);
+  for(i = 0; i < n; i++) free(taxname_lookup_table[i]);
+  free(taxname_lookup_table);
+}
+
+
+/* parses a comma separated list of positive ints into *values, returns their number */
+static int parse_int_list(const char *arg, int **values){
+  char *copy = strdup(arg), *tok;
+  int nb = 0;
+  *values = NULL;
+  for(tok = strtok(copy, ","); tok != NULL; tok = strtok(NULL, ",")){
+    int v = strtol(tok, NULL, 10);
+    if(v < 1){
+      fprintf(stderr,"%s is not a list of positive numbers\n", arg);
+      Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+    }
+    *values = (int*) realloc(*values, (nb + 1) * sizeof(int));
+    (*values)[nb++] = v;
+  }
+  free(copy);
+  return nb;
+}
+
+void bench_usage(FILE *out, char *name){
+  fprintf(out,"Usage: %s [-n <taxa list>] [-t <threads list>] [-b <nb trees>] [-s <shapes list>] [-c <max taxa>] [-r <seed>] [-N]\n", name);
+  fprintf(out,"Options:\n");
+  fprintf(out,"      -n : Numbers of taxa (default 100,1000,10000)\n");
+  fprintf(out,"      -t : Numbers of threads (default the powers of 2 up to the number of cpus, and this number)\n");
+  fprintf(out,"      -b : Number of bootstrap trees per setting (default 10)\n");
+  fprintf(out,"      -s : Shapes, among caterpillar,balanced,random,rogues (default all)\n");
+  fprintf(out,"      -c : Largest number of taxa for the classic TBE, whose memory is quadratic (default 2000)\n");
+  fprintf(out,"      -r : Seed of the synthetic trees (default 1)\n");
+  fprintf(out,"      -N : Pins the threads to the cpus of the NUMA nodes, in blocks (as booster --numa)\n");
+  fprintf(out,"      -h : Prints this help\n");
+  fprintf(out,"The results are JSON lines on stdout, one per kernel and setting.\n");
+}
+
+int main(int argc, char **argv){
+  int default_taxa[] = { 100, 1000, 10000 };
+  int *taxa = default_taxa, *threads = NULL;
+  int nb_taxa = 3, nb_threads = 0, nb_procs = omp_get_num_procs();
+  int nb_trees = 10, classic_max = 2000;
+  bool shapes[NB_SHAPES] = { true, true, true, true };
+  unsigned long long seed = 1;
+  int c, i, j, s;
+
+  /* the scaling curve: 1, 2, 4, ... and the number of cpus */
+  for(i = 1; ; i *= 2){
+    threads = (int*) realloc(threads, (nb_threads + 1) * sizeof(int));
+    threads[nb_threads++] = i < nb_procs ? i : nb_procs;
+    if(i >= nb_procs) break;
+  }
+
+  while ((c = getopt(argc, argv, "n:t:b:s:c:r:Nh")) != -1){
+    switch (c){
+    case 'n':
+      if(taxa != default_taxa) free(taxa);
+      nb_taxa = parse_int_list(optarg, &taxa);
+      break;
+    case 't':
+      free(threads);
+      nb_threads = parse_int_list(optarg, &threads);
+      break;
+    case 'b': nb_trees = strtol(optarg, NULL, 10); break;
+    case 'c': classic_max = strtol(optarg, NULL, 10); break;
+    case 'r': seed = strtoull(optarg, NULL, 10); break;
+    case 'N': if(numa == NULL) numa = numa_detect(); break;
+    case 's':
+      for(s = 0; s < NB_SHAPES; s++) shapes[s] = strstr(optarg, shape_names[s]) != NULL;
+      break;
+    case 'h': bench_usage(stdout, argv[0]); return EXIT_SUCCESS;
+    default: bench_usage(stderr, argv[0]); return EXIT_FAILURE;
+    }
+  }
+  if(nb_trees < 1){
+    fprintf(stderr,"The number of bootstrap trees must be positive\n");
+    return EXIT_FAILURE;
+  }
+  for(i = 0; i < nb_taxa; i++)
+    if(taxa[i] < 4){
+      fprintf(stderr,"The trees must have at least 4 taxa\n");
+      return EXIT_FAILURE;
+    }
+
+  for(s = 0; s < NB_SHAPES; s++){
+    if(!shapes[s]) continue;
+    for(i = 0; i < nb_taxa; i++)
+      for(j = 0; j < nb_threads; j++)
+        bench_setting(s, taxa[i], threads[j], nb_trees, classic_max, seed);
+  }
+  if(taxa != default_taxa) free(taxa);
+  free(threads);
+  free_numa_topology(numa);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,291 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "bin_trees.h"
+#include <math.h>
+
+/* size of the record of a tree of nb_nodes nodes (see bin_trees.h) */
+static size_t bin_record_size(int nb_nodes) {
+	size_t size = 2 * sizeof(int32_t) + nb_nodes * (sizeof(double) + 2 * sizeof(int32_t) + sizeof(uint8_t));
+	return (size + 7) & ~((size_t) 7);
+}
+
+/* the trees loaded in an arena have all their structures allocated in it (see free_tree) */
+static inline void* bin_malloc(Arena* arena, size_t size) {
+	return (arena ? arena_alloc(arena, size) : malloc(size));
+}
+
+static void bin_write(BinTreesWriter* writer, const void* data, size_t size) {
+	if (size > 0 && fwrite(data, 1, size, writer->file) != size) {
+		fprintf(stderr,"Fatal error: can not write the binary bootstrap set. Aborting.\n");
+		Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+	}
+	writer->offset += size;
+}
+
+
+BinTreesWriter* new_bin_trees_writer(const char* filename) {
+	NHBinaryHeader header;
+	FILE* file = fopen(filename, "wb");
+	if (file == NULL) return NULL;
+	BinTreesWriter* writer = (BinTreesWriter*) calloc(1, sizeof(BinTreesWriter));
+	writer->file = file;
+	writer->name_ids = hashmap_new();
+	/* the header is only known at the end: its room is kept, and it is written by close_bin_trees_writer() */
+	memset(&header, 0, sizeof(NHBinaryHeader));
+	bin_write(writer, &header, sizeof(NHBinaryHeader));
+	return writer;
+} /* end new_bin_trees_writer */
+
+
+/* index of name in the table of the names of the set, where it is added if needed */
+static int bin_name_id(BinTreesWriter* writer, char* name) {
+	int* id;
+	if (hashmap_get(writer->name_ids, name, (any_t*) &id) == MAP_OK) return *id;
+	if (writer->nb_names == writer->names_capacity) {
+		writer->names_capacity = (writer->names_capacity == 0 ? 1024 : 2 * writer->names_capacity);
+		writer->names = (char**) realloc(writer->names, writer->names_capacity * sizeof(char*));
+	}
+	writer->names[writer->nb_names] = strdup(name);
+	id = (int*) malloc(sizeof(int));
+	*id = writer->nb_names;
+	hashmap_put(writer->name_ids, writer->names[writer->nb_names], id);
+	return writer->nb_names++;
+} /* end bin_name_id */
+
+
+void bin_trees_write(BinTreesWriter* writer, Tree* tree) {
+	int i, j, n = tree->nb_nodes;
+	size_t size = bin_record_size(n);
+	if (size > writer->record_capacity) {
+		writer->record_capacity = 2 * size;
+		writer->record = (char*) realloc(writer->record, writer->record_capacity);
+	}
+	memset(writer->record, 0, size);
+	int32_t* header = (int32_t*) writer->record;
+	double* brlen = (double*) (header + 2);
+	int32_t* father = (int32_t*) (brlen + n);
+	int32_t* taxon = father + n;
+	uint8_t* had_zero_length = (uint8_t*) (taxon + n);
+
+	header[0] = n;
+	header[1] = tree->nb_taxa;
+	for (i = 0; i < n; i++) {
+		Node* node = tree->a_nodes[i];
+		int first_son = (i == 0 ? 0 : 1);
+		/* the loader rebuilds the structure from the fathers, as the parser gives it */
+		if (node->id != i || (i > 0 && (node->neigh[0]->id >= i || node->br[0]->id != i-1))) {
+			fprintf(stderr,"Fatal error: the nodes of the tree are not numbered as by the parser. Aborting.\n");
+			Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+		}
+		for (j = first_son + 1; j < node->nneigh; j++) if (node->neigh[j]->id < node->neigh[j-1]->id) {
+			fprintf(stderr,"Fatal error: the nodes of the tree are not numbered as by the parser. Aborting.\n");
+			Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+		}
+		father[i] = (i == 0 ? -1 : node->neigh[0]->id);
+		brlen[i] = (i == 0 ? 0.0 : node->br[0]->brlen);
+		had_zero_length[i] = (i == 0 ? 0 : (uint8_t) node->br[0]->had_zero_length);
+		taxon[i] = (i > 0 && node->nneigh == 1 ? bin_name_id(writer, node->name) : -1);
+	}
+
+	if (writer->nb_trees + 1 >= writer->index_capacity) {
+		writer->index_capacity = (writer->index_capacity == 0 ? 1024 : 2 * writer->index_capacity);
+		writer->index = (int64_t*) realloc(writer->index, writer->index_capacity * sizeof(int64_t));
+	}
+	writer->index[writer->nb_trees++] = writer->offset;
+	bin_write(writer, writer->record, size);
+} /* end bin_trees_write */
+
+
+void close_bin_trees_writer(BinTreesWriter* writer) {
+	int i;
+	NHBinaryHeader header;
+	static const char padding[8] = { 0 };
+
+	/* the end of the last record closes the index */
+	if (writer->index == NULL) writer->index = (int64_t*) malloc(sizeof(int64_t));
+	writer->index[writer->nb_trees] = writer->offset;
+
+	memcpy(header.magic, NH_BINARY_MAGIC, 4);
+	header.version = NH_BINARY_VERSION;
+	header.nb_names = writer->nb_names;
+	header.nb_trees = writer->nb_trees;
+	header.names_offset = writer->offset;
+	for (i = 0; i < writer->nb_names; i++) bin_write(writer, writer->names[i], strlen(writer->names[i]) + 1);
+	bin_write(writer, padding, (8 - writer->offset % 8) % 8);
+	header.index_offset = writer->offset;
+	bin_write(writer, writer->index, (writer->nb_trees + 1) * sizeof(int64_t));
+
+	if (fseek(writer->file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(NHBinaryHeader), 1, writer->file) != 1
+	    || fclose(writer->file) != 0) {
+		fprintf(stderr,"Fatal error: can not write the binary bootstrap set. Aborting.\n");
+		Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+	}
+
+	for (i = 0; i < writer->nb_names; i++) free(writer->names[i]);
+	free(writer->names);
+	free_taxid_hashmap(writer->name_ids);
+	free(writer->index);
+	free(writer->record);
+	free(writer);
+} /* end close_bin_trees_writer */
+
+
+BinTaxa* new_bin_taxa(const NHReader* reader, map_t taxid_map) {
+	int i;
+	int* taxon_id;
+	char** names;
+	int nb_names = nh_reader_binary_names(reader, &names);
+	if (nb_names < 0) return NULL;
+	BinTaxa* taxa = (BinTaxa*) malloc(sizeof(BinTaxa));
+	taxa->nb_names = nb_names;
+	taxa->names = names;
+	taxa->taxon_ids = (int*) malloc(nb_names * sizeof(int));
+	for (i = 0; i < nb_names; i++)
+		taxa->taxon_ids[i] = (hashmap_get(taxid_map, names[i], (any_t*) &taxon_id) == MAP_OK ? *taxon_id : -1);
+	return taxa;
+} /* end new_bin_taxa */
+
+
+void free_bin_taxa(BinTaxa* taxa) {
+	if (taxa == NULL) return;
+	free(taxa->names);
+	free(taxa->taxon_ids);
+	free(taxa);
+}
+
+
+/* checks the structure of a record before anything is built from it: the fathers come before their sons,
+   and the leaves are exactly nb_leaves, with distinct names of the table. Counts the sons of each node. */
+static bool check_bin_record(int nb_nodes, int nb_leaves, const int32_t* father, const int32_t* taxon,
+			     int nb_names, int* nb_sons) {
+	int k, leaves = 0;
+	bool ok = (father[0] == -1);
+	for (k = 0; k < nb_nodes; k++) nb_sons[k] = 0;
+	for (k = 1; k < nb_nodes && ok; k++) {
+		if (father[k] < 0 || father[k] >= k) ok = false;
+		else nb_sons[father[k]]++;
+	}
+	if (!ok || nb_sons[0] < 2) return false;
+
+	char* seen = (char*) calloc(nb_names > 0 ? nb_names : 1, sizeof(char));
+	for (k = 1; k < nb_nodes && ok; k++) {
+		if (nb_sons[k] > 0) continue;
+		leaves++;
+		if (taxon[k] < 0 || taxon[k] >= nb_names || seen[taxon[k]]) ok = false;
+		else seen[taxon[k]] = 1;
+	}
+	free(seen);
+	return ok && leaves == nb_leaves;
+} /* end check_bin_record */
+
+
+Tree* load_bin_tree(const char* record, int length, const BinTaxa* taxa, bool skip_hashtables, Arena* arena) {
+	int32_t nb_nodes, nb_leaves;
+	int k, max_nodes, max_edges;
+	if (length < 2 * (int) sizeof(int32_t)) return NULL;
+	memcpy(&nb_nodes, record, sizeof(int32_t));
+	memcpy(&nb_leaves, record + sizeof(int32_t), sizeof(int32_t));
+	if (nb_leaves < 2 || nb_nodes <= nb_leaves || bin_record_size(nb_nodes) > (size_t) length) {
+		fprintf(stderr,"Error: corrupted record in the binary bootstrap set.\n");
+		return NULL;
+	}
+	/* the records are 8-byte aligned in the mapping */
+	const double* brlen = (const double*) (record + 2 * sizeof(int32_t));
+	const int32_t* father = (const int32_t*) (brlen + nb_nodes);
+	const int32_t* taxon = father + nb_nodes;
+	const uint8_t* had_zero_length = (const uint8_t*) (taxon + nb_nodes);
+
+	int* nb_sons = (int*) malloc(nb_nodes * sizeof(int));
+	if (!check_bin_record(nb_nodes, nb_leaves, father, taxon, taxa->nb_names, nb_sons)) {
+		fprintf(stderr,"Error: corrupted record in the binary bootstrap set.\n");
+		free(nb_sons);
+		return NULL;
+	}
+
+	/* the same sizes as in parse_nh_buffer() */
+	max_nodes = (nb_nodes > 2*nb_leaves-1 ? nb_nodes : 2*nb_leaves-1);
+	max_edges = (nb_nodes-1 > 2*nb_leaves-2 ? nb_nodes-1 : 2*nb_leaves-2);
+	Tree* t = (Tree*) bin_malloc(arena, sizeof(Tree));
+	t->arena = arena;
+	t->nb_taxa = nb_leaves;
+	t->leaves = allocateLA_in_arena(arena, nb_leaves);
+	t->a_nodes = (Node**) (arena ? arena_calloc(arena, max_nodes, sizeof(Node*)) : calloc(max_nodes, sizeof(Node*)));
+	t->a_edges = (Edge**) (arena ? arena_calloc(arena, max_edges, sizeof(Edge*)) : calloc(max_edges, sizeof(Edge*)));
+	t->nb_nodes = nb_nodes;
+	t->nb_edges = nb_nodes - 1;
+	t->taxa_names = (char**) bin_malloc(arena, nb_leaves * sizeof(char*));
+	t->length_hashtables = (int) (nb_leaves / ceil(log10((double)nb_leaves)));
+	t->taxname_lookup_table = NULL;
+	t->post_order = t->post_order_from = NULL;
+	t->next_avail_node_id = nb_nodes;
+	t->next_avail_edge_id = nb_nodes - 1;
+	t->next_avail_taxon_id = 0;
+
+	/* the nodes are created in pre-order: the father of a node, and its neighbour arrays, already exist.
+	   nb_sons is reused to count the directions already filled */
+	for (k = 0; k < nb_nodes; k++) {
+		Node* node = (Node*) bin_malloc(arena, sizeof(Node));
+		node->id = k;
+		node->taxon_id = -1;
+		node->name = node->comment = NULL;
+		node->mheight = MAX_MHEIGHT;
+		node->nneigh = (k == 0 ? nb_sons[0] : nb_sons[k] + 1); /* the sons plus the father */
+		node->neigh = (Node**) bin_malloc(arena, node->nneigh * sizeof(Node*));
+		node->br = (Edge**) bin_malloc(arena, node->nneigh * sizeof(Edge*));
+		t->a_nodes[k] = node;
+		nb_sons[k] = (k == 0 ? 0 : 1); /* the root has no father: its sons start at direction 0 */
+		if (k == 0) { t->node0 = node; continue; }
+
+		Node* father_node = t->a_nodes[father[k]];
+		Edge* edge = (Edge*) bin_malloc(arena, sizeof(Edge));
+		edge->id = k-1;
+		edge->left = father_node;
+		edge->right = node;
+		edge->brlen = brlen[k];
+		edge->had_zero_length = had_zero_length[k];
+		edge->has_branch_support = 0;
+		edge->hashtbl[0] = edge->hashtbl[1] = NULL;
+		edge->subtype_counts[0] = edge->subtype_counts[1] = NULL;
+		t->a_edges[k-1] = edge;
+
+		int direction = nb_sons[father[k]]++;
+		father_node->neigh[direction] = node;
+		father_node->br[direction] = edge;
+		node->neigh[0] = father_node;
+		node->br[0] = edge;
+
+		if (node->nneigh == 1) { /* leaf */
+			char* name = taxa->names[taxon[k]];
+			node->name = (arena ? name : strdup(name)); /* the names of an arena tree are never freed */
+			node->taxon_id = taxa->taxon_ids[taxon[k]];
+			t->taxa_names[t->next_avail_taxon_id++] = (arena ? name : strdup(name));
+		}
+	}
+	free(nb_sons);
+
+	prepare_parsed_tree(t, skip_hashtables);
+	return t;
+} /* end load_bin_tree */
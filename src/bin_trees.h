@@ -0,0 +1,88 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef _BIN_TREES_H_
+#define _BIN_TREES_H_
+
+#include "tree.h"
+#include "nh_reader.h"
+
+/* Binary bootstrap sets (booster convert).
+
+   A binary bootstrap set holds already parsed bootstrap trees, so that a set analysed many times (e.g.
+   against several reference trees) is only parsed once: its trees are handed out by an NHReader as
+   records in the mapped file (see nh_reader.h for the layout of the file), and load_bin_tree() builds
+   the Tree of a record with no text to scan and no taxon name to look up.
+
+   The record of a tree gives its nodes in the pre-order of the parser (the node ids, the edge above
+   node k being edge k-1), a father always coming before its sons and the sons of a node in the order
+   of their directions:
+	int32	nb_nodes, nb_leaves
+	double	brlen[nb_nodes]		length of the edge above each node (unused for the root)
+	int32	father[nb_nodes]	-1 for the root
+	int32	taxon[nb_nodes]		index of the name of each leaf in the table of the file, -1 for the internal nodes
+	uint8	had_zero_length[nb_nodes]
+   padded to a multiple of 8 bytes. The names of the internal nodes (the supports of the bootstrap trees)
+   are not kept. */
+
+typedef struct __BinTreesWriter {
+	FILE* file;
+	int64_t offset;		/* where the next record begins */
+	int nb_trees;
+	int64_t* index;		/* offsets of the records written so far */
+	int index_capacity;
+	char** names;		/* table of the taxa names: the names of the first tree, then the new ones of the next trees */
+	int nb_names;
+	int names_capacity;
+	map_t name_ids;		/* index in names of each name */
+	char* record;		/* buffer of the record being written */
+	size_t record_capacity;
+} BinTreesWriter;
+
+/* the taxa of a binary bootstrap set, matched with the taxa of the reference trees */
+typedef struct __BinTaxa {
+	int nb_names;
+	char** names;		/* the table of the names of the set, pointing into its mapping */
+	int* taxon_ids;		/* taxon id of each name in the taxname lookup table of the reference trees, -1 if it is not in it */
+} BinTaxa;
+
+/* creates the binary bootstrap set filename. Returns NULL if the file can not be created. */
+BinTreesWriter* new_bin_trees_writer(const char* filename);
+/* appends the record of tree, a tree as given by the parser */
+void bin_trees_write(BinTreesWriter* writer, Tree* tree);
+/* writes the table of the names, the index and the header of the set, and closes it */
+void close_bin_trees_writer(BinTreesWriter* writer);
+
+/* the taxa of the binary bootstrap set read by reader, matched with the taxon ids of taxid_map (see
+   build_taxid_hashmap). Returns NULL if reader does not read a binary bootstrap set. */
+BinTaxa* new_bin_taxa(const NHReader* reader, map_t taxid_map);
+void free_bin_taxa(BinTaxa* taxa);
+
+/* builds the tree of the record[0..length-1] of a binary bootstrap set (as given by nh_reader_next), with
+   the same structure as complete_parse_nh_buffer() gives for its NH string, in arena if it is not NULL.
+   Returns NULL if the record is corrupted. */
+Tree* load_bin_tree(const char* record, int length, const BinTaxa* taxa, bool skip_hashtables, Arena* arena);
+
+#endif /* _BIN_TREES_H_ */
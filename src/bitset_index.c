@@ -115,35 +115,11 @@ void bitset_hashmap_putvalue(bitset_hashmap *hm, id_hash_table_t *bitset, int nb
 }
 
 // Computes a hash code for the bitset associated to an edge
+// It is computed on whole words, and is the same for the
+// two sides of the edge (a bitset and its complement), so
+// that an edge is kind of "unique"
 int bitset_hashcode(id_hash_table_t *hashtable, int nb_taxa){
-  int hashCodeSet  = 1;
-  int hashCodeUnset  = 1;
-  int hashCodeAll = 1;
-  int nbset = 0;
-  int nbunset = 0;
-  int bit;
-  for (bit = 0; bit < nb_taxa; bit++) {
-    if (lookup_id(hashtable, bit)){
-      hashCodeSet = 31*hashCodeSet + bit;
-      nbset++;
-    } else {
-      hashCodeUnset = 31*hashCodeUnset + bit;
-      nbunset++;
-    }
-    hashCodeAll = 31*hashCodeAll + bit;
-  }
-  // If the number of species on the left is the same
-  // than the number of species on the right
-  // We return the hashcode of the all species
-  // Otherwise, we return the hashcode for the minimum
-  // between left and right
-  // Allows an edge to be kind of "unique"
-  if(nbset == nbunset){
-    return hashCodeAll;
-  } else if(nbset < nbunset){
-    return hashCodeSet;
-  }
-  return hashCodeUnset;
+  return (int) bitset_hash(hashtable->bitarray, nb_taxa);
 }
 
 // HashCode for an edge bitset.
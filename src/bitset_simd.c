@@ -0,0 +1,304 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "bitset_simd.h"
+
+#include <limits.h>
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#define BITSET_X86
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define BITSET_NEON
+#include <arm_neon.h>
+#endif
+
+#define WORD_BITS (CHAR_BIT * sizeof(unsigned long))
+
+
+/* mask of the meaningful bits of the last word, for a bitset of nbits bits */
+static inline unsigned long last_word_mask(int nbits) {
+	int r = nbits % WORD_BITS;
+	return r ? ((1UL << r) - 1) : ~0UL;
+}
+
+static inline int nb_words(int nbits) {
+	return nbits / WORD_BITS + (nbits % WORD_BITS != 0);
+}
+
+
+/* KERNELS: count the bits of (a XOR b) and (a AND NOT b) on nwords whole words */
+
+typedef struct {
+	const char* name;
+	int (*xor_count)(const unsigned long* a, const unsigned long* b, int nwords);
+	int (*andnot_count)(const unsigned long* a, const unsigned long* b, int nwords);
+} bitset_kernels;
+
+
+static int xor_count_scalar(const unsigned long* a, const unsigned long* b, int nwords) {
+	int i, count = 0;
+	for (i = 0; i < nwords; i++) count += __builtin_popcountl(a[i] ^ b[i]);
+	return count;
+}
+
+static int andnot_count_scalar(const unsigned long* a, const unsigned long* b, int nwords) {
+	int i, count = 0;
+	for (i = 0; i < nwords; i++) count += __builtin_popcountl(a[i] & ~b[i]);
+	return count;
+}
+
+
+#ifdef BITSET_X86
+
+/* same as the scalar ones, compiled to the popcnt instruction */
+__attribute__((target("popcnt")))
+static int xor_count_popcnt(const unsigned long* a, const unsigned long* b, int nwords) {
+	int i, count = 0;
+	for (i = 0; i < nwords; i++) count += __builtin_popcountl(a[i] ^ b[i]);
+	return count;
+}
+
+__attribute__((target("popcnt")))
+static int andnot_count_popcnt(const unsigned long* a, const unsigned long* b, int nwords) {
+	int i, count = 0;
+	for (i = 0; i < nwords; i++) count += __builtin_popcountl(a[i] & ~b[i]);
+	return count;
+}
+
+/* bits count of each 64 bits lane of v: the bytes are counted by table lookup on their two halves (W. Mula) */
+__attribute__((target("avx2")))
+static inline __m256i popcount_lanes_avx2(__m256i v) {
+	const __m256i lookup = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4, 0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+	const __m256i low_mask = _mm256_set1_epi8(0x0f);
+	__m256i lo = _mm256_and_si256(v, low_mask);
+	__m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+	__m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+	return _mm256_sad_epu8(bytes, _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2")))
+static inline int sum_lanes_avx2(__m256i acc) {
+	return (int) (_mm256_extract_epi64(acc, 0) + _mm256_extract_epi64(acc, 1)
+		      + _mm256_extract_epi64(acc, 2) + _mm256_extract_epi64(acc, 3));
+}
+
+#define AVX2_WORDS ((int) (32 / sizeof(unsigned long)))	/* words in a 256 bits register */
+
+__attribute__((target("avx2,popcnt")))
+static int xor_count_avx2(const unsigned long* a, const unsigned long* b, int nwords) {
+	int i = 0, count;
+	__m256i acc = _mm256_setzero_si256();
+	for (; i + AVX2_WORDS <= nwords; i += AVX2_WORDS) {
+		__m256i va = _mm256_loadu_si256((const __m256i*) (a + i));
+		__m256i vb = _mm256_loadu_si256((const __m256i*) (b + i));
+		acc = _mm256_add_epi64(acc, popcount_lanes_avx2(_mm256_xor_si256(va, vb)));
+	}
+	count = sum_lanes_avx2(acc);
+	for (; i < nwords; i++) count += __builtin_popcountl(a[i] ^ b[i]);
+	return count;
+}
+
+__attribute__((target("avx2,popcnt")))
+static int andnot_count_avx2(const unsigned long* a, const unsigned long* b, int nwords) {
+	int i = 0, count;
+	__m256i acc = _mm256_setzero_si256();
+	for (; i + AVX2_WORDS <= nwords; i += AVX2_WORDS) {
+		__m256i va = _mm256_loadu_si256((const __m256i*) (a + i));
+		__m256i vb = _mm256_loadu_si256((const __m256i*) (b + i));
+		acc = _mm256_add_epi64(acc, popcount_lanes_avx2(_mm256_andnot_si256(vb, va))); /* ~vb & va */
+	}
+	count = sum_lanes_avx2(acc);
+	for (; i < nwords; i++) count += __builtin_popcountl(a[i] & ~b[i]);
+	return count;
+}
+
+#endif /* BITSET_X86 */
+
+
+#ifdef BITSET_NEON
+
+#define NEON_WORDS ((int) (16 / sizeof(unsigned long)))	/* words in a 128 bits register */
+
+static inline uint64x2_t popcount_acc_neon(uint64x2_t acc, uint8x16_t v) {
+	return vpadalq_u32(acc, vpaddlq_u16(vpaddlq_u8(vcntq_u8(v))));
+}
+
+static int xor_count_neon(const unsigned long* a, const unsigned long* b, int nwords) {
+	int i = 0, count;
+	uint64x2_t acc = vdupq_n_u64(0);
+	for (; i + NEON_WORDS <= nwords; i += NEON_WORDS)
+		acc = popcount_acc_neon(acc, veorq_u8(vld1q_u8((const uint8_t*) (a + i)), vld1q_u8((const uint8_t*) (b + i))));
+	count = (int) (vgetq_lane_u64(acc, 0) + vgetq_lane_u64(acc, 1));
+	for (; i < nwords; i++) count += __builtin_popcountl(a[i] ^ b[i]);
+	return count;
+}
+
+static int andnot_count_neon(const unsigned long* a, const unsigned long* b, int nwords) {
+	int i = 0, count;
+	uint64x2_t acc = vdupq_n_u64(0);
+	for (; i + NEON_WORDS <= nwords; i += NEON_WORDS)
+		acc = popcount_acc_neon(acc, vbicq_u8(vld1q_u8((const uint8_t*) (a + i)), vld1q_u8((const uint8_t*) (b + i)))); /* a & ~b */
+	count = (int) (vgetq_lane_u64(acc, 0) + vgetq_lane_u64(acc, 1));
+	for (; i < nwords; i++) count += __builtin_popcountl(a[i] & ~b[i]);
+	return count;
+}
+
+#endif /* BITSET_NEON */
+
+
+/* RUNTIME SELECTION OF THE KERNELS */
+
+static bitset_kernels kernels = { "scalar", xor_count_scalar, andnot_count_scalar };
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+/* uses the kernels of the given name if the cpu supports them, returns 0 (and changes nothing) if not */
+static int set_kernels(const char* name) {
+	bitset_kernels k = { NULL, NULL, NULL };
+#if defined(BITSET_X86)
+	__builtin_cpu_init();
+	if (!strcmp(name, "avx2") && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+		k = (bitset_kernels) { "avx2", xor_count_avx2, andnot_count_avx2 };
+	else if (!strcmp(name, "popcnt") && __builtin_cpu_supports("popcnt"))
+		k = (bitset_kernels) { "popcnt", xor_count_popcnt, andnot_count_popcnt };
+#elif defined(BITSET_NEON)
+	if (!strcmp(name, "neon")) /* always there on aarch64 */
+		k = (bitset_kernels) { "neon", xor_count_neon, andnot_count_neon };
+#endif
+	if (!strcmp(name, "scalar"))
+		k = (bitset_kernels) { "scalar", xor_count_scalar, andnot_count_scalar };
+	if (k.name == NULL) return 0;
+	kernels = k;
+	return 1;
+}
+
+static void select_kernels() {
+	/* the best first */
+	if (!set_kernels("avx2") && !set_kernels("popcnt")) set_kernels("neon");
+}
+
+static inline const bitset_kernels* get_kernels() {
+	pthread_once(&kernels_once, select_kernels);
+	return &kernels;
+}
+
+int bitset_use_kernels(const char* name) {
+	pthread_once(&kernels_once, select_kernels); /* so that the first call of a kernel does not select others */
+	return set_kernels(name);
+}
+
+const char* bitset_kernels_name() {
+	return get_kernels()->name;
+}
+
+
+/* OPERATIONS */
+
+int bitset_count(const unsigned long* a, int nbits) {
+	int i, nw = nb_words(nbits), count = 0;
+	if (nw == 0) return 0;
+	for (i = 0; i < nw - 1; i++) count += __builtin_popcountl(a[i]);
+	return count + __builtin_popcountl(a[nw-1] & last_word_mask(nbits));
+}
+
+
+int bitset_xor_count(const unsigned long* a, const unsigned long* b, int nbits) {
+	int nw = nb_words(nbits);
+	if (nw == 0) return 0;
+	return get_kernels()->xor_count(a, b, nw - 1)
+		+ __builtin_popcountl((a[nw-1] ^ b[nw-1]) & last_word_mask(nbits));
+}
+
+
+int bitset_or_count_added(unsigned long* dst, const unsigned long* src, int nwords) {
+	int i, added = get_kernels()->andnot_count(src, dst, nwords); /* 1 in src AND 0 in dst */
+	if (added)
+		for (i = 0; i < nwords; i++) dst[i] |= src[i];
+	return added;
+}
+
+
+int bitset_equal(const unsigned long* a, const unsigned long* b, int nbits) {
+	int nw = nb_words(nbits);
+	if (nw == 0) return 1;
+	if (memcmp(a, b, (nw - 1) * sizeof(unsigned long))) return 0;
+	return ((a[nw-1] ^ b[nw-1]) & last_word_mask(nbits)) == 0;
+}
+
+
+int bitset_complement(const unsigned long* a, const unsigned long* b, int nbits) {
+	int i, nw = nb_words(nbits);
+	if (nw == 0) return 1;
+	for (i = 0; i < nw - 1; i++) if (a[i] != ~b[i]) return 0;
+	return ((a[nw-1] ^ ~b[nw-1]) & last_word_mask(nbits)) == 0;
+}
+
+
+unsigned int bitset_hash(const unsigned long* a, int nbits) {
+	/* the side of the bipartition that does not hold taxon 0 is hashed, so that a set and its
+	   complement get the same code. Words are mixed with the 64 bits FNV-1a scheme. */
+	int i, nw = nb_words(nbits);
+	if (nw == 0) return 0;
+	unsigned long flip = (a[0] & 1UL) ? ~0UL : 0UL;
+	unsigned long long h = 14695981039346656037ULL, w;
+	for (i = 0; i < nw; i++) {
+		w = (a[i] ^ flip);
+		if (i == nw - 1) w &= last_word_mask(nbits);
+		h = (h ^ w) * 1099511628211ULL;
+		h ^= h >> 29;
+	}
+	return (unsigned int) (h ^ (h >> 32));
+}
+
+
+int bitset_xor_ids(const unsigned long* a, const unsigned long* b, int nbits, int complement, int* ids) {
+	int i, nw = nb_words(nbits), count = 0;
+	unsigned long flip = complement ? ~0UL : 0UL, w;
+	for (i = 0; i < nw; i++) {
+		w = (a[i] ^ b[i]) ^ flip;
+		if (i == nw - 1) w &= last_word_mask(nbits);
+		while (w) {
+			ids[count++] = i * WORD_BITS + __builtin_ctzl(w);
+			w &= w - 1; /* clears the lowest bit set */
+		}
+	}
+	return count;
+}
+
+
+int bitset_next_set(const unsigned long* a, int nbits, int from) {
+	int i, nw = nb_words(nbits);
+	if (from >= nbits) return -1;
+	i = from / WORD_BITS;
+	unsigned long w = a[i] & (~0UL << (from % WORD_BITS));
+	while (1) {
+		if (i == nw - 1) w &= last_word_mask(nbits);
+		if (w) return i * WORD_BITS + __builtin_ctzl(w);
+		if (++i == nw) return -1;
+		w = a[i];
+	}
+}
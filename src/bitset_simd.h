@@ -0,0 +1,68 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef _BITSET_SIMD_H_
+#define _BITSET_SIMD_H_
+
+/* Word level operations on the bit arrays of the id hashtables (see hashtables_bfields.h).
+
+   A bitset is given as its array of unsigned longs and its number of meaningful bits (nbits, i.e. the number
+   of taxa): the bits beyond nbits in the last word are ignored, whatever their value.
+   The counting kernels have a scalar, a hardware popcount and an AVX2 version on x86, and a NEON version on
+   ARM: the best one supported by the cpu is selected at runtime, the first time one of them is called. */
+
+/* number of bits set */
+int bitset_count(const unsigned long* a, int nbits);
+
+/* number of bits set in a XOR b: the size of the symmetric difference of the two sets */
+int bitset_xor_count(const unsigned long* a, const unsigned long* b, int nbits);
+
+/* dst |= src on the nwords words, returns the number of bits that were set in src and not in dst */
+int bitset_or_count_added(unsigned long* dst, const unsigned long* src, int nwords);
+
+/* returns non-zero iff a and b hold the same bits */
+int bitset_equal(const unsigned long* a, const unsigned long* b, int nbits);
+
+/* returns non-zero iff a is the complement of b */
+int bitset_complement(const unsigned long* a, const unsigned long* b, int nbits);
+
+/* a hash code of the bipartition given by a, the same for a and its complement */
+unsigned int bitset_hash(const unsigned long* a, int nbits);
+
+/* writes into ids, in increasing order, the indices of the bits set in a XOR b (or of the bits not set in it,
+   if complement is non-zero), and returns their number */
+int bitset_xor_ids(const unsigned long* a, const unsigned long* b, int nbits, int complement, int* ids);
+
+/* returns the index of the first bit set in a at or after index from, -1 if there is none */
+int bitset_next_set(const unsigned long* a, int nbits, int from);
+
+/* name of the kernels in use: "avx2", "popcnt", "neon" or "scalar" */
+const char* bitset_kernels_name();
+
+/* uses the kernels of the given name instead of the best ones, to compare them (see unit_tests.c): returns 0
+   if the cpu does not support them. Not to be called while other threads use the kernels */
+int bitset_use_kernels(const char* name);
+
+#endif /* _BITSET_SIMD_H_ */
@@ -27,11 +27,24 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "tree.h"
 #include "bitset_index.h"
 #include "rapid_transfer.h"
+#include "nh_reader.h"
+#include "fbp_intervals.h"
+#include "tbe_workspace.h"
+#include "partial_result.h"
+#include "topo_dedup.h"
+#include "profile.h"
+#include "numa.h"
+#include "bin_trees.h"
 
 #include <string.h> /* for strcpy, strdup, etc */
 #include <getopt.h>
 #include <omp.h> /* OpenMP */
 #include <math.h>
+#include <signal.h>
+#include <unistd.h>
+#ifdef HAVE_MPI
+#include <mpi.h>
+#endif
 
 #include "version.h"
 
@@ -42,46 +55,151 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 // #define COMPARE_TBE_METHODS
 
-void tbe(bool rapid, Tree *ref_tree, Tree *ref_raw_tree, char **alt_tree_strings,char** taxname_lookup_table, FILE *stat_file, int num_trees, int quiet, double dist_cutoff,int count_per_branch);
-void fbp(Tree *ref_tree, char **alt_tree_strings,char** taxname_lookup_table, int num_trees, int quiet);
+/* The bootstrap trees of the file that a call to tbe() or fbp() processes: the ones whose index is shard modulo
+   nb_shards, up to the index end (excluded, -1 for the end of the file), read before the deadline (an
+   omp_get_wtime() time, -1 for none) and before *stop is set (if stop is not NULL) */
+typedef struct {
+  int shard;
+  int nb_shards;
+  int end;
+  double deadline;
+  volatile sig_atomic_t *stop;
+} BootSelection;
+
+int tbe(bool rapid, int nb_refs, Tree **ref_trees, NHReader *boot_reader, char** taxname_lookup_table, map_t taxid_map, PartialResult **res, PartialResult **fbp_res, const BootSelection *sel, TopoCache *dedup, int quiet, double dist_cutoff);
+int fbp(int nb_refs, Tree **ref_trees, NHReader *boot_reader, char** taxname_lookup_table, map_t taxid_map, PartialResult **res, const BootSelection *sel, TopoCache *dedup, int quiet);
+void tbe_supports(Tree *ref_tree, Tree *ref_raw_tree, const PartialResult *res, char** taxname_lookup_table, FILE *stat_file);
+void fbp_supports(Tree *ref_tree, const PartialResult *res);
 int* species_to_move(Edge* re, Edge* be, int dist, int nb_taxa);
 void compute_transfer_indices(Tree *ref_tree, const int n, const int m,
                               Tree *alt_tree, int *transfer_indices,
-                              const int max_branches_boot,
+                              TBEWorkspace *ws,
                               double *moved_species_counts,
                               int **moved_species_counts_per_branch,
                               int count_per_branch, const double dist_cutoff);
+void compute_moved_species_rapid(Tree *ref_tree, const int n, const int m,
+                                 const int *transfer_index, RapidTIContext *ctx,
+                                 int *moved_species, int *sm,
+                                 double *moved_species_counts,
+                                 int **moved_species_counts_per_branch,
+                                 int count_per_branch, const double dist_cutoff);
+int add_moved_species(Edge *re, const int *sm, int dist, int *moved_species,
+                      int **moved_species_counts_per_branch,
+                      int count_per_branch, const double dist_cutoff);
+void add_moved_species_counts(int n, const int *moved_species, int nb_branches_close,
+                              double *moved_species_counts);
 void assert_equal_TI(int *ti_new, int *ti_old, Tree *ref_tree);
 
+/* Returns whether the leaves of tree are the nb_taxa taxa of the taxname lookup table */
+static bool same_taxa(Tree *tree, int nb_taxa){
+  int i;
+  if(tree->nb_taxa != nb_taxa) return false;
+  for(i = 0; i < tree->nb_nodes; i++)
+    if(tree->a_nodes[i]->nneigh == 1 && tree->a_nodes[i]->taxon_id < 0) return false;
+  return true;
+}
+
+/* the measures of the run with --profile, NULL without: the measures are then skipped */
+static Profile *profile = NULL;
+
+/* with --stream, set by SIGUSR1: the current supports are then written as soon as the trees being compared are done */
+static volatile sig_atomic_t stream_request = 0;
+
+/* with --numa, the NUMA nodes on which the threads are pinned, NULL without */
+static NumaTopology *numa = NULL;
+/* with --intra-tree, the number of threads comparing each bootstrap tree, 0 without */
+static int intra_threads = 0;
+
+/* when -b is a binary bootstrap set (see booster convert), its taxa, NULL for an NH file */
+static BinTaxa *boot_bin_taxa = NULL;
+
+/* The tree of a string of the bootstrap reader: parsed from NH, or loaded from its record in a binary bootstrap set */
+static Tree* load_boot_tree(char *tree_string, int length, char*** taxname_lookup_table, map_t taxid_map,
+                            bool skip_hashtables, Arena *arena){
+  if(boot_bin_taxa != NULL) return load_bin_tree(tree_string, length, boot_bin_taxa, skip_hashtables, arena);
+  return complete_parse_nh_buffer(tree_string, length, taxname_lookup_table, taxid_map, skip_hashtables, arena);
+}
+
+static void request_stream_output(int signum){
+  stream_request = 1;
+}
+
+/* Writes the reference trees with the supports of the trees accumulated so far into output_file (--stream) */
+static void write_current_supports(int nb_refs, Tree **ref_trees, PartialResult **res, FILE *output_file){
+  int k;
+  for(k = 0; k < nb_refs; k++){
+    if(!strcmp(res[k]->algo, "fbp")) fbp_supports(ref_trees[k], res[k]);
+    else tbe_supports(ref_trees[k], NULL, res[k], NULL, NULL);
+    write_nh_tree(ref_trees[k], output_file);
+  }
+  fflush(output_file);
+}
+
+/* the options without a short name */
+enum { OPT_SHARD = 256, OPT_PARTIAL, OPT_MERGE, OPT_CHECKPOINT, OPT_CHECKPOINT_EVERY, OPT_ADAPTIVE, OPT_TIME_BUDGET, OPT_DEDUP, OPT_PROFILE, OPT_STREAM, OPT_NUMA, OPT_INTRA_TREE, OPT_FBP_OUT };
+
 void usage(FILE * out,char *name){
   fprintf(out,"Usage: ");
   fprintf(out,"%s -i <ref tree file (newick)> -b <bootstrap tree file (newick)> [-@ <cpus> -d <dist_cutoff> -r <raw distance output tree file> -S <stat file> -o <output tree> -v]\n",name);
+  fprintf(out,"       %s -i <ref tree file (newick)> --merge [-r <raw distance output tree file> -S <stat file> -o <output tree>] <partial result files>\n",name);
+  fprintf(out,"       %s convert -b <bootstrap tree file (newick)> -o <binary bootstrap set> [-q]\n",name);
   fprintf(out,"Options:\n");
-  fprintf(out,"      -i, --input            : Input tree file\n");
-  fprintf(out,"      -b, --boot             : Bootstrap tree file (1 file containing all bootstrap trees)\n");
+  fprintf(out,"      -i, --input            : Input tree file (may be gzip compressed). It may contain several reference trees (on\n");
+  fprintf(out,"                               the same taxa), and -i may be repeated: all of them are compared to the same\n");
+  fprintf(out,"                               bootstrap trees, and the output tree files then contain one tree per reference tree\n");
+  fprintf(out,"      -b, --boot             : Bootstrap tree file (1 file containing all bootstrap trees, may be gzip compressed)\n");
   fprintf(out,"      -o, --out              : Output file (optional) with normalized support values, default : stdout\n");
   fprintf(out,"      -r, --out-raw          : Output file (optional) with raw support values in the form of id|avgdist|depth, default : none\n");
   fprintf(out,"      -@, --num-threads      : Number of threads (default 1)\n");
-  fprintf(out,"      -S, --stat-file        : Prints output statistics for each branch in the given output file (optional)\n");
-  fprintf(out,"      -c, --count-per-branch : Prints individual taxa moves for each branches in the log file (only with -S & -a tbe)\n");
-  fprintf(out,"      -d, --dist-cutoff      : Distance cutoff to consider a branch for taxa transfer index computation (-a tbe only, default 0.3)\n");
+  fprintf(out,"      -S, --stat-file        : Prints output statistics for each branch in the given output file (optional),\n");
+  fprintf(out,"                               or in <stat file>.<k> for the k-th of several reference trees\n");
+  fprintf(out,"      -c, --count-per-branch : Prints individual taxa moves for each branches in the log file (only with -S & -a tbe or rtbe)\n");
+  fprintf(out,"      -d, --dist-cutoff      : Distance cutoff to consider a branch for taxa transfer index computation (-a tbe or rtbe, default 0.3)\n");
   fprintf(out,"      -a, --algo             : rtbe or tbe or fbp (default rtbe)\n");
+  fprintf(out,"      --shard <i>/<k>        : Only processes the bootstrap trees whose index in the file is i modulo k (0 <= i < k)\n");
+  fprintf(out,"      --partial <file>       : Writes the accumulated results into the given partial result file, instead of\n");
+  fprintf(out,"                               the output tree(s) and statistics (-S and -c then make it keep the statistics)\n");
+  fprintf(out,"      --merge <files>        : Merges the partial result files given as arguments (with the same -i, no -b),\n");
+  fprintf(out,"                               and outputs the supports and statistics as a single run would\n");
+  fprintf(out,"      --checkpoint <file>    : Resumes from the given checkpoint if it exists (skipping the trees of the\n");
+  fprintf(out,"                               bootstrap file it has already processed), and updates it during the run\n");
+  fprintf(out,"      --checkpoint-every <n> : Updates the checkpoint (and checks the convergence of --adaptive) each time n\n");
+  fprintf(out,"                               bootstrap trees are read (default 100)\n");
+  fprintf(out,"      --adaptive <tol>       : Stops reading bootstrap trees once the 95%% confidence interval of each support is\n");
+  fprintf(out,"                               within +/- tol (e.g. 0.02). The number of trees used goes in the stat file (-S)\n");
+  fprintf(out,"      --time-budget <s>      : Stops reading bootstrap trees after s seconds\n");
+  fprintf(out,"      --dedup                : Compares the bootstrap trees of the same topology only once (not with -S)\n");
+  fprintf(out,"      --profile <file>       : Writes the times of the phases of the run, per thread busy times, latency histograms,\n");
+  fprintf(out,"                               peak memory and counters into the given JSON file\n");
+  fprintf(out,"      --stream <n>           : Compares the bootstrap trees as they arrive (-b may be a pipe, a FIFO, or - for the\n");
+  fprintf(out,"                               standard input), and writes the current output tree(s) every n trees and when\n");
+  fprintf(out,"                               booster receives SIGUSR1, then the final ones at the end of the stream\n");
+  fprintf(out,"      --numa                 : Pins the threads to the cpus of the NUMA nodes (in blocks), each node reading\n");
+  fprintf(out,"                               its own copy of the reference trees (rtbe) or of their clades (fbp)\n");
+  fprintf(out,"      --intra-tree           : Splits the comparison of each bootstrap tree over the threads, instead of\n");
+  fprintf(out,"                               comparing several trees at once (rtbe only): for huge trees with few replicates\n");
+  fprintf(out,"      --fbp-out <file>       : Also computes the FBP supports (with -a rtbe or tbe), on the same parsed bootstrap\n");
+  fprintf(out,"                               trees, and writes the FBP output tree(s) into the given file\n");
   fprintf(out,"      -q, --quiet            : Does not print progress messages during analysis\n");
   fprintf(out,"      -v, --version          : Prints version (optional)\n");
   fprintf(out,"      -h, --help             : Prints this help\n");
   fprintf(out,"\n");
+  fprintf(out,"%s convert writes the trees of a bootstrap tree file (may be gzip compressed) already parsed into a\n",name);
+  fprintf(out,"binary bootstrap set, which can then be given as -b to the runs: its trees are loaded with no parsing.\n");
+  fprintf(out,"\n");
   fprintf(out,"If you use BOOSTER, please cite:\n");
   fprintf(out,"Renewing Felsenstein's Phylogenetic Bootstrap in the Era of Big Data\n");
   fprintf(out,"F. Lemoine, J.-B. Domelevo-Entfellner, E. Wilkinson, D. Correia, M. Davila Felipe, T. De Oliveira, O. Gascuel.\n");
   fprintf(out,"Nature 556, 452-456 (2018)\n");
 }
 
-void printOptions(FILE * out,char* input_tree,char * boot_trees, char * output_tree, char * output_raw_tree, char *output_stat, char *algo, int nb_threads, int quiet, double dist_cutoff, int count_per_branch){
+void printOptions(FILE * out,char** input_trees, int nb_input_files, char * boot_trees, char * output_tree, char * output_raw_tree, char *output_stat, char *algo, int nb_threads, int quiet, double dist_cutoff, int count_per_branch){
   fprintf(out,"**************************\n");
   fprintf(out,"*         Options        *\n");
   fprintf(out,"**************************\n");
   short_version(out);
-  fprintf(out,"Input Tree      : %s\n", input_tree);
+  for(int i=0; i<nb_input_files; i++)
+    fprintf(out,"Input Tree      : %s\n", input_trees[i]);
   fprintf(out,"Bootstrap Trees : %s\n", boot_trees);
   if(output_tree==NULL)
     fprintf(out,"Output tree     : stdout\n");
@@ -108,33 +226,70 @@ void printOptions(FILE * out,char* input_tree,char * boot_trees, char * output_t
   fprintf(out,"**************************\n");
 }
 
-void reset_matrices(int nb_taxa, int nb_edges_ref, int nb_edges_boot, short unsigned*** c_matrix, short unsigned*** i_matrix, short unsigned*** hamming, short unsigned** min_dist, short unsigned** min_dist_edges){
-  int i;
-  (*min_dist) = (short unsigned*) malloc(nb_edges_ref*sizeof(short unsigned)); /* array of min Hamming distances */
-  (*min_dist_edges) = (short unsigned*) malloc(nb_edges_ref*sizeof(short unsigned)); /* array of edge ids corresponding to min Hamming distances */
-  (*c_matrix) = (short unsigned**) malloc(nb_edges_ref*sizeof(short unsigned*)); /* matrix of cardinals of complements */
-  (*i_matrix) = (short unsigned**) malloc(nb_edges_ref*sizeof(short unsigned*)); /* matrix of cardinals of intersections */
-  (*hamming) = (short unsigned**) malloc(nb_edges_ref*sizeof(short unsigned*)); /* matrix of Hamming distances */
-  for (i=0; i<nb_edges_ref; i++){
-    (*c_matrix)[i] = (short unsigned*) malloc(nb_edges_boot*sizeof(short unsigned));
-    (*i_matrix)[i] = (short unsigned*) malloc(nb_edges_boot*sizeof(short unsigned));
-    (*hamming)[i] = (short unsigned*) malloc(nb_edges_boot*sizeof(short unsigned));
-    (*min_dist)[i] = nb_taxa; /* initialization to the nb of taxa */
+/* booster convert -b <bootstrap tree file> -o <binary bootstrap set>: writes the trees of the file into a
+   binary bootstrap set (see bin_trees.h). The invalid trees are skipped, as a run would. */
+static int convert_boot_trees(int argc, char* argv[], char *name){
+  char *boot_trees = NULL, *out = NULL, *tree_string;
+  int quiet = 0, length, c, nb_skipped = 0;
+  static struct option long_options[] = {
+    {"boot" , required_argument, 0, 'b'},
+    {"out"  , required_argument, 0, 'o'},
+    {"quiet", no_argument      , 0, 'q'},
+    {"help" , no_argument      , 0, 'h'},
+    {0, 0, 0, 0}
+  };
+
+  opterr = 0;
+  while ((c = getopt_long(argc, argv, "b:o:qh", long_options, NULL)) != -1){
+    switch (c){
+    case 'b': boot_trees = optarg; break;
+    case 'o': out = optarg; break;
+    case 'q': quiet = 1; break;
+    case 'h': usage(stdout,name); return EXIT_SUCCESS; break;
+    case '?': fprintf(stderr, "Option -%c is undefined or requires an argument\n", optopt); return EXIT_FAILURE; break;
+    }
+  }
+  if(boot_trees == NULL || out == NULL){
+    fprintf(stderr,"An option is missing\n");
+    usage(stderr,name);
+    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
   }
-}
 
-void free_matrices(int nb_edges_ref, short unsigned*** c_matrix, short unsigned*** i_matrix, short unsigned*** hamming, short unsigned** min_dist, short unsigned** min_dist_edges){
-  int i;
-  for (i=0; i<nb_edges_ref; i++) {
-    free((*c_matrix)[i]);
-    free((*i_matrix)[i]);
-    free((*hamming)[i]);
-  }
-  free((*c_matrix));
-  free((*i_matrix));
-  free((*hamming));
-  free((*min_dist));
-  free((*min_dist_edges));
+  NHReader *reader = nh_reader_open(boot_trees);
+  if(reader == NULL){
+    fprintf(stderr,"File %s not found or impossible to access media. Aborting.\n", boot_trees);
+    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+  }
+  if(reader->format == NH_BINARY){
+    fprintf(stderr,"File %s is already a binary bootstrap set. Aborting.\n", boot_trees);
+    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+  }
+  BinTreesWriter *writer = new_bin_trees_writer(out);
+  if(writer == NULL){
+    fprintf(stderr,"Impossible to create the file %s. Aborting.\n", out);
+    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+  }
+
+  /* only the structure and the names of the leaves are written: the taxa are matched when the set is read */
+  Arena *arena = arena_new(ARENA_BLOCK_SIZE);
+  while((tree_string = nh_reader_next(reader, &length)) != NULL){
+    arena_reset(arena);
+    Tree *tree = parse_nh_buffer(tree_string, length, arena);
+    if(tree == NULL){
+      fprintf(stderr,"Not a correct NH tree (%d). Skipping.\n%.*s\n", reader->num_read - 1, length, tree_string);
+      nh_reader_release(reader, tree_string);
+      nb_skipped++;
+      continue;
+    }
+    nh_reader_release(reader, tree_string);
+    bin_trees_write(writer, tree);
+  }
+  arena_free(arena);
+  if(!quiet) fprintf(stderr,"%d bootstrap trees (%d taxa) written into %s, %d skipped\n",
+                     writer->nb_trees, writer->nb_names, out, nb_skipped);
+  close_bin_trees_writer(writer);
+  nh_reader_close(reader);
+  return EXIT_SUCCESS;
 }
 
 int main (int argc, char* argv[]) {
@@ -144,24 +299,28 @@ int main (int argc, char* argv[]) {
      OR Arg2 is a single file containing all the bootstrap trees, one per line.
      Arg3 is the name of the output file (output tree with bootstrap values). */
 
-  int i, retcode;
+  int i;
   /* int one_side; /\* to store a number of taxa seen on one side of a branch in the ref tree *\/ */
 
   FILE *output_file = NULL;
-  FILE *intree_file = NULL;
-  FILE *boottree_file = NULL;
-  FILE *stat_file = NULL;
+  NHReader *intree_reader = NULL;
+  NHReader *boot_reader = NULL;
+  FILE **stat_files = NULL; /* one per reference tree */
   FILE *output_raw_file = NULL; /* Output tree file with edge bootstrap values noted as "id|avgdist|topo_depth" */
   
-  char *input_tree = NULL;
+  char **input_trees = NULL; /* -i can be given several times */
+  int nb_input_files = 0;
   char *boot_trees = NULL;
   char *out_tree = NULL;
   char *out_raw_tree = NULL;
+  char *out_fbp_tree = NULL; /* with --fbp-out, the output trees with the FBP supports, computed in the same pass */
+  FILE *output_fbp_file = NULL;
   char *stat_out = NULL;
 
-  Tree *ref_tree;
-  Tree *ref_raw_tree = NULL; /* For raw support at edges : id|avgdist|depth */
-  char **alt_tree_strings;
+  /* all the trees of the input files are reference trees, compared to the same bootstrap trees */
+  Tree **ref_trees = NULL;
+  Tree **ref_raw_trees = NULL; /* For raw support at edges : id|avgdist|depth */
+  int nb_refs = 0;
 
   char *algo = "rtbe";
   
@@ -174,6 +333,34 @@ int main (int argc, char* argv[]) {
   /* If true, compute and print in the log file the (normalized) number of moves of each taxa for all branches */
   int count_per_branch = 0;
 
+  /* this run only processes the bootstrap trees whose index is shard modulo nb_shards */
+  int shard = 0, nb_shards = 1;
+  char *partial_out = NULL; /* if not NULL, the accumulated results are written to this file instead of the trees */
+  int merge = 0; /* if true, the partial result files given as arguments are merged, no bootstrap tree is read */
+  char *checkpoint = NULL; /* if not NULL, the run resumes from this partial result file, and keeps it up to date */
+  int checkpoint_every = 100; /* number of bootstrap trees read between two updates of the checkpoint (or convergence checks) */
+  double adaptive_tol = 0; /* if > 0, stops once the 95% confidence intervals of all the supports are within +/- adaptive_tol */
+  double time_budget = 0; /* if > 0, stops reading bootstrap trees after that many seconds */
+  int dedup = 0; /* if true, the bootstrap trees of the same topology are only compared once */
+  TopoCache *topo_cache = NULL;
+  char *profile_out = NULL; /* if not NULL, the phases of the run are timed, and written as JSON into this file */
+  int stream_every = 0; /* if > 0, the current output trees are written every stream_every bootstrap trees */
+  int use_numa = 0; /* if true, the threads are pinned to the NUMA nodes, each with its replica of the reference */
+  int intra_tree = 0; /* if true, the bootstrap trees are compared one at a time, each by all the threads */
+  int rank = 0, nb_ranks = 1; /* MPI: each rank processes its own shard, and rank 0 writes the outputs */
+  PartialResult **res; /* one per reference tree */
+  PartialResult **fbp_res = NULL; /* with --fbp-out, the FBP results, one per reference tree */
+  int k;
+
+  if(argc > 1 && !strcmp(argv[1], "convert")) return convert_boot_trees(argc - 1, argv + 1, argv[0]);
+
+#ifdef HAVE_MPI
+  int mpi_thread_level; /* only the main thread of each rank calls MPI */
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &mpi_thread_level);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &nb_ranks);
+#endif
+
   static struct option long_options[] = {
     {"input", required_argument, 0, 'i'},
     {"boot" , required_argument, 0, 'b'},
@@ -187,6 +374,19 @@ int main (int argc, char* argv[]) {
     {"help" , no_argument      , 0, 'h'},
     {"version", no_argument      , 0, 'v'},
     {"quiet", no_argument      , 0, 'q'},
+    {"shard", required_argument, 0, OPT_SHARD},
+    {"partial", required_argument, 0, OPT_PARTIAL},
+    {"merge", no_argument      , 0, OPT_MERGE},
+    {"checkpoint", required_argument, 0, OPT_CHECKPOINT},
+    {"checkpoint-every", required_argument, 0, OPT_CHECKPOINT_EVERY},
+    {"adaptive", required_argument, 0, OPT_ADAPTIVE},
+    {"time-budget", required_argument, 0, OPT_TIME_BUDGET},
+    {"dedup", no_argument      , 0, OPT_DEDUP},
+    {"profile", required_argument, 0, OPT_PROFILE},
+    {"stream", required_argument, 0, OPT_STREAM},
+    {"numa", no_argument      , 0, OPT_NUMA},
+    {"intra-tree", no_argument      , 0, OPT_INTRA_TREE},
+    {"fbp-out", required_argument, 0, OPT_FBP_OUT},
     {0, 0, 0, 0}
   };
 
@@ -195,7 +395,10 @@ int main (int argc, char* argv[]) {
   int c = 0;
   while ((c = getopt_long(argc, argv, "i:a:b:d:o:cs:@:S:n:r:hvq", long_options, &option_index)) != -1){
     switch (c){
-    case 'i': input_tree = optarg; break;
+    case 'i':
+      input_trees = (char**) realloc(input_trees, (nb_input_files + 1) * sizeof(char*));
+      input_trees[nb_input_files++] = optarg;
+      break;
     case 'b': boot_trees = optarg; break;
     case 'o': out_tree = optarg; break;
     case '@': num_threads=strtol(optarg,NULL,10); break; 
@@ -205,6 +408,46 @@ int main (int argc, char* argv[]) {
     case 'S': stat_out = optarg; break;
     case 'r': out_raw_tree = optarg; break;
     case 'q': quiet = 1; break;
+    case OPT_SHARD:
+      if(sscanf(optarg,"%d/%d",&shard,&nb_shards) != 2 || nb_shards < 1 || shard < 0 || shard >= nb_shards){
+        fprintf(stderr,"Option --shard must be of the form i/k, with 0 <= i < k\n");
+        return EXIT_FAILURE;
+      }
+      break;
+    case OPT_PARTIAL: partial_out = optarg; break;
+    case OPT_MERGE: merge = 1; break;
+    case OPT_CHECKPOINT: checkpoint = optarg; break;
+    case OPT_CHECKPOINT_EVERY:
+      checkpoint_every = strtol(optarg,NULL,10);
+      if(checkpoint_every < 1){
+        fprintf(stderr,"Option --checkpoint-every must be a positive number of trees\n");
+        return EXIT_FAILURE;
+      }
+      break;
+    case OPT_ADAPTIVE:
+      if(sscanf(optarg,"%lf",&adaptive_tol) != 1 || adaptive_tol <= 0){
+        fprintf(stderr,"Option --adaptive must be a positive tolerance on the supports\n");
+        return EXIT_FAILURE;
+      }
+      break;
+    case OPT_TIME_BUDGET:
+      if(sscanf(optarg,"%lf",&time_budget) != 1 || time_budget <= 0){
+        fprintf(stderr,"Option --time-budget must be a positive number of seconds\n");
+        return EXIT_FAILURE;
+      }
+      break;
+    case OPT_DEDUP: dedup = 1; break;
+    case OPT_PROFILE: profile_out = optarg; break;
+    case OPT_NUMA: use_numa = 1; break;
+    case OPT_INTRA_TREE: intra_tree = 1; break;
+    case OPT_FBP_OUT: out_fbp_tree = optarg; break;
+    case OPT_STREAM:
+      stream_every = strtol(optarg,NULL,10);
+      if(stream_every < 1){
+        fprintf(stderr,"Option --stream must be a positive number of trees\n");
+        return EXIT_FAILURE;
+      }
+      break;
     case 'h': usage(stdout,argv[0]); return EXIT_SUCCESS; break; 
     case 'v': version(stdout,argv[0]); return EXIT_SUCCESS; break;
     case ':': fprintf(stderr, "Option -%c requires an argument\n", optopt); return EXIT_FAILURE; break;
@@ -217,12 +460,46 @@ int main (int argc, char* argv[]) {
     Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
   }
   
-  if (argc < optind || input_tree == NULL || boot_trees == NULL){
+  if (argc < optind || nb_input_files == 0 || (merge ? optind == argc : boot_trees == NULL)){
     fprintf(stderr,"An option is missing\n");
     usage(stderr,argv[0]);
     Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
   }
 
+  if(checkpoint != NULL && (merge || nb_ranks > 1)){
+    fprintf(stderr,"Option --checkpoint cannot be used with --merge or several MPI ranks (use one checkpoint per --shard)\n");
+    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+  }
+
+  if(merge && (adaptive_tol > 0 || time_budget > 0)){
+    fprintf(stderr,"Options --adaptive and --time-budget cannot be used with --merge\n");
+    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+  }
+
+  if(stream_every > 0 && (merge || partial_out != NULL || checkpoint != NULL || adaptive_tol > 0 || nb_ranks > 1)){
+    fprintf(stderr,"Option --stream cannot be used with --merge, --partial, --checkpoint, --adaptive or several MPI ranks\n");
+    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+  }
+
+  if(dedup && stat_out != NULL && strcmp(algo, "fbp")){
+    fprintf(stderr,"Option --dedup cannot be used with -S: the moved taxa statistics are computed for each tree\n");
+    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+  }
+
+  if(out_fbp_tree != NULL && (!strcmp(algo, "fbp") || merge || partial_out != NULL || checkpoint != NULL || stream_every > 0 || nb_ranks > 1)){
+    fprintf(stderr,"Option --fbp-out can only be used with -a rtbe or tbe, and not with --merge, --partial, --checkpoint, --stream or several MPI ranks\n");
+    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+  }
+
+  if(intra_tree && (strcmp(algo, "rtbe") || use_numa)){
+    fprintf(stderr,"Option --intra-tree can only be used with -a rtbe, and not with --numa\n");
+    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+  }
+
+  /* the shards of the ranks subdivide the shard of the run */
+  shard = shard * nb_ranks + rank;
+  nb_shards *= nb_ranks;
+
   if(num_threads>0){
     if(num_threads > omp_get_max_threads())
       num_threads = omp_get_max_threads();
@@ -230,17 +507,17 @@ int main (int argc, char* argv[]) {
     num_threads = 1;
   }
   omp_set_num_threads(num_threads);
+  if(profile_out != NULL) profile = new_profile(num_threads);
+  if(use_numa) numa = numa_detect();
+  if(intra_tree) intra_threads = num_threads;
 
-  if(stat_out !=NULL){
-    stat_file = fopen(stat_out,"w");
-    if(stat_file == NULL){
-      fprintf(stderr,"File %s not found or not writable. Aborting.\n", stat_out);
-      Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
-    }
-  } else stat_file = NULL;
+  /* with --partial, the statistics are kept in the partial result file, and the trees are not written */
+  bool write_outputs = rank == 0 && partial_out == NULL;
 
   /* writing the output tree to the file given on the commandline */
-  if(out_tree == NULL){
+  if(!write_outputs){
+    output_file = NULL;
+  }else if(out_tree == NULL){
     output_file = stdout;
   }else{
     output_file = fopen(out_tree,"w");
@@ -251,7 +528,7 @@ int main (int argc, char* argv[]) {
   }
 
   /* writing the output tree to the file given on the commandline */
-  if(out_raw_tree != NULL){
+  if(out_raw_tree != NULL && write_outputs){
     output_raw_file = fopen(out_raw_tree,"w");
     if(output_raw_file == NULL){
       fprintf(stderr,"File %s not found or not writable. Aborting.\n", out_raw_tree);
@@ -259,271 +536,813 @@ int main (int argc, char* argv[]) {
     }
   }
 
-  
-  if(!quiet) printOptions(stderr, input_tree, boot_trees, out_tree, out_raw_tree, stat_out, algo, num_threads, quiet, dist_cutoff, count_per_branch);
-
-  intree_file = fopen(input_tree,"r");
-  if (intree_file == NULL) {
-    fprintf(stderr,"File %s not found or impossible to access media. Aborting.\n", input_tree);
-    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
-  }
-
-  /* we copy the tree into a large string */
-  unsigned int treefilesize = 3 * tell_size_of_one_tree(input_tree);
-  if (treefilesize > MAX_TREELENGTH) {
-    fprintf(stderr,"Tree filesize for %s bigger than %d bytes: are you sure it's a valid NH tree? Aborting.\n", input_tree, MAX_TREELENGTH/3);
-    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+  if(out_fbp_tree != NULL && write_outputs){
+    output_fbp_file = fopen(out_fbp_tree,"w");
+    if(output_fbp_file == NULL){
+      fprintf(stderr,"File %s not found or not writable. Aborting.\n", out_fbp_tree);
+      Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+    }
   }
 
-  char *big_string = (char*) calloc(treefilesize+1, sizeof(char)); 
-  retcode = copy_nh_stream_into_str(intree_file, big_string);
-  if (retcode != 1) { 
-    fprintf(stderr,"Unexpected EOF while parsing the reference tree! Aborting.\n"); 
-    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+  
+  if(!quiet && rank == 0) {
+    printOptions(stderr, input_trees, nb_input_files, merge ? "None (merge)" : boot_trees, out_tree, out_raw_tree, stat_out, algo, num_threads, quiet, dist_cutoff, count_per_branch);
+    if(nb_shards > 1) fprintf(stderr,"Shards          : %d (%d MPI ranks)\n", nb_shards, nb_ranks);
+    if(partial_out != NULL) fprintf(stderr,"Partial result  : %s\n", partial_out);
+    if(checkpoint != NULL) fprintf(stderr,"Checkpoint      : %s (every %d trees)\n", checkpoint, checkpoint_every);
+    if(adaptive_tol > 0) fprintf(stderr,"Adaptive        : +/- %g (checked every %d trees)\n", adaptive_tol, checkpoint_every);
+    if(time_budget > 0) fprintf(stderr,"Time budget     : %g s\n", time_budget);
+    if(stream_every > 0) fprintf(stderr,"Stream          : output every %d trees and on SIGUSR1 (pid %d)\n", stream_every, (int) getpid());
+    if(numa) fprintf(stderr,"NUMA nodes      : %d (threads pinned)\n", numa->nb_nodes);
+    if(intra_threads) fprintf(stderr,"Intra-tree      : each tree compared by %d threads\n", intra_threads);
+    if(out_fbp_tree != NULL) fprintf(stderr,"FBP output tree : %s\n", out_fbp_tree);
   }
-  fclose(intree_file);
 
-  /* and then feed this string to the parser */
   bool rapid = !strcmp(algo, "rtbe");
 
-  bool skip_hashtables = rapid;
+  bool skip_hashtables = rapid || !strcmp(algo, "fbp") || merge; /* only the (slow) tbe needs bitsets on the edges */
   #ifdef COMPARE_TBE_METHODS
   skip_hashtables = false;
   #endif
 
   char** taxname_lookup_table = NULL;
-  ref_tree  = complete_parse_nh(big_string, &taxname_lookup_table, skip_hashtables); /* sets taxname_lookup_table en passant */
-  if(out_raw_tree !=NULL){
-    ref_raw_tree  = complete_parse_nh(big_string, &taxname_lookup_table, skip_hashtables); /* sets taxname_lookup_table en passant */
+  map_t taxid_map = NULL;
+  if(profile) profile_phase_begin(profile);
+  for(i = 0; i < nb_input_files; i++){
+    /* the reference trees go through the same (possibly compressed) reader as the bootstrap trees */
+    intree_reader = nh_reader_open(input_trees[i]);
+    if (intree_reader == NULL) {
+      fprintf(stderr,"File %s not found or impossible to access media. Aborting.\n", input_trees[i]);
+      Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+    }
+
+    int big_string_length;
+    char *big_string;
+    int nb_read = 0;
+    while((big_string = nh_reader_next(intree_reader, &big_string_length)) != NULL){
+      /* and then feed this string to the parser */
+      ref_trees = (Tree**) realloc(ref_trees, (nb_refs + 1) * sizeof(Tree*));
+      ref_raw_trees = (Tree**) realloc(ref_raw_trees, (nb_refs + 1) * sizeof(Tree*));
+      ref_trees[nb_refs] = complete_parse_nh_buffer(big_string, big_string_length, &taxname_lookup_table, taxid_map, skip_hashtables, NULL); /* the first one sets taxname_lookup_table en passant */
+      if(ref_trees[nb_refs] == NULL){
+        fprintf(stderr,"Reference tree %d of %s is not a correct NH tree. Aborting.\n", nb_read + 1, input_trees[i]);
+        Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+      }
+      /* built once: the leaves of all the following trees get their taxon id from it */
+      if(taxid_map == NULL) taxid_map = build_taxid_hashmap(taxname_lookup_table, ref_trees[0]->nb_taxa);
+      if(!same_taxa(ref_trees[nb_refs], ref_trees[0]->nb_taxa)){
+        fprintf(stderr,"Reference tree %d of %s does not have the taxa of the first reference tree. Aborting.\n", nb_read + 1, input_trees[i]);
+        Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+      }
+      ref_raw_trees[nb_refs] = NULL;
+      if(output_raw_file != NULL){
+        ref_raw_trees[nb_refs] = complete_parse_nh_buffer(big_string, big_string_length, &taxname_lookup_table, taxid_map, skip_hashtables, NULL);
+      }
+      nh_reader_release(intree_reader, big_string);
+      nb_refs++;
+      nb_read++;
+    }
+    nh_reader_close(intree_reader);
+    if(nb_read == 0){
+      fprintf(stderr,"Unexpected EOF while parsing the reference tree! Aborting.\n"); 
+      Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+    }
+  }
+  if(profile) profile_phase_end(profile, PHASE_READ_REF);
+  if(!quiet && rank == 0 && nb_refs > 1) fprintf(stderr,"Reference trees : %d\n", nb_refs);
+
+  /* with several reference trees, the statistics of the k-th one go to the file <stat file>.k */
+  stat_files = (FILE**) calloc(nb_refs, sizeof(FILE*));
+  if(stat_out != NULL && write_outputs){
+    for(k = 0; k < nb_refs; k++){
+      char *stat_name = (char*) malloc(strlen(stat_out) + 16);
+      if(nb_refs == 1) strcpy(stat_name, stat_out);
+      else sprintf(stat_name, "%s.%d", stat_out, k + 1);
+      stat_files[k] = fopen(stat_name,"w");
+      if(stat_files[k] == NULL){
+        fprintf(stderr,"File %s not found or not writable. Aborting.\n", stat_name);
+        Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+      }
+      free(stat_name);
+    }
   }
 
+  if(merge){
+    /* the partial results of the shards are summed, as if all their trees had been processed by this run */
+    int nb_res;
+    if(profile) profile_phase_begin(profile);
+    res = read_partial_results(argv[optind], &nb_res);
+    if(nb_res != nb_refs){
+      fprintf(stderr,"The partial results of %s are for %d reference trees, not %d. Aborting.\n", argv[optind], nb_res, nb_refs);
+      Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+    }
+    for(i = optind + 1; i < argc; i++){
+      int nb_parts;
+      PartialResult **parts = read_partial_results(argv[i], &nb_parts);
+      if(nb_parts != nb_refs){
+        fprintf(stderr,"The partial results of %s are for %d reference trees, not %d. Aborting.\n", argv[i], nb_parts, nb_refs);
+        Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+      }
+      for(k = 0; k < nb_refs; k++){
+        merge_partial_result(res[k], parts[k]);
+        free_partial_result(parts[k]);
+      }
+      free(parts);
+    }
+    for(k = 0; k < nb_refs; k++){
+      if(res[k]->fingerprint != ref_tree_fingerprint(ref_trees[k]) || res[k]->nb_edges != ref_trees[k]->nb_edges){
+        fprintf(stderr,"The partial results were not computed on the reference tree(s) given with -i. Aborting.\n");
+        Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+      }
+      if(stat_files[k] != NULL && strcmp(res[k]->algo, "fbp") && (!res[k]->has_stats || (count_per_branch && !res[k]->has_per_branch))){
+        fprintf(stderr,"The partial results were computed without the requested statistics (-S, -c). Aborting.\n");
+        Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+      }
+    }
+    if(profile) profile_phase_end(profile, PHASE_MERGE);
+  }else{
+    res = (PartialResult**) malloc(nb_refs * sizeof(PartialResult*));
+    for(k = 0; k < nb_refs; k++) res[k] = new_partial_result(algo, ref_trees[k], stat_out != NULL, count_per_branch);
+    if(out_fbp_tree != NULL){
+      fbp_res = (PartialResult**) malloc(nb_refs * sizeof(PartialResult*));
+      for(k = 0; k < nb_refs; k++) fbp_res[k] = new_partial_result("fbp", ref_trees[k], false, false);
+    }
 
-  /***********************************************************************/
-  /* Establishing the list of bootstrapped trees we are going to analyze */
-  /***********************************************************************/
-  int init_boot_trees = 10;
-  int i_tree;
-  int num_trees = 0; /* this is the number of trees really analyzed */
+    /***********************************************************************/
+    /* The bootstrapped trees are streamed from the file to the workers:   */
+    /* they are read one at a time, and never all kept in memory.          */
+    /***********************************************************************/
+    boot_reader = nh_reader_open(boot_trees);
+    if (boot_reader == NULL) {
+      fprintf(stderr,"File %s not found or impossible to access media. Aborting.\n", boot_trees);
+      Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+    }
+    boot_bin_taxa = new_bin_taxa(boot_reader, taxid_map); /* NULL for an NH file */
+
+    /* resuming: the trees already processed are skipped */
+    FILE *checkpoint_file = checkpoint != NULL ? fopen(checkpoint, "r") : NULL;
+    if(checkpoint_file != NULL){
+      fclose(checkpoint_file);
+      if(profile) profile_phase_begin(profile);
+      int nb_saved;
+      PartialResult **saved = read_partial_results(checkpoint, &nb_saved);
+      if(nb_saved != nb_refs){
+        fprintf(stderr,"The checkpoint %s is for %d reference trees, not %d. Aborting.\n", checkpoint, nb_saved, nb_refs);
+        Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+      }
+      for(k = 0; k < nb_refs; k++){
+        merge_partial_result(res[k], saved[k]);
+        free_partial_result(saved[k]);
+      }
+      free(saved);
+      if(!quiet) fprintf(stderr,"Resuming from %s: %d trees already processed\n", checkpoint, res[0]->trees_read);
+      int skipped_len;
+      while(boot_reader->num_read < res[0]->trees_read){
+        char *skipped = nh_reader_next(boot_reader, &skipped_len);
+        if(skipped == NULL){
+          fprintf(stderr,"File %s has fewer trees than the %d processed in the checkpoint %s. Aborting.\n", boot_trees, res[0]->trees_read, checkpoint);
+          Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+        }
+        nh_reader_release(boot_reader, skipped);
+      }
+      if(profile) profile_phase_end(profile, PHASE_RESUME);
+    }
 
-  alt_tree_strings = malloc(init_boot_trees * sizeof(char*));
-  boottree_file = fopen(boot_trees,"r");
-  if (boottree_file == NULL) {
-    fprintf(stderr,"File %s not found or impossible to access media. Aborting.\n", boot_trees);
-    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
-  }
+    if(adaptive_tol > 0 && res[0]->sums_sq != NULL && !res[0]->has_squares){
+      fprintf(stderr,"The checkpoint %s has no sums of squares (version 2), option --adaptive cannot resume from it. Aborting.\n", checkpoint);
+      Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+    }
 
-  if (tell_size_of_one_tree(boot_trees) > treefilesize /* this value is still reachable */) {
-    fprintf(stderr,"error: size of one alternate tree bigger than three times the size of the ref tree! Aborting.\n");
-    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+    /* with a checkpoint, --adaptive or --stream, the trees are processed by batches, after each of which the
+       checkpoint is updated, the convergence of the supports checked, or the current output trees written */
+    BootSelection sel = { shard, nb_shards, -1, time_budget > 0 ? omp_get_wtime() + time_budget : -1, NULL };
+    bool converged = false, requested = false;
+    if(dedup) topo_cache = new_topo_cache();
+    if(stream_every > 0){
+      /* a request ends the current batch, even while the reader waits for the next tree */
+      struct sigaction action;
+      memset(&action, 0, sizeof(action));
+      action.sa_handler = request_stream_output;
+      action.sa_flags = SA_RESTART;
+      sigaction(SIGUSR1, &action, NULL);
+      sel.stop = &stream_request;
+      boot_reader->interrupt = &stream_request;
+    }
+    do {
+      int batch_start = boot_reader->num_read;
+      if(checkpoint != NULL || adaptive_tol > 0) sel.end = boot_reader->num_read + checkpoint_every;
+      if(stream_every > 0) sel.end = boot_reader->num_read + stream_every;
+      if(profile) profile_phase_begin(profile);
+      if(!strcmp(algo,"tbe") || rapid){
+        tbe(rapid, nb_refs, ref_trees, boot_reader, taxname_lookup_table, taxid_map, res, fbp_res, &sel, topo_cache, quiet, dist_cutoff);
+      }else{
+        fbp(nb_refs, ref_trees, boot_reader, taxname_lookup_table, taxid_map, res, &sel, topo_cache, quiet);
+      }
+      if(profile) profile_phase_end(profile, PHASE_BOOTSTRAP);
+      if(checkpoint != NULL){
+        if(profile) profile_phase_begin(profile);
+        write_partial_results(res, nb_refs, checkpoint);
+        if(profile) profile_phase_end(profile, PHASE_CHECKPOINT);
+      }
+      if(adaptive_tol > 0 && boot_reader->num_read > batch_start){
+        double max_half = 0;
+        for(k = 0; k < nb_refs; k++){
+          double half = support_ci_halfwidth(res[k], ref_trees[k]);
+          if(half > max_half) max_half = half;
+        }
+        converged = max_half <= adaptive_tol;
+        if(!quiet) fprintf(stderr,"%d trees: largest 95%% confidence interval of the supports +/- %g\n", res[0]->num_trees, max_half);
+      }
+      if(stream_every > 0){
+        requested = stream_request;
+        stream_request = 0;
+        if(requested || boot_reader->num_read == sel.end) write_current_supports(nb_refs, ref_trees, res, output_file);
+      }
+    } while(!converged && sel.end >= 0 && (boot_reader->num_read == sel.end || requested));
+    if(!quiet && converged) fprintf(stderr,"The supports converged after %d trees\n", res[0]->num_trees);
+    if(!quiet && sel.deadline >= 0 && omp_get_wtime() >= sel.deadline) fprintf(stderr,"The time budget expired after %d trees\n", boot_reader->num_read);
+    if(profile) profile->trees_read = boot_reader->num_read;
+    nh_reader_close(boot_reader);
+    free_bin_taxa(boot_bin_taxa);
+    boot_bin_taxa = NULL;
+    if(topo_cache != NULL){
+      if(profile) profile->duplicates = topo_cache->nb_hits;
+      if(!quiet) fprintf(stderr,"Duplicate topologies: %ld of %ld trees (%d topologies kept)\n", topo_cache->nb_hits, topo_cache->nb_lookups, topo_cache->nb_entries);
+      free_topo_cache(topo_cache);
+    }
+#ifdef HAVE_MPI
+    if(profile) profile_phase_begin(profile);
+    for(k = 0; k < nb_refs; k++) reduce_partial_result_mpi(res[k], 0);
+    if(profile) profile_phase_end(profile, PHASE_REDUCE);
+#endif
   }
 
-  /* we copy the tree into a large string */
-  while(copy_nh_stream_into_str(boottree_file, big_string)) /* reads from the current point in the stream, retcode 1 iff no error */
-    {
-      if(num_trees >= init_boot_trees){
-        alt_tree_strings = realloc(alt_tree_strings,init_boot_trees*2*sizeof(char*));
-        init_boot_trees *= 2;
+  if(!quiet && rank == 0)  fprintf(stderr,"Num trees: %d\n",res[0]->num_trees);
+  if(profile) profile_phase_begin(profile);
+  if(partial_out != NULL){
+    if(rank == 0) write_partial_results(res, nb_refs, partial_out);
+  }else if(rank == 0){
+    /* the output trees are written in the order of the reference trees */
+    for(k = 0; k < nb_refs; k++){
+      if(!strcmp(res[k]->algo, "fbp")) fbp_supports(ref_trees[k], res[k]);
+      else tbe_supports(ref_trees[k], ref_raw_trees[k], res[k], taxname_lookup_table, stat_files[k]);
+
+      write_nh_tree(ref_trees[k], output_file);
+      if(output_raw_file!=NULL && ref_raw_trees[k]!=NULL){
+        write_nh_tree(ref_raw_trees[k], output_raw_file);
+      }
+      if(stat_files[k] != NULL){
+        /* an adaptive run may not use all the bootstrap trees */
+        if(adaptive_tol > 0 || time_budget > 0) fprintf(stat_files[k],"NumTrees\t%d\n", res[k]->num_trees);
+        fclose(stat_files[k]);
       }
-      alt_tree_strings[num_trees] = strdup(big_string);
-      num_trees++;
     }
-  fclose(boottree_file);
-
-  if(!quiet)  fprintf(stderr,"Num trees: %d\n",num_trees);
+    /* the FBP supports replace the TBE ones in the reference trees, which are already written */
+    if(output_fbp_file != NULL){
+      for(k = 0; k < nb_refs; k++){
+        fbp_supports(ref_trees[k], fbp_res[k]);
+        write_nh_tree(ref_trees[k], output_fbp_file);
+      }
+      fclose(output_fbp_file);
+    }
 
-  if(!strcmp(algo,"tbe") || rapid){
-    tbe(rapid, ref_tree, ref_raw_tree, alt_tree_strings, taxname_lookup_table, stat_file, num_trees, quiet, dist_cutoff, count_per_branch);
-  }else{
-    fbp(ref_tree, alt_tree_strings, taxname_lookup_table, num_trees, quiet);
+    fclose(output_file);
   }
-  write_nh_tree(ref_tree, output_file);
-  if(output_raw_file!=NULL && ref_raw_tree!=NULL){
-    write_nh_tree(ref_raw_tree, output_raw_file);
+  if(profile){
+    profile_phase_end(profile, PHASE_OUTPUT);
+    /* with several MPI ranks, each one writes its own profile into <profile file>.<rank> */
+    char *profile_name = (char*) malloc(strlen(profile_out) + 16);
+    if(nb_ranks == 1) strcpy(profile_name, profile_out);
+    else sprintf(profile_name, "%s.%d", profile_out, rank);
+    write_profile(profile, profile_name);
+    free(profile_name);
+    free_profile(profile);
   }
-
-  fclose(output_file);
-  if(stat_file != NULL) fclose(stat_file);
+  free_numa_topology(numa);
   // FREEING STUFF
-  free(big_string);
-
-  /* free the stuff for the calculation of the mast-like distances */
-  for(i_tree=0; i_tree < num_trees;i_tree++){
-    free(alt_tree_strings[i_tree]);
-  }
-  free(alt_tree_strings);
 
   /* we also have to free the taxname lookup table */
-  for(i=0; i < ref_tree->nb_taxa; i++) free(taxname_lookup_table[i]); /* freeing (char*)'s */
+  free_taxid_hashmap(taxid_map);
+  for(i=0; i < ref_trees[0]->nb_taxa; i++) free(taxname_lookup_table[i]); /* freeing (char*)'s */
   free(taxname_lookup_table); /* which is a (char**) */
-  free_tree(ref_tree);
+  for(k = 0; k < nb_refs; k++){
+    free_tree(ref_trees[k]);
+    if(ref_raw_trees[k] != NULL) free_tree(ref_raw_trees[k]);
+    free_partial_result(res[k]);
+    if(fbp_res != NULL) free_partial_result(fbp_res[k]);
+  }
+  free(fbp_res);
+  free(ref_trees);
+  free(ref_raw_trees);
+  free(res);
+  free(stat_files);
+  free(input_trees);
+#ifdef HAVE_MPI
+  MPI_Finalize();
+#endif
   return 0;
 }
 
 
-void fbp(Tree *ref_tree, char **alt_tree_strings,char** taxname_lookup_table, int num_trees, int quiet){
-  int j;
-  Tree *alt_tree;
-  int i_tree,i;
-  short unsigned* nb_found = malloc(ref_tree->nb_edges * sizeof(short unsigned));
-  double support;
-  // We initialize the reference edge hashmap
-  bitset_hashmap *hm = new_bitset_hashmap(ref_tree->nb_edges*2, 0.75);
+/* Gets the next selected bootstrap tree string from the reader shared by all the threads (the trees of the
+   other shards are skipped unparsed, and no tree is read after the end of the selection).
+   Sets *i_tree to the index of the tree in the file and *length to the length of the string.
+   Returns NULL at the end of the file or of the selection. The time it takes is added to pt if not NULL. */
+static char* next_boot_tree_string(NHReader *boot_reader, const BootSelection *sel, int *i_tree, int *length,
+                                   ProfileThread *pt){
+  char *alt_tree_string;
+  double start = pt ? profile_wall() : 0;
+  #pragma omp critical (boot_reader)
+  {
+    do {
+      if((sel->end >= 0 && boot_reader->num_read >= sel->end)
+         || (sel->deadline >= 0 && omp_get_wtime() >= sel->deadline)
+         || (sel->stop != NULL && *sel->stop)) { alt_tree_string = NULL; break; }
+      alt_tree_string = nh_reader_next(boot_reader, length);
+      if(alt_tree_string == NULL || (boot_reader->num_read - 1) % sel->nb_shards == sel->shard) break;
+      nh_reader_release(boot_reader, alt_tree_string);
+    } while(1);
+    *i_tree = boot_reader->num_read - 1;
+  }
+  if (pt) pt->read_seconds += profile_wall() - start;
+  return alt_tree_string;
+}
+
+/* Number of the trees of the shard among the num_read first trees of the file */
+static int shard_num_trees(int num_read, const BootSelection *sel){
+  return num_read > sel->shard ? (num_read - sel->shard - 1) / sel->nb_shards + 1 : 0;
+}
+
+/* Counts in res[k]->sums the found edges of a bootstrap tree: found holds, for each of the nb_refs references
+   in turn, their number and then their ids */
+static void add_found_edges(int nb_refs, PartialResult **res, const int *found){
+  int j, k, pos = 0;
+  for (k = 0; k < nb_refs; k++) {
+    long *nb_found = res[k]->sums;
+    int nb_found_edges = found[pos++];
+    for (j = 0; j < nb_found_edges; j++) {
+      #pragma omp atomic update
+      nb_found[found[pos++]]++;
+    }
+  }
+}
+
+/* Indexes the clades of the reference trees (no bitsets needed, see fbp_intervals.h) */
+static FBPIndex** new_fbp_indices(int nb_refs, Tree **ref_trees){
+  FBPIndex **index = (FBPIndex**) malloc(nb_refs * sizeof(FBPIndex*));
+  for (int k = 0; k < nb_refs; k++) {
+    FBPWorkspace *ref_ws = new_fbp_workspace(ref_trees[k]->nb_nodes);
+    index[k] = new_fbp_index(ref_trees[k], ref_ws);
+    free_fbp_workspace(ref_ws);
+  }
+  return index;
+}
+
+/* The indices of the clades of the references, one copy per NUMA node: with --numa, each one is built by the
+   first thread of its node that asks for it (see fbp_node_index), so that it is in the memory of the node */
+static FBPIndex*** new_fbp_node_indices(int nb_refs, Tree **ref_trees, int nb_nodes){
+  FBPIndex ***index = (FBPIndex***) calloc(nb_nodes, sizeof(FBPIndex**));
+  if (numa == NULL) index[0] = new_fbp_indices(nb_refs, ref_trees);
+  return index;
+}
+
+/* The indices of the given NUMA node, built if needed by the calling (pinned) thread */
+static FBPIndex** fbp_node_index(FBPIndex ***index, int node, int nb_refs, Tree **ref_trees){
+  if (numa) {
+    #pragma omp critical (numa_replica)
+    if (index[node] == NULL) index[node] = new_fbp_indices(nb_refs, ref_trees);
+  }
+  return index[node];
+}
+
+static void free_fbp_node_indices(FBPIndex ***index, int nb_nodes, int nb_refs){
+  for (int node = 0; node < nb_nodes; node++) {
+    if (index[node] == NULL) continue; /* a node without threads */
+    for (int k = 0; k < nb_refs; k++) free_fbp_index(index[node][k]);
+    free(index[node]);
+  }
+  free(index);
+}
 
-  for(i=0; i< ref_tree->nb_edges; i++){
-    nb_found[i] = 0;
-    bitset_hashmap_putvalue(hm,ref_tree->a_edges[i]->hashtbl[1],ref_tree->nb_taxa,i);
+/* Adds to res[k] the edges of the reference trees (indexed in index) found in alt_tree, for the nb_refs
+   references. Their ids are left in *found (see add_found_edges), which is grown if needed.
+   Returns the number of ints of *found */
+static int add_fbp_tree(int nb_refs, FBPIndex **index, Tree *alt_tree, FBPWorkspace *ws, PartialResult **res,
+                        int **found, int *found_capacity){
+  int k, pos = 0;
+  if (nb_refs * (alt_tree->nb_edges + 1) > *found_capacity) {
+    *found_capacity = nb_refs * (alt_tree->nb_edges + 1);
+    *found = realloc(*found, *found_capacity * sizeof(int));
   }
+  for (k = 0; k < nb_refs; k++) {
+    (*found)[pos] = fbp_found_edges(index[k], alt_tree, ws, *found + pos + 1);
+    pos += (*found)[pos] + 1;
+  }
+  add_found_edges(nb_refs, res, *found);
+  return pos;
+}
+
+/* Pins the calling thread of a parallel region with --numa, and returns its node (0 without --numa).
+   Its previous cpus are saved in *saved (NULL without --numa), for numa_unpin_thread at the end of the region */
+static int pin_thread(ProfileThread *pt, NumaAffinity **saved){
+  *saved = NULL;
+  int node = numa ? numa_pin_thread(numa, omp_get_thread_num(), omp_get_num_threads(), saved) : 0;
+  if (pt) pt->numa_node = node;
+  return node;
+}
 
- 
-#pragma omp parallel for private( j, alt_tree, support) shared(nb_found, hm, ref_tree, alt_tree_strings, taxname_lookup_table, quiet, num_trees) schedule(dynamic)
-  for(i_tree=0; i_tree< num_trees; i_tree++){
+/* Accumulates into res[k] the selected bootstrap trees of boot_reader (see next_boot_tree_string), compared
+   to the reference tree ref_trees[k], for the nb_refs references. Each bootstrap tree is parsed once, and
+   if dedup is not NULL, the found edges of its topology are only computed the first time it is seen.
+   Returns the number of trees accumulated in res[0] */
+int fbp(int nb_refs, Tree **ref_trees, NHReader *boot_reader, char** taxname_lookup_table, map_t taxid_map,
+        PartialResult **res, const BootSelection *sel, TopoCache *dedup, int quiet){
+  int k;
+  Tree *alt_tree;
+  char *alt_tree_string;
+  int alt_tree_length;
+  int i_tree;
+  int first_read = boot_reader->num_read;
+  int n = ref_trees[0]->nb_taxa;
+  int max_nodes = 0; /* the workspaces are sized for the largest reference tree */
+  int node, nb_nodes = numa ? numa->nb_nodes : 1;
+  FBPIndex ***index = new_fbp_node_indices(nb_refs, ref_trees, nb_nodes);
+  for (k = 0; k < nb_refs; k++)
+    if (ref_trees[k]->nb_nodes > max_nodes) max_nodes = ref_trees[k]->nb_nodes;
+
+  /* each thread pulls the bootstrap trees from the reader, one at a time, and frees the string as soon as it is parsed */
+#pragma omp parallel private(k, alt_tree, alt_tree_string, alt_tree_length, i_tree, node) shared(res, index, nb_refs, n, max_nodes, boot_reader, sel, dedup, taxname_lookup_table, taxid_map, quiet)
+  {
+  ProfileThread *pt = profile ? &profile->threads[omp_get_thread_num()] : NULL;
+  NumaAffinity *saved_cpus;
+  node = pin_thread(pt, &saved_cpus); /* before anything is allocated: the memory of the thread is then on its node */
+  FBPIndex **node_index = fbp_node_index(index, node, nb_refs, ref_trees);
+  Arena *arena = arena_new(ARENA_BLOCK_SIZE); /* the bootstrap trees of this thread are built in it, one at a time */
+  FBPWorkspace *ws = new_fbp_workspace(max_nodes);
+  TopoWorkspace *topo_ws = dedup != NULL ? new_topo_workspace(max_nodes) : NULL;
+  int *found = NULL; /* ids of the reference edges found in the current boot tree (see add_found_edges) */
+  int found_capacity = 0;
+  while((alt_tree_string = next_boot_tree_string(boot_reader, sel, &i_tree, &alt_tree_length, pt)) != NULL){
     if(!quiet) fprintf(stderr,"New bootstrap tree : %d\n",i_tree);
-    alt_tree = complete_parse_nh(alt_tree_strings[i_tree], &taxname_lookup_table, false);
+    double t_parse = pt ? profile_wall() : 0;
+    arena_reset(arena); /* drops the previous tree */
+    alt_tree = load_boot_tree(alt_tree_string, alt_tree_length, &taxname_lookup_table, taxid_map, true, arena);
     
     if (alt_tree == NULL) {
-      fprintf(stderr,"Not a correct NH tree (%d). Skipping.\n%s\n",i_tree,alt_tree_strings[i_tree]);
+      fprintf(stderr,"Not a correct NH tree (%d). Skipping.\n%.*s\n",i_tree,boot_bin_taxa == NULL ? alt_tree_length : 0,alt_tree_string);
+      nh_reader_release(boot_reader, alt_tree_string);
+      if (pt) pt->skipped++;
       continue; /* some files maybe not containing trees */
     }
-    if (alt_tree->nb_taxa != ref_tree->nb_taxa) {
+    nh_reader_release(boot_reader, alt_tree_string);
+    if (alt_tree->nb_taxa != n) {
       fprintf(stderr,"This tree doesn't have the same number of taxa as the reference tree. Skipping.\n");
+      free_tree(alt_tree);
+      if (pt) pt->skipped++;
       continue; /* some files maybe not containing trees */
     }
+    double t_compare = pt ? profile_wall() : 0;
+
+    TopoKey topo_key;
+    if (dedup != NULL) {
+      const int *cached;
+      int nb_cached;
+      topo_key = tree_topology_key(alt_tree, topo_ws);
+      #pragma omp critical (topo_cache)
+      cached = topo_cache_get(dedup, topo_key, &nb_cached);
+      if (cached != NULL) {
+        add_found_edges(nb_refs, res, cached);
+        free_tree(alt_tree);
+        if (pt) profile_tree(pt, t_compare - t_parse, profile_wall() - t_compare);
+        continue;
+      }
+    }
 
     /****************************************************/
     /*     comparison of the bipartitions, FBP method   */
     /****************************************************/		  
-    for (j = 0; j <  alt_tree->nb_edges; j++) {
-      // We query the hashmap to see if the edge is present, and then get its reference index
-      int refindex = bitset_hashmap_value(hm, alt_tree->a_edges[j]->hashtbl[1], alt_tree->nb_taxa);
-      if (refindex>-1){
-        #pragma omp atomic update
-        nb_found[refindex]++;
-      }
+    int pos = add_fbp_tree(nb_refs, node_index, alt_tree, ws, res, &found, &found_capacity);
+    if (dedup != NULL) {
+      #pragma omp critical (topo_cache)
+      topo_cache_put(dedup, topo_key, found, pos);
     }
     free_tree(alt_tree);
+    if (pt) profile_tree(pt, t_compare - t_parse, profile_wall() - t_compare);
   }
+  free(found);
+  free_fbp_workspace(ws);
+  if (topo_ws != NULL) free_topo_workspace(topo_ws);
+  arena_free(arena);
+  numa_unpin_thread(saved_cpus);
+  } /* end of the parallel region */
+
+  for (k = 0; k < nb_refs; k++) {
+    res[k]->num_trees += shard_num_trees(boot_reader->num_read, sel) - shard_num_trees(first_read, sel);
+    res[k]->trees_read = boot_reader->num_read;
+  }
+  free_fbp_node_indices(index, nb_nodes, nb_refs);
+  return res[0]->num_trees;
+}
 
-  #pragma omp barrier
-
-  if(num_trees != 0) {
+/* Writes the supports of res into ref_tree */
+void fbp_supports(Tree *ref_tree, const PartialResult *res){
+  int i;
+  double support;
+  if(res->num_trees != 0) {
     for (i = 0; i <  ref_tree->nb_edges; i++) {
       if(ref_tree->a_edges[i]->right->nneigh == 1) { continue; }
       /* the bootstrap value for a branch is inscribed as the name of its descendant (always right side of the edge, by convention) */
       if(ref_tree->a_edges[i]->right->name) free(ref_tree->a_edges[i]->right->name); /* clear name if existing */
       ref_tree->a_edges[i]->right->name = (char*) malloc(16 * sizeof(char));
-      support   = (double) nb_found[i] * 1.0 / num_trees;
+      support   = (double) res->sums[i] * 1.0 / res->num_trees;
       sprintf(ref_tree->a_edges[i]->right->name, "%.6f", support);
       ref_tree->a_edges[i]->branch_support = support;
     }
   }
-  free(nb_found);
-  free_bitset_hashmap(hm);
 }
 
-void tbe(bool rapid, Tree *ref_tree, Tree *ref_raw_tree,
-         char **alt_tree_strings, char** taxname_lookup_table, FILE *stat_file,
-         int num_trees, int quiet, double dist_cutoff, int count_per_branch){
-  int m = ref_tree->nb_edges;
-  int n = ref_tree->nb_taxa;
-  int i_tree;
-  int **trans_ind_tmp;
-  int **trans_ind_new;
-  double *moved_species_counts;  /* array of average branch rate in which each taxon moves */
-  /** Max number of branches we can see in the bootstrap tree: If it has no multifurcation : binary tree--> ntax*2-2 (if rooted...) */
-  int max_branches_boot = ref_tree->nb_taxa*2-2;
-  
-  /* array a[i][j] of number of bootstrap tree from which each taxon j moves around the branch i and that are closer than given distance */
-  int **moved_species_counts_per_branch = NULL;
+/* Adds the m transfer indices of a bootstrap tree to their sums and to the sums of their squares */
+static void add_transfer_indices(const int *trans_ind, int m, long *sum, long *sq){
+  for (int i = 0; i < m; i++) {
+    sum[i] += trans_ind[i];
+    sq[i] += (long) trans_ind[i] * trans_ind[i];
+  }
+}
 
-  if(stat_file != NULL && count_per_branch){
-    moved_species_counts_per_branch = (int**) calloc(m,sizeof(int*));
-    for(int i=0;i<m;i++){
-      moved_species_counts_per_branch[i]  = (int*) calloc(n,sizeof(int));
-    }
+/* With --intra-tree, computes in ctx[k] the rapid TI of the nodes of refs[k] against the alt_tree prepared in
+   ctx[0], for the nb_refs references: the heavy paths of each reference are handed out to the threads in
+   chunks, each thread working on its own copy of the values of the flat alt_tree (workers[thread]) */
+static void intra_tree_rapidTI(int nb_refs, Tree **refs, Tree *alt_tree, RapidTIContext **ctx,
+                               RapidTIWorker **workers){
+  const int chunk = 64; /* leaves per chunk: the heavy paths are of very different lengths */
+  #pragma omp parallel num_threads(intra_threads) shared(nb_refs, refs, alt_tree, ctx, workers)
+  {
+  RapidTIWorker *w = workers[omp_get_thread_num()];
+  bind_rapidTI_worker(w, ctx[0]);
+  for (int k = 0; k < nb_refs; k++) {
+    int nb_leaves = refs[k]->nb_taxa;
+    #pragma omp for schedule(dynamic)
+    for (int i = 0; i < nb_leaves; i += chunk)
+      compute_heavy_paths_rapidTI(refs[k], i, i + chunk < nb_leaves ? i + chunk : nb_leaves, alt_tree, ctx[k], w);
+  }
   }
+}
 
-  trans_ind_tmp = (int**) calloc(num_trees,sizeof(int*)); /* array of index sums, one per boot tree and branch. Initialized to 0. */
-  for(i_tree=0; i_tree< num_trees; i_tree++)
-    trans_ind_tmp[i_tree]  = (int*) calloc(m,sizeof(int)); /* array of index sums, one per branch. Initialized to 0. */
+/* Accumulates into res[k] the selected bootstrap trees of boot_reader (see next_boot_tree_string), compared
+   to the reference tree ref_trees[k], for the nb_refs references, with their moved species statistics if
+   res[k]->has_stats. Each bootstrap tree is parsed and prepared once, for all the references, and if dedup is
+   not NULL, the transfer indices of its topology are only computed the first time it is seen.
+   If fbp_res is not NULL (--fbp-out), the FBP found edges of each tree are also accumulated into fbp_res[k],
+   on the same parsed tree.
+   Returns the number of trees accumulated in res[0] */
+int tbe(bool rapid, int nb_refs, Tree **ref_trees,
+        NHReader *boot_reader, char** taxname_lookup_table, map_t taxid_map,
+        PartialResult **res, PartialResult **fbp_res, const BootSelection *sel, TopoCache *dedup, int quiet,
+        double dist_cutoff){
+  int n = ref_trees[0]->nb_taxa;
+  int max_m = 0; /* the largest number of edges of the reference trees */
+  int i_tree, k;
+  int first_read = boot_reader->num_read;
+  /** Max number of branches we can see in the bootstrap tree: If it has no multifurcation : binary tree--> ntax*2-2 (if rooted...) */
+  int max_branches_boot = n*2-2;
+  /* the transfer indices of a boot tree for all the references are in one array: the ones of ref_trees[k] start at ti_offset[k] */
+  int *ti_offset = (int*) malloc((nb_refs + 1)*sizeof(int));
+
+  ti_offset[0] = 0;
+  for (k = 0; k < nb_refs; k++) {
+    if (ref_trees[k]->nb_edges > max_m) max_m = ref_trees[k]->nb_edges;
+    ti_offset[k + 1] = ti_offset[k] + ref_trees[k]->nb_edges;
+  }
 
   bool skip_hashtables = rapid;
+  /* with --numa, the rapid TI of the threads of each NUMA node reads its own copy of the reference trees, made
+     by one of these (pinned) threads: the classic TBE only reads its per thread matrices */
+  bool replicate = numa != NULL && rapid;
+  int node, nb_nodes = numa ? numa->nb_nodes : 1;
+  Tree ***node_refs = (Tree***) calloc(nb_nodes, sizeof(Tree**));
+  FBPIndex ***fbp_index = fbp_res != NULL ? new_fbp_node_indices(nb_refs, ref_trees, nb_nodes) : NULL;
+  int max_nodes = 0; /* the FBP workspaces are sized for the largest reference tree */
+  for (k = 0; k < nb_refs; k++)
+    if (ref_trees[k]->nb_nodes > max_nodes) max_nodes = ref_trees[k]->nb_nodes;
+  /* with --intra-tree, the trees are compared one at a time, each one by the intra_threads workers */
+  RapidTIWorker **workers = NULL;
+  if (intra_threads > 0 && rapid) {
+    workers = (RapidTIWorker**) malloc(intra_threads * sizeof(RapidTIWorker*));
+    for (k = 0; k < intra_threads; k++) workers[k] = new_rapidTI_worker();
+  }
   #ifdef COMPARE_TBE_METHODS
   skip_hashtables = false;
-
-  trans_ind_new = (int**) calloc(num_trees,sizeof(int*)); /* array of index sums, one per boot tree and branch. Initialized to 0. */
-  for(i_tree=0; i_tree< num_trees; i_tree++)
-    trans_ind_new[i_tree]  = (int*) calloc(m,sizeof(int)); /* array of index sums, one per branch. Initialized to 0. */
+  replicate = false; /* the copies have no hashtables */
   #endif
 
-  moved_species_counts = (double*) calloc(m,sizeof(double)); /* array of average branch rate in which each taxon moves */
-
   Tree *alt_tree;
-  Tree *ref_tree_copy = NULL;   // For use with parallel computation.
-  #pragma omp parallel for private(alt_tree, ref_tree_copy) shared(ref_tree, max_branches_boot, alt_tree_strings, trans_ind_tmp, trans_ind_new, taxname_lookup_table, n, m, moved_species_counts, moved_species_counts_per_branch) schedule(dynamic)
-  for(i_tree=0; i_tree< num_trees; i_tree++){
+  char *alt_tree_string;
+  int alt_tree_length;
+  /* each thread pulls the bootstrap trees from the reader, one at a time, and frees the string as soon as it is parsed */
+  #pragma omp parallel if(workers == NULL) private(alt_tree, alt_tree_string, alt_tree_length, i_tree, k, node) shared(workers, ref_trees, node_refs, replicate, nb_refs, max_branches_boot, boot_reader, sel, dedup, res, fbp_res, fbp_index, max_nodes, taxname_lookup_table, taxid_map, n, max_m, ti_offset)
+  {
+  ProfileThread *pt = profile ? &profile->threads[omp_get_thread_num()] : NULL;
+  NumaAffinity *saved_cpus;
+  node = pin_thread(pt, &saved_cpus); /* before anything is allocated: the memory of the thread is then on its node */
+  Tree **refs = ref_trees; /* the reference trees this thread reads */
+  if (replicate) {
+    #pragma omp critical (numa_replica)
+    if (node_refs[node] == NULL) {
+      node_refs[node] = (Tree**) malloc(nb_refs * sizeof(Tree*));
+      for (k = 0; k < nb_refs; k++) node_refs[node][k] = copy_tree_rapidTI(ref_trees[k]);
+    }
+    refs = node_refs[node];
+  }
+  FBPIndex **node_fbp_index = fbp_res != NULL ? fbp_node_index(fbp_index, node, nb_refs, ref_trees) : NULL;
+  FBPWorkspace *fbp_ws = fbp_res != NULL ? new_fbp_workspace(max_nodes) : NULL;
+  int *fbp_found = NULL; /* ids of the reference edges found in the current boot tree (see add_found_edges) */
+  int fbp_found_capacity = 0;
+  int *trans_ind_all = (int*) malloc(ti_offset[nb_refs]*sizeof(int)); /* transfer indices of the current boot tree, one per branch */
+  TopoWorkspace *topo_ws = dedup != NULL ? new_topo_workspace(2*n) : NULL;
+  long **trans_ind_sum = (long**) malloc(nb_refs*sizeof(long*)); /* sums of the transfer indices of the trees of this thread */
+  long **trans_ind_sq = (long**) malloc(nb_refs*sizeof(long*)); /* and of their squares */
+  #ifdef COMPARE_TBE_METHODS
+  int *trans_ind_new = (int*) malloc(max_m*sizeof(int));
+  #endif
+  Arena *arena = arena_new(ARENA_BLOCK_SIZE); /* the bootstrap trees of this thread are built in it, one at a time */
+  /* the ref trees are shared read-only by the threads: the values that the rapid TI computes on them are kept in
+     these contexts, which share the flat bootstrap tree of the first one */
+  RapidTIContext **rapid_ctx = (RapidTIContext**) calloc(nb_refs, sizeof(RapidTIContext*));
+  /* the matrices of the classic TBE are allocated once per thread, and reused for all its trees */
+  TBEWorkspace **tbe_ws = (TBEWorkspace**) calloc(nb_refs, sizeof(TBEWorkspace*));
+  for (k = 0; k < nb_refs; k++) {
+    trans_ind_sum[k] = (long*) calloc(ref_trees[k]->nb_edges, sizeof(long));
+    trans_ind_sq[k] = (long*) calloc(ref_trees[k]->nb_edges, sizeof(long));
+    #ifndef COMPARE_TBE_METHODS
+    if (rapid)
+    #endif
+      rapid_ctx[k] = k == 0 ? new_rapidTI_context(refs[0]) : new_rapidTI_context_sharing(refs[k], rapid_ctx[0]);
+    #ifndef COMPARE_TBE_METHODS
+    if (!rapid)
+    #endif
+      tbe_ws[k] = new_tbe_workspace(ref_trees[k], max_branches_boot);
+  }
+  /* the moved species of a tree in rapid mode, only computed for the statistics */
+  int *rapid_moved = NULL, *rapid_sm = NULL;
+  if (rapid && res[0]->has_stats) {
+    rapid_moved = (int*) malloc(n*sizeof(int));
+    rapid_sm = (int*) malloc(n*sizeof(int));
+  }
+  while((alt_tree_string = next_boot_tree_string(boot_reader, sel, &i_tree, &alt_tree_length, pt)) != NULL){
     if(!quiet) fprintf(stderr,"New bootstrap tree : %d\n",i_tree);
-    alt_tree = complete_parse_nh(alt_tree_strings[i_tree], &taxname_lookup_table, skip_hashtables);
+    double t_parse = pt ? profile_wall() : 0;
+    arena_reset(arena); /* drops the previous tree */
+    alt_tree = load_boot_tree(alt_tree_string, alt_tree_length, &taxname_lookup_table, taxid_map, skip_hashtables, arena);
     
     if (alt_tree == NULL) {
-      fprintf(stderr,"Not a correct NH tree (%d). Skipping.\n%s\n",i_tree,alt_tree_strings[i_tree]);
+      fprintf(stderr,"Not a correct NH tree (%d). Skipping.\n%.*s\n",i_tree,boot_bin_taxa == NULL ? alt_tree_length : 0,alt_tree_string);
+      nh_reader_release(boot_reader, alt_tree_string);
+      if (pt) pt->skipped++;
       continue; /* some files maybe not containing trees */
     }
+    nh_reader_release(boot_reader, alt_tree_string);
     if (alt_tree->nb_taxa != n) {
       fprintf(stderr,"This tree doesn't have the same number of taxa as the reference tree. Skipping.\n");
+      free_tree(alt_tree);
+      if (pt) pt->skipped++;
       continue; /* some files maybe not containing trees */
     }
+    double t_compare = pt ? profile_wall() : 0;
+
+    /* the FBP supports, on the same parsed tree: cheap, they are not cached with --dedup */
+    if (fbp_res != NULL) add_fbp_tree(nb_refs, node_fbp_index, alt_tree, fbp_ws, fbp_res, &fbp_found, &fbp_found_capacity);
+
+    TopoKey topo_key;
+    if (dedup != NULL) {
+      const int *cached;
+      int nb_cached;
+      topo_key = tree_topology_key(alt_tree, topo_ws);
+      #pragma omp critical (topo_cache)
+      cached = topo_cache_get(dedup, topo_key, &nb_cached);
+      if (cached != NULL) {
+        for (k = 0; k < nb_refs; k++)
+          add_transfer_indices(cached + ti_offset[k], ref_trees[k]->nb_edges, trans_ind_sum[k], trans_ind_sq[k]);
+        free_tree(alt_tree);
+        if (pt) profile_tree(pt, t_compare - t_parse, profile_wall() - t_compare);
+        continue;
+      }
+    }
+
+    if (rapid_ctx[0] != NULL) prepare_alt_tree_rapidTI(alt_tree, rapid_ctx[0]);
+    #ifndef COMPARE_TBE_METHODS
+    if (workers != NULL) intra_tree_rapidTI(nb_refs, refs, alt_tree, rapid_ctx, workers);
+    #endif
+
+    for (k = 0; k < nb_refs; k++) {
+    Tree *ref_tree = refs[k];
+    int m = ref_tree->nb_edges;
+    int *trans_ind_tmp = trans_ind_all + ti_offset[k];
+    for (int i = 0; i < m; i++) trans_ind_tmp[i] = 0;
 
     #ifndef COMPARE_TBE_METHODS
     if (rapid) {
-      if(omp_get_num_threads() > 1)        //If parallel, we copy ref_tree
-        ref_tree_copy = copy_tree_rapidTI(ref_tree);
+      if (workers != NULL)
+        nodeTI_to_edgeTI(ref_tree, rapid_ctx[k], trans_ind_tmp);
       else
-        ref_tree_copy = ref_tree;
-    
-      compute_transfer_indices_new(ref_tree_copy, n, m, alt_tree,
-                                   trans_ind_tmp[i_tree]);
-
-      if(omp_get_num_threads() > 1)
-        free_tree(ref_tree_copy);
+        compute_transfer_indices_prepared(ref_tree, n, m, alt_tree,
+                                          trans_ind_tmp, rapid_ctx[k]);
+      if (rapid_moved != NULL)
+        compute_moved_species_rapid(ref_tree, n, m, trans_ind_tmp, rapid_ctx[k],
+                                    rapid_moved, rapid_sm, res[k]->moved_species_counts,
+                                    res[k]->moved_species_counts_per_branch,
+                                    res[k]->has_per_branch, dist_cutoff);
     }
     else
-      compute_transfer_indices(ref_tree, n, m, alt_tree, trans_ind_tmp[i_tree],
-                               max_branches_boot, moved_species_counts,
-                               moved_species_counts_per_branch,
-                               count_per_branch, dist_cutoff);
+      compute_transfer_indices(ref_tree, n, m, alt_tree, trans_ind_tmp,
+                               tbe_ws[k], res[k]->moved_species_counts,
+                               res[k]->moved_species_counts_per_branch,
+                               res[k]->has_per_branch, dist_cutoff);
 
     #else
       //This compares the old and rapid methods:
-    if(omp_get_num_threads() > 1)
-      ref_tree_copy = copy_tree_rapidTI(ref_tree);
-    else
-      ref_tree_copy = ref_tree;
-    
-    compute_transfer_indices_new(ref_tree_copy, n, m, alt_tree,
-                                 trans_ind_new[i_tree]);
-
-    if(omp_get_num_threads() > 1)
-      free_tree(ref_tree_copy);
-
-    compute_transfer_indices(ref_tree, n, m, alt_tree, trans_ind_tmp[i_tree],
-                             max_branches_boot, moved_species_counts,
-                             moved_species_counts_per_branch,
-                             count_per_branch, dist_cutoff);
-    assert_equal_TI(trans_ind_new[i_tree], trans_ind_tmp[i_tree], ref_tree);
+    for (int i = 0; i < m; i++) trans_ind_new[i] = 0;
+    compute_transfer_indices_prepared(ref_tree, n, m, alt_tree,
+                                      trans_ind_new, rapid_ctx[k]);
+
+    compute_transfer_indices(ref_tree, n, m, alt_tree, trans_ind_tmp,
+                             tbe_ws[k], res[k]->moved_species_counts,
+                             res[k]->moved_species_counts_per_branch,
+                             res[k]->has_per_branch, dist_cutoff);
+    assert_equal_TI(trans_ind_new, trans_ind_tmp, ref_tree);
     #endif
 
+    add_transfer_indices(trans_ind_tmp, m, trans_ind_sum[k], trans_ind_sq[k]);
+    }
+    if (dedup != NULL) {
+      #pragma omp critical (topo_cache)
+      topo_cache_put(dedup, topo_key, trans_ind_all, ti_offset[nb_refs]);
+    }
+    free_tree(alt_tree);
+    if (pt) profile_tree(pt, t_compare - t_parse, profile_wall() - t_compare);
   }
-  #pragma omp barrier
-
-  int *trans_ind = (int*) calloc(m,sizeof(int)); //array of index sums, one
-                                                 //per branch. Initialized to 0.
-  for (int i = 0; i < m; i++){
-    for(i_tree=0; i_tree < num_trees; i_tree++){
-      trans_ind[i] += trans_ind_tmp[i_tree][i];
+  /* the sums of the threads are merged once, when they have no more trees to process */
+  double t_reduce = pt ? profile_wall() : 0;
+  #pragma omp critical (trans_ind)
+  for (k = 0; k < nb_refs; k++)
+    for (int i = 0; i < ref_trees[k]->nb_edges; i++) {
+      res[k]->sums[i] += trans_ind_sum[k][i];
+      if (res[k]->has_squares) res[k]->sums_sq[i] += trans_ind_sq[k][i];
     }
+  if (pt) pt->reduce_seconds += profile_wall() - t_reduce;
+  /* the contexts sharing the flat tree of the first one are freed before it */
+  for (k = nb_refs - 1; k >= 0; k--) {
+    free(trans_ind_sum[k]);
+    free(trans_ind_sq[k]);
+    if (rapid_ctx[k] != NULL) free_rapidTI_context(rapid_ctx[k]);
+    if (tbe_ws[k] != NULL) free_tbe_workspace(tbe_ws[k]);
+  }
+  free(trans_ind_sum);
+  free(trans_ind_sq);
+  free(rapid_ctx);
+  free(tbe_ws);
+  free(trans_ind_all);
+  if (topo_ws != NULL) free_topo_workspace(topo_ws);
+  arena_free(arena);
+  free(rapid_moved);
+  free(rapid_sm);
+  free(fbp_found);
+  if (fbp_ws != NULL) free_fbp_workspace(fbp_ws);
+  #ifdef COMPARE_TBE_METHODS
+  free(trans_ind_new);
+  #endif
+  numa_unpin_thread(saved_cpus);
+  } /* end of the parallel region */
+
+  for (k = 0; k < nb_refs; k++) {
+    res[k]->num_trees += shard_num_trees(boot_reader->num_read, sel) - shard_num_trees(first_read, sel);
+    res[k]->trees_read = boot_reader->num_read;
+    if (fbp_res == NULL) continue;
+    fbp_res[k]->num_trees = res[k]->num_trees;
+    fbp_res[k]->trees_read = res[k]->trees_read;
+  }
+  if (fbp_index != NULL) free_fbp_node_indices(fbp_index, nb_nodes, nb_refs);
+  for (node = 0; node < nb_nodes; node++) {
+    if (node_refs[node] == NULL) continue;
+    for (k = 0; k < nb_refs; k++) free_tree(node_refs[node][k]);
+    free(node_refs[node]);
   }
+  free(node_refs);
+  if (workers != NULL) {
+    for (k = 0; k < intra_threads; k++) free_rapidTI_worker(workers[k]);
+    free(workers);
+  }
+  free(ti_offset);
+  return res[0]->num_trees;
+}
 
-  int card;
+/* Writes the supports of res into ref_tree (and the raw ones into ref_raw_tree if not NULL), and its
+   statistics into stat_file if not NULL */
+void tbe_supports(Tree *ref_tree, Tree *ref_raw_tree, const PartialResult *res,
+                  char** taxname_lookup_table, FILE *stat_file){
+  int m = ref_tree->nb_edges;
+  int n = ref_tree->nb_taxa;
+  int num_trees = res->num_trees;
+  long *trans_ind = res->sums;
   double bootstrap_val, avg_dist;
 
   if(num_trees != 0) {
@@ -537,8 +1356,6 @@ void tbe(bool rapid, Tree *ref_tree, Tree *ref_raw_tree,
       /* the bootstrap value for a branch is inscribed as the name of its descendant (always right side of the edge, by convention) */
       if(ref_tree->a_edges[i]->right->name) free(ref_tree->a_edges[i]->right->name); /* clear name if existing */
       ref_tree->a_edges[i]->right->name = (char*) malloc(16 * sizeof(char));
-      card = ref_tree->a_edges[i]->hashtbl[1]->num_items;
-      if (card > n/2) { card = n - card; }	  
       avg_dist      = (double) trans_ind[i] * 1.0 / num_trees;
       bootstrap_val = (double) 1.0 - avg_dist * 1.0 / (1.0 * ref_tree->a_edges[i]->topo_depth-1.0);
 
@@ -552,23 +1369,21 @@ void tbe(bool rapid, Tree *ref_tree, Tree *ref_raw_tree,
       if(ref_raw_tree!=NULL){
         /* the bootstrap value for a branch is inscribed as the name of its descendant as id|avgdist|depth */
         if(ref_raw_tree->a_edges[i]->right->name) free(ref_raw_tree->a_edges[i]->right->name); /* clear name if existing */
-        ref_raw_tree->a_edges[i]->right->name = (char*) malloc(16 * sizeof(char));
-        card = ref_raw_tree->a_edges[i]->hashtbl[1]->num_items;
-        if (card > n/2) { card = n - card; }
+        ref_raw_tree->a_edges[i]->right->name = (char*) malloc(64 * sizeof(char)); /* room for the ids and depths of large trees */
         avg_dist      = (double) trans_ind[i] * 1.0 / num_trees;
-        sprintf(ref_raw_tree->a_edges[i]->right->name, "%d|%.6f|%d", ref_raw_tree->a_edges[i]->id, avg_dist,ref_tree->a_edges[i]->topo_depth);
+        snprintf(ref_raw_tree->a_edges[i]->right->name, 64, "%d|%.6f|%d", ref_raw_tree->a_edges[i]->id, avg_dist,ref_tree->a_edges[i]->topo_depth);
       }
     }
 
     if(stat_file != NULL){
       fprintf(stat_file,"Taxon\ttIndex\n");
       for(int i=0; i<n;i++){
-        fprintf(stat_file,"%s\t%f\n", taxname_lookup_table[i], moved_species_counts[i]*100.0 / ((double)num_trees));
+        fprintf(stat_file,"%s\t%f\n", taxname_lookup_table[i], res->moved_species_counts[i]*100.0 / ((double)num_trees));
       }
     }
   }
 
-  if(stat_file != NULL && count_per_branch){
+  if(stat_file != NULL && res->has_per_branch){
     fprintf(stat_file,"Edge\tSupport");
     for(int i=0; i<n;i++){
       fprintf(stat_file,"\t%s", taxname_lookup_table[i]);
@@ -578,29 +1393,11 @@ void tbe(bool rapid, Tree *ref_tree, Tree *ref_raw_tree,
       if(ref_tree->a_edges[i]->right->nneigh == 1) { continue; }
       fprintf(stat_file,"%d\t%s", i,ref_tree->a_edges[i]->right->name);
       for(int j=0;j<n;j++){
-        fprintf(stat_file,"\t%f",moved_species_counts_per_branch[i][j]*1.0/num_trees);
+        fprintf(stat_file,"\t%f",res->moved_species_counts_per_branch[i][j]*1.0/num_trees);
       }
       fprintf(stat_file,"\n");
     }
-    for(int i=0;i<m;i++){
-      free(moved_species_counts_per_branch[i]);
-    }
-    free(moved_species_counts_per_branch);
   }
-  
-  free(trans_ind);
-  for(i_tree=0; i_tree < num_trees;i_tree++){
-    free(trans_ind_tmp[i_tree]);
-  }
-  free(trans_ind_tmp);
-
-  #ifdef COMPARE_TBE_METHODS
-  for(i_tree=0; i_tree < num_trees;i_tree++)
-    free(trans_ind_new[i_tree]);
-  free(trans_ind_new);
-  #endif
-
-  free(moved_species_counts);
 }
 
 /*
@@ -613,7 +1410,6 @@ void assert_equal_TI(int *ti_new, int *ti_old, Tree *ref_tree) {
       same = false;
       fprintf(stderr, "mismatch: pos %d new %d old %d\n", i,
               ti_new[i], ti_old[i]);
-      fprintf(stderr, "    node ti_min: %i\n", ref_tree->a_edges[i]->right->ti_min);
       fprintf(stderr, "    "); print_node(ref_tree->a_edges[i]->right);
     }
   }
@@ -630,89 +1426,134 @@ transfer_index[i] will have the transfer index for edge i.
 */
 void compute_transfer_indices(Tree *ref_tree, const int n, const int m,
                               Tree *alt_tree, int *transfer_index,
-                              const int max_branches_boot,
+                              TBEWorkspace *ws,
                               double *moved_species_counts,
                               int **moved_species_counts_per_branch,
                               int count_per_branch, const double dist_cutoff){
   
-  short unsigned** c_matrix;     //matrix of cardinals of complements
-  short unsigned** i_matrix;     //matrix of cardinals of intersections
-  short unsigned** hamming;      //matrix of Hamming distances
-  short unsigned* min_dist_edge; //edge ids corresponding to min Hamming dists
-  short unsigned* min_dist;      //edge ids corresponding to min Hamming dists
+  int* min_dist_edge; //edge ids corresponding to min Hamming dists
+  int* min_dist;      //min Hamming dists
   int *moved_species; /* array of number of branches in which each taxon moves, in one bootstrap tree: initialized at each bootstrap tree */
-  moved_species = (int*) calloc(n,sizeof(int));
-
-  /* resetting the arrays that need be reset. By construction of the post-order traversal,
-     the other arrays (i_matrix, c_matrix and hamming) need not be reset. */
-  reset_matrices(n, m, max_branches_boot, &c_matrix, &i_matrix, &hamming, &min_dist,&min_dist_edge);
 
   /****************************************************/
   /* comparison of the bipartitions, Transfer method */
   /****************************************************/		  
   /* calculation of the C and I matrices (see Brehelin/Gascuel/Martin) */
-  update_all_i_c_post_order_ref_tree(ref_tree, alt_tree, i_matrix, c_matrix);
-  update_all_i_c_post_order_boot_tree(ref_tree, alt_tree, i_matrix, c_matrix, hamming, min_dist, min_dist_edge);
+  tbe_min_distances(ws, ref_tree, alt_tree);
+  min_dist = ws->min_dist;
+  min_dist_edge = ws->min_dist_edge;
+  moved_species = ws->moved_species;
 
   /* Looking at number of times each taxon moves around low distance branches */
   int nb_branches_close=0;
-  int i, j;
+  int i;
   for(i=0;i<m;i++){
     Edge* re = ref_tree->a_edges[i];
     if (re->right->nneigh == 1) continue;
     Edge* be = alt_tree->a_edges[min_dist_edge[i]];
 
-    double norm  = ((double)min_dist[i]) * 1.0 / (((double)re->topo_depth) - 1.0);
-    int mindepth = (int)(ceil(1.0/dist_cutoff + 1.0));
     int* sm = species_to_move(re, be, min_dist[i], n);
-    for(j=0;j<min_dist[i];j++){
-      if (norm <= dist_cutoff && re->topo_depth >= mindepth ){
-        moved_species[sm[j]]++;
-      }
-      if(moved_species_counts_per_branch != NULL && count_per_branch){
-        #pragma omp atomic update
-        moved_species_counts_per_branch[i][sm[j]]++;
-      }
-    }
-    if (norm <= dist_cutoff && re->topo_depth >= mindepth ){
-      nb_branches_close++;
-      }
+    nb_branches_close += add_moved_species(re, sm, min_dist[i], moved_species, moved_species_counts_per_branch,
+                                           count_per_branch, dist_cutoff);
     free(sm);
   }
 
   for (i = 0; i < m; i++) {          //Record the transfer index for each edge.
     transfer_index[i] = min_dist[i];
   }
+  add_moved_species_counts(n, moved_species, nb_branches_close, moved_species_counts);
+}
+
+/*
+Compute the moved species statistics of the bootstrap tree of the last
+compute_transfer_indices_new() call on ctx, from the closest edges it found.
+
+The taxa to move are only listed for the edges that need them: the close ones,
+or all of them when they are counted per branch.
+*/
+void compute_moved_species_rapid(Tree *ref_tree, const int n, const int m,
+                                 const int *transfer_index, RapidTIContext *ctx,
+                                 int *moved_species, int *sm,
+                                 double *moved_species_counts,
+                                 int **moved_species_counts_per_branch,
+                                 int count_per_branch, const double dist_cutoff){
+  int nb_branches_close=0;
+  int i, dist;
+  int mindepth = (int)(ceil(1.0/dist_cutoff + 1.0));
+  bool all = moved_species_counts_per_branch != NULL && count_per_branch;
+
+  for (i=0; i < n; i++) moved_species[i] = 0;
+  for(i=0;i<m;i++){
+    Edge* re = ref_tree->a_edges[i];
+    if (re->right->nneigh == 1) continue;
+    double norm  = ((double)transfer_index[i]) * 1.0 / (((double)re->topo_depth) - 1.0);
+    if (!all && !(norm <= dist_cutoff && re->topo_depth >= mindepth)) continue;
+
+    dist = rapid_moved_taxa(re->right, n, ctx, sm);
+    if(dist != transfer_index[i]){
+      fprintf(stderr,"Length of moved species array (%d) is not equal to the minimum distance found (%d)\n", dist, transfer_index[i]);
+      Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+    }
+    nb_branches_close += add_moved_species(re, sm, dist, moved_species, moved_species_counts_per_branch,
+                                           count_per_branch, dist_cutoff);
+  }
+  add_moved_species_counts(n, moved_species, nb_branches_close, moved_species_counts);
+}
+
+/*
+Count the dist taxa of sm, that move around the edge re of the reference tree:
+in moved_species if re is close to the bootstrap tree, and per branch if asked.
+Returns 1 if re is close (normalized distance within dist_cutoff), 0 otherwise.
+*/
+int add_moved_species(Edge *re, const int *sm, int dist, int *moved_species,
+                      int **moved_species_counts_per_branch,
+                      int count_per_branch, const double dist_cutoff){
+  double norm  = ((double)dist) * 1.0 / (((double)re->topo_depth) - 1.0);
+  int mindepth = (int)(ceil(1.0/dist_cutoff + 1.0));
+  int close = norm <= dist_cutoff && re->topo_depth >= mindepth;
+  int j;
+  for(j=0;j<dist;j++){
+    if (close){
+      moved_species[sm[j]]++;
+    }
+    if(moved_species_counts_per_branch != NULL && count_per_branch){
+      #pragma omp atomic update
+      moved_species_counts_per_branch[re->id][sm[j]]++;
+    }
+  }
+  return close;
+}
+
+/*
+Add the moved species of one bootstrap tree to the counts over all the trees.
+*/
+void add_moved_species_counts(int n, const int *moved_species, int nb_branches_close,
+                              double *moved_species_counts){
+  int i;
   for (i=0; i < n; i++){
     #pragma omp atomic update
     moved_species_counts[i] += ((double)moved_species[i])*1.0/((double)nb_branches_close);
   }
-
-  free_matrices(m, &c_matrix, &i_matrix, &hamming, &min_dist,&min_dist_edge);
-  free_tree(alt_tree);
-  free(moved_species);
 }
 
 // Returns the list of id of species to move to go from one branch to the other
 // Its length should correspond to given dist
 // If not, exit with an error
 int* species_to_move(Edge* re, Edge* be, int dist, int nb_taxa) {
-  int i;
   int maxnb = dist;
   if(nb_taxa-dist >= dist) maxnb=nb_taxa-dist;
   int *diff = calloc(maxnb,sizeof(int));
   int *equ  = calloc(maxnb,sizeof(int));
   int nbdiff=0, nbequ=0;
 
-  for(i = 0; i < nb_taxa; i++) {
-    if(lookup_id(re->hashtbl[1],i) != lookup_id(be->hashtbl[1],i)){
-      diff[nbdiff]=i;
-      nbdiff++;
-    } else {
-      equ[nbequ] = i;
-      nbequ++;
-    }
-  }
+  /* the taxa in the symmetric difference of the two bipartitions are counted word by word, and only the
+     smallest of the two lists (moving the taxa in, or out of, the difference) is listed */
+  nbdiff = bitset_xor_count(re->hashtbl[1]->bitarray, be->hashtbl[1]->bitarray, nb_taxa);
+  nbequ = nb_taxa - nbdiff;
+  if(nbdiff < nbequ)
+    bitset_xor_ids(re->hashtbl[1]->bitarray, be->hashtbl[1]->bitarray, nb_taxa, 0, diff);
+  else
+    bitset_xor_ids(re->hashtbl[1]->bitarray, be->hashtbl[1]->bitarray, nb_taxa, 1, equ);
   if(nbdiff < nbequ){
     if(nbdiff != dist){
       fprintf(stderr,"Length of moved species array (%d) is not equal to the minimum distance found (%d)\n", nbdiff, dist);
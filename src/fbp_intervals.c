@@ -0,0 +1,189 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "fbp_intervals.h"
+
+#include <limits.h>
+
+
+FBPWorkspace* new_fbp_workspace(int capacity) {
+	FBPWorkspace* ws = (FBPWorkspace*) malloc(sizeof(FBPWorkspace));
+	ws->capacity = capacity;
+	ws->order = (Node**) malloc(capacity * sizeof(Node*));
+	ws->parent_pos = (int*) malloc(capacity * sizeof(int));
+	ws->parent_edge = (int*) malloc(capacity * sizeof(int));
+	ws->min = (int*) malloc(capacity * sizeof(int));
+	ws->max = (int*) malloc(capacity * sizeof(int));
+	ws->size = (int*) malloc(capacity * sizeof(int));
+	ws->stack_node = (Node**) malloc(capacity * sizeof(Node*));
+	ws->stack_parent = (int*) malloc(capacity * sizeof(int));
+	ws->stack_edge = (int*) malloc(capacity * sizeof(int));
+	return ws;
+}
+
+
+void free_fbp_workspace(FBPWorkspace* ws) {
+	free(ws->order); free(ws->parent_pos); free(ws->parent_edge);
+	free(ws->min); free(ws->max); free(ws->size);
+	free(ws->stack_node); free(ws->stack_parent); free(ws->stack_edge);
+	free(ws);
+}
+
+
+static void reserve_fbp_workspace(FBPWorkspace* ws, int capacity) {
+	if (capacity <= ws->capacity) return;
+	FBPWorkspace* bigger = new_fbp_workspace(capacity);
+	FBPWorkspace tmp = *ws;
+	*ws = *bigger;
+	*bigger = tmp;
+	free_fbp_workspace(bigger); /* which now holds the old arrays */
+}
+
+
+/* returns the leaf of the given taxon, dies if the tree does not have it */
+static Node* leaf_of_taxon(Tree* tree, int taxon_id) {
+	int i;
+	for (i = 0; i < tree->nb_nodes; i++)
+		if (tree->a_nodes[i]->nneigh == 1 && tree->a_nodes[i]->taxon_id == taxon_id) return tree->a_nodes[i];
+	fprintf(stderr,"Fatal error : taxon %d of the reference tree not found in a bootstrap tree! Aborting.\n", taxon_id);
+	Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+	return NULL;
+}
+
+
+/* puts the nodes of tree into ws->order, in a pre-order traversal starting from the given leaf,
+   and returns their number */
+static int traverse_from_leaf(Tree* tree, Node* start, FBPWorkspace* ws) {
+	int i, top = 0, nb = 0;
+	reserve_fbp_workspace(ws, tree->nb_nodes);
+	ws->stack_node[top] = start; ws->stack_parent[top] = -1; ws->stack_edge[top] = -1; top++;
+	while (top) {
+		top--;
+		Node* u = ws->stack_node[top];
+		int pos = nb++;
+		ws->order[pos] = u;
+		ws->parent_pos[pos] = ws->stack_parent[top];
+		ws->parent_edge[pos] = ws->stack_edge[top];
+		Node* parent = (pos == 0 ? NULL : ws->order[ws->parent_pos[pos]]);
+		/* pushed in reverse order, so that the neighbours are visited in the order of u->neigh */
+		for (i = u->nneigh - 1; i >= 0; i--) {
+			if (u->neigh[i] == parent) continue;
+			ws->stack_node[top] = u->neigh[i]; ws->stack_parent[top] = pos; ws->stack_edge[top] = u->br[i]->id; top++;
+		}
+	}
+	return nb;
+}
+
+
+/* sets min, max and size of the clade of every node of ws->order, with the given ranks of the taxa */
+static void compute_clades(FBPWorkspace* ws, int nb, const int* rank) {
+	int k;
+	for (k = 1; k < nb; k++) { ws->min[k] = INT_MAX; ws->max[k] = -1; ws->size[k] = 0; }
+	for (k = nb - 1; k > 0; k--) { /* children before their parent */
+		Node* u = ws->order[k];
+		if (u->nneigh == 1) {
+			if (u->taxon_id < 0) {
+				fprintf(stderr,"Fatal error : taxon %s not found! Aborting.\n", u->name);
+				Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+			}
+			ws->min[k] = ws->max[k] = rank[u->taxon_id];
+			ws->size[k] = 1;
+		}
+		int p = ws->parent_pos[k];
+		if (p > 0) {
+			if (ws->min[k] < ws->min[p]) ws->min[p] = ws->min[k];
+			if (ws->max[k] > ws->max[p]) ws->max[p] = ws->max[k];
+			ws->size[p] += ws->size[k];
+		}
+	}
+}
+
+
+static inline long long clade_key(const FBPIndex* index, int min, int max) {
+	return (long long) min * index->nb_taxa + max;
+}
+
+static inline int clade_slot(const FBPIndex* index, long long key) {
+	unsigned long long h = (unsigned long long) key * 0x9E3779B97F4A7C15ULL;
+	return (int) ((h ^ (h >> 32)) & (index->table_size - 1));
+}
+
+
+FBPIndex* new_fbp_index(Tree* ref_tree, FBPWorkspace* ws) {
+	int i, k, n = ref_tree->nb_taxa;
+	FBPIndex* index = (FBPIndex*) malloc(sizeof(FBPIndex));
+	index->nb_taxa = n;
+	index->root_taxon = 0;
+	index->rank = (int*) malloc(n * sizeof(int));
+	index->table_size = 1;
+	while (index->table_size < 2 * ref_tree->nb_edges + 2) index->table_size *= 2;
+	index->keys = (long long*) malloc(index->table_size * sizeof(long long));
+	index->edge = (int*) malloc(index->table_size * sizeof(int));
+	for (i = 0; i < index->table_size; i++) index->keys[i] = -1;
+
+	int nb = traverse_from_leaf(ref_tree, leaf_of_taxon(ref_tree, index->root_taxon), ws);
+	int next_rank = 0;
+	for (k = 1; k < nb; k++) /* pre-order: the leaves of a clade get consecutive ranks */
+		if (ws->order[k]->nneigh == 1) index->rank[ws->order[k]->taxon_id] = next_rank++;
+	index->rank[index->root_taxon] = -1; /* never a part of a clade */
+	compute_clades(ws, nb, index->rank);
+
+	for (k = 1; k < nb; k++) {
+		if (ws->size[k] < 2 || ws->size[k] > n - 2) continue; /* trivial edge */
+		long long key = clade_key(index, ws->min[k], ws->max[k]);
+		int slot = clade_slot(index, key);
+		while (index->keys[slot] != -1 && index->keys[slot] != key) slot = (slot + 1) & (index->table_size - 1);
+		if (index->keys[slot] == -1 || ws->parent_edge[k] > index->edge[slot]) index->edge[slot] = ws->parent_edge[k];
+		index->keys[slot] = key;
+	}
+	return index;
+}
+
+
+void free_fbp_index(FBPIndex* index) {
+	free(index->rank);
+	free(index->keys);
+	free(index->edge);
+	free(index);
+}
+
+
+int fbp_found_edges(const FBPIndex* index, Tree* boot_tree, FBPWorkspace* ws, int* found) {
+	int k, nb_found = 0, n = index->nb_taxa;
+	int nb = traverse_from_leaf(boot_tree, leaf_of_taxon(boot_tree, index->root_taxon), ws);
+	compute_clades(ws, nb, index->rank);
+
+	for (k = 1; k < nb; k++) {
+		if (ws->size[k] < 2 || ws->size[k] > n - 2) continue; /* trivial edge */
+		if (ws->max[k] - ws->min[k] + 1 != ws->size[k]) continue; /* not an interval: not a clade of the reference */
+		long long key = clade_key(index, ws->min[k], ws->max[k]);
+		int slot = clade_slot(index, key);
+		while (index->keys[slot] != -1) {
+			if (index->keys[slot] == key) { found[nb_found++] = index->edge[slot]; break; }
+			slot = (slot + 1) & (index->table_size - 1);
+		}
+	}
+	return nb_found;
+}
@@ -0,0 +1,77 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef _FBP_INTERVALS_H_
+#define _FBP_INTERVALS_H_
+
+#include "tree.h"
+
+/* Felsenstein bootstrap without bitsets, by matching clades as intervals (W. H. E. Day, 1985).
+
+   Both trees are traversed from the leaf of the same taxon (root_taxon), so that each edge is given by the
+   clade on its side away from that leaf. The leaves of the reference tree are ranked in the order of this
+   traversal: each of its clades is then an interval [min, max] of ranks, and its edges are indexed by these
+   intervals. A clade of a bootstrap tree is found in the reference tree iff the ranks of its leaves form an
+   interval (max - min + 1 == size) that is in the index.
+   Everything is linear in the number of nodes, for each bootstrap tree. */
+
+/* the clades of the reference tree, built once and then only read (it can be shared by threads) */
+typedef struct __FBPIndex {
+	int nb_taxa;
+	int root_taxon;		/* taxon_id of the leaf from which the trees are traversed */
+	int* rank;		/* rank[taxon_id]: rank of the leaf of this taxon */
+	int table_size;		/* a power of 2, at least twice the number of clades */
+	long long* keys;	/* min * nb_taxa + max of the clade, -1 for an empty slot */
+	int* edge;		/* id of the edge of the reference tree having this clade */
+} FBPIndex;
+
+/* per thread scratch space for the traversals, sized by the number of nodes of the trees */
+typedef struct __FBPWorkspace {
+	int capacity;
+	Node** order;		/* the nodes in the order of the traversal, order[0] being the leaf of root_taxon */
+	int* parent_pos;	/* position in order of the parent of the node */
+	int* parent_edge;	/* id of the edge to the parent of the node */
+	int* min;		/* smallest rank in the clade of the node */
+	int* max;		/* largest rank in the clade of the node */
+	int* size;		/* number of leaves in the clade of the node */
+	Node** stack_node;	/* stack of the traversal */
+	int* stack_parent;
+	int* stack_edge;
+} FBPWorkspace;
+
+
+FBPWorkspace* new_fbp_workspace(int capacity);
+void free_fbp_workspace(FBPWorkspace* ws);
+
+/* indexes the clades of the non-trivial edges of ref_tree.
+   If two edges have the same clade (degree 2 nodes), the one with the largest id is kept. */
+FBPIndex* new_fbp_index(Tree* ref_tree, FBPWorkspace* ws);
+void free_fbp_index(FBPIndex* index);
+
+/* writes into found the ids of the edges of the reference tree whose clade is also the clade of a
+   non-trivial edge of boot_tree, and returns their number (at most boot_tree->nb_edges) */
+int fbp_found_edges(const FBPIndex* index, Tree* boot_tree, FBPWorkspace* ws, int* found);
+
+#endif /* _FBP_INTERVALS_H_ */
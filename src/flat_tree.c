@@ -0,0 +1,238 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "flat_tree.h"
+
+
+/*
+Allocate the arrays of ft with room for capacity nodes.
+*/
+static void alloc_flat_tree_arrays(FlatTree *ft, int capacity)
+{
+  ft->capacity = capacity;
+  ft->parent = malloc(capacity * sizeof(int));
+  ft->child_start = malloc((capacity+1) * sizeof(int));
+  ft->child = malloc(capacity * sizeof(int));
+  ft->sibling = malloc(capacity * sizeof(int));
+  ft->depth = malloc(capacity * sizeof(int));
+  ft->subtreesize = malloc(capacity * sizeof(int));
+  ft->d_lazy = malloc(capacity * sizeof(int));
+  ft->diff = malloc(capacity * sizeof(int));
+  ft->d_min = malloc(capacity * sizeof(int));
+  ft->d_max = malloc(capacity * sizeof(int));
+  ft->d_min_at = malloc(capacity * sizeof(int));
+  ft->d_max_at = malloc(capacity * sizeof(int));
+  ft->end = malloc(capacity * sizeof(int));
+  ft->first_leaf = malloc(capacity * sizeof(int));
+  ft->taxon = malloc(capacity * sizeof(int));
+  ft->index = malloc(capacity * sizeof(int));
+  ft->stack = malloc(capacity * sizeof(int));
+  if(!ft->parent || !ft->child_start || !ft->child || !ft->sibling ||
+     !ft->depth ||
+     !ft->subtreesize || !ft->d_lazy || !ft->diff || !ft->d_min ||
+     !ft->d_max || !ft->d_min_at || !ft->d_max_at || !ft->end ||
+     !ft->first_leaf || !ft->taxon || !ft->index || !ft->stack)
+  {
+    fprintf(stderr, "Error: cannot allocate a flat tree of %d nodes\n",
+            capacity);
+    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+  }
+}
+
+/*
+Free the arrays of ft.
+*/
+static void free_flat_tree_arrays(FlatTree *ft)
+{
+  free(ft->parent);
+  free(ft->child_start);
+  free(ft->child);
+  free(ft->sibling);
+  free(ft->depth);
+  free(ft->subtreesize);
+  free(ft->d_lazy);
+  free(ft->diff);
+  free(ft->d_min);
+  free(ft->d_max);
+  free(ft->d_min_at);
+  free(ft->d_max_at);
+  free(ft->end);
+  free(ft->first_leaf);
+  free(ft->taxon);
+  free(ft->index);
+  free(ft->stack);
+}
+
+/*
+Allocate an empty FlatTree with room for capacity nodes.
+*/
+FlatTree* new_flat_tree(int capacity)
+{
+  FlatTree *ft = malloc(sizeof(FlatTree));
+  ft->nb_nodes = 0;
+  alloc_flat_tree_arrays(ft, capacity > 0 ? capacity : 1);
+  return ft;
+}
+
+/*
+Free the given FlatTree.
+*/
+void free_flat_tree(FlatTree *ft)
+{
+  free_flat_tree_arrays(ft);
+  free(ft);
+}
+
+/*
+Fill ft with the structure and the rapid TI values of the given tree.
+
+The nodes are numbered in pre-order, pushing the heavy child last on the stack
+so that it is the next node visited.  A node is always numbered after its
+parent, so the parent index is known when the node is reached.
+
+@warning  assumes prepare_rapid_TI() was called on the tree.
+*/
+void flatten_tree(FlatTree *ft, const Tree *tree)
+{
+  if(tree->nb_nodes > ft->capacity)
+  {
+    free_flat_tree_arrays(ft);
+    alloc_flat_tree_arrays(ft, tree->nb_nodes);
+  }
+  ft->nb_nodes = tree->nb_nodes;
+
+  int top = 0;                         //Number of node ids on the stack
+  int next = 0;                        //Next index to give
+  ft->stack[top++] = tree->node0->id;
+  while(top)
+  {
+    Node *u = tree->a_nodes[ft->stack[--top]];
+    int i = next++;
+    ft->index[u->id] = i;
+
+    int first = 1;                     //The first child in u->neigh
+    if(u == tree->node0)
+    {
+      ft->parent[i] = -1;
+      first = 0;                       //All the neighbors of the root
+    }
+    else
+      ft->parent[i] = ft->index[u->neigh[0]->id];
+
+    ft->depth[i] = u->depth;
+    ft->subtreesize[i] = u->subtreesize;
+    ft->d_lazy[i] = u->d_lazy;
+    ft->diff[i] = u->diff;
+    ft->d_min[i] = u->d_min;
+    ft->d_max[i] = u->d_max;
+    ft->taxon[i] = (u != tree->node0 && u->nneigh == 1) ? u->taxon_id : -1;
+
+    for(int j = first; j < u->nneigh; j++)    //Light children first
+      if(u->neigh[j] != u->heavychild)
+        ft->stack[top++] = u->neigh[j]->id;
+    for(int j = first; j < u->nneigh; j++)    //So that heavy is popped first
+      if(u->neigh[j] == u->heavychild)
+        ft->stack[top++] = u->neigh[j]->id;
+  }
+
+    //Group the children by parent (in increasing order of index):
+  for(int i=0; i <= ft->nb_nodes; i++)
+    ft->child_start[i] = 0;
+  for(int i=1; i < ft->nb_nodes; i++)
+    ft->child_start[ft->parent[i]+1]++;
+  for(int i=0; i < ft->nb_nodes; i++)
+    ft->child_start[i+1] += ft->child_start[i];
+  for(int i=0; i < ft->nb_nodes; i++)         //stack counts the children seen
+    ft->stack[i] = 0;
+  for(int i=1; i < ft->nb_nodes; i++)
+  {
+    int p = ft->parent[i];
+    ft->child[ft->child_start[p] + ft->stack[p]++] = i;
+  }
+
+    //The siblings.  In a binary tree, only the root of an unrooted tree (of
+    //three children) keeps the general case:
+  ft->sibling[0] = -1;
+  for(int i=0; i < ft->nb_nodes; i++)
+  {
+    int first = ft->child_start[i], nb_children = ft->child_start[i+1] - first;
+    if(nb_children == 2)
+    {
+      ft->sibling[ft->child[first]] = ft->child[first+1];
+      ft->sibling[ft->child[first+1]] = ft->child[first];
+    }
+    else
+    {
+      for(int j = first; j < first + nb_children; j++)
+        ft->sibling[ft->child[j]] = -1;
+    }
+  }
+
+    //The subtrees, children having larger indices than their parent.  Before
+    //any leaf is added, d_min (1) is at any leaf of the subtree, and d_max
+    //(the subtree size) at its root:
+  for(int i = ft->nb_nodes-1; i >= 0; i--)
+  {
+    if(flat_is_leaf(ft, i))
+    {
+      ft->end[i] = i+1;
+      ft->first_leaf[i] = i;
+    }
+    else
+    {
+      ft->end[i] = ft->end[ft->child[ft->child_start[i+1]-1]];
+      ft->first_leaf[i] = ft->first_leaf[ft->child[ft->child_start[i]]];
+    }
+    ft->d_min_at[i] = ft->first_leaf[i];
+    ft->d_max_at[i] = i;
+  }
+}
+
+/*
+Put the path from node i to the root in the given array, which must hold at
+least ft->depth[i]+1 ints.
+*/
+void flat_path_to_root(const FlatTree *ft, int i, int *path)
+{
+  int pathlen = ft->depth[i];
+  for(int k=0; k <= pathlen; k++)
+  {
+    path[k] = i;
+    i = ft->parent[i];
+  }
+}
+
+/*
+Print the TI variables of all the nodes.
+*/
+void print_flat_tree_TIvars(const FlatTree *ft)
+{
+  fprintf(stderr, "Nodes:\n");
+  for(int i=0; i < ft->nb_nodes; i++)
+    fprintf(stderr, "node %i parent: %i |L|: %i depth: %i\n"
+            "\td_min: %i d_max: %i d_lazy: %i diff: %i\n", i, ft->parent[i],
+            ft->subtreesize[i], ft->depth[i], ft->d_min[i], ft->d_max[i],
+            ft->d_lazy[i], ft->diff[i]);
+}
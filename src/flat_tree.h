@@ -0,0 +1,100 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef _FLAT_TREE_H_
+#define _FLAT_TREE_H_
+
+#include "tree.h"
+
+/* A compact, index based copy of a Tree, holding only what the rapid Transfer
+Index computation needs on the alt_tree.
+
+The nodes are numbered in a pre-order traversal that visits the heavy child
+first, so that a heavy path is a run of consecutive indices, and the root is
+node 0.  Each value is kept in its own int array, indexed by these numbers, so
+that following a path touches a few contiguous arrays instead of whole Node
+structs.
+
+The arrays are kept from one tree to the next: flatten_tree() only reallocates
+them when a tree is larger than all the previous ones.
+*/
+typedef struct __FlatTree {
+  int nb_nodes;
+  int capacity;      // number of nodes that fit in the arrays
+
+  int *parent;       // index of the parent, -1 for the root
+  int *child_start;  // children of i are child[child_start[i]..child_start[i+1]-1]
+  int *child;        // indices of the children, grouped by parent
+  int *sibling;      // the other child of the parent when it has exactly two
+                     // children, -1 otherwise (and for the root): the kernel
+                     // then skips the loops over the children
+
+  int *depth;        // depth of the node (from the root)
+  int *subtreesize;  // number of leaves in the subtree rooted at the node
+  int *d_lazy;       // the lazily updated transfer distance
+  int *diff;         // the difference to push down to the subtree
+  int *d_min;        // minimum TI found in the subtree
+  int *d_max;        // maximum TI found in the subtree
+  int *d_min_at;     // node of the subtree at which d_min is found
+  int *d_max_at;     // node of the subtree at which d_max is found
+
+  int *end;          // the subtree of i is the nodes i..end[i]-1
+  int *first_leaf;   // first leaf of the subtree, in pre-order
+  int *taxon;        // taxon_id of a leaf, -1 for the other nodes
+
+  int *index;        // index[id] is the index of the Tree Node with this id
+  int *stack;        // scratch space for the traversal
+} FlatTree;
+
+
+/* Allocate an empty FlatTree with room for capacity nodes.
+*/
+FlatTree* new_flat_tree(int capacity);
+/* Free the given FlatTree.
+*/
+void free_flat_tree(FlatTree *ft);
+
+/* Fill ft with the structure and the rapid TI values of the given tree.
+
+@warning  assumes prepare_rapid_TI() was called on the tree.
+*/
+void flatten_tree(FlatTree *ft, const Tree *tree);
+
+/* Put the path from node i to the root in the given array, which must hold at
+least ft->depth[i]+1 ints.
+*/
+void flat_path_to_root(const FlatTree *ft, int i, int *path);
+
+/* Return true if node i is a leaf.
+*/
+static inline bool flat_is_leaf(const FlatTree *ft, int i) {
+  return ft->child_start[i] == ft->child_start[i+1];
+}
+
+/* Print the TI variables of all the nodes.
+*/
+void print_flat_tree_TIvars(const FlatTree *ft);
+
+#endif /* _FLAT_TREE_H_ */
@@ -0,0 +1,367 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "hamming_simd.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#define HAMMING_X86
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define HAMMING_NEON
+#include <arm_neon.h>
+#endif
+
+
+typedef struct {
+	const char* name;
+	void (*add_rows)(unsigned short* dst, const unsigned short* src, int len);
+	void (*min_row)(const unsigned short* card, const unsigned short* c_row, const unsigned short* i_row,
+			int nb_taxa, int edge_id, unsigned short* min_dist, unsigned short* min_dist_edge, int len);
+	void (*add_rows32)(unsigned int* dst, const unsigned int* src, int len);
+	void (*min_row32)(const unsigned int* card, const unsigned int* c_row, const unsigned int* i_row,
+			  int nb_taxa, int edge_id, unsigned int* min_dist, unsigned int* min_dist_edge, int len);
+} hamming_kernels;
+
+
+static void add_rows_scalar(unsigned short* dst, const unsigned short* src, int len) {
+	int i;
+	for (i = 0; i < len; i++) dst[i] += src[i];
+}
+
+static void min_row_scalar(const unsigned short* card, const unsigned short* c_row, const unsigned short* i_row,
+			   int nb_taxa, int edge_id, unsigned short* min_dist, unsigned short* min_dist_edge, int len) {
+	int i, h;
+	for (i = 0; i < len; i++) {
+		h = card[i] + c_row[i] - i_row[i]; /* card of union minus card of intersection */
+		if (h > nb_taxa/2 /* floor value */) h = nb_taxa - h;
+		if (h < min_dist[i]) {
+			min_dist[i] = h;
+			min_dist_edge[i] = edge_id;
+		}
+	}
+}
+
+
+static void add_rows32_scalar(unsigned int* dst, const unsigned int* src, int len) {
+	int i;
+	for (i = 0; i < len; i++) dst[i] += src[i];
+}
+
+static void min_row32_scalar(const unsigned int* card, const unsigned int* c_row, const unsigned int* i_row,
+			     int nb_taxa, int edge_id, unsigned int* min_dist, unsigned int* min_dist_edge, int len) {
+	int i;
+	unsigned int h;
+	for (i = 0; i < len; i++) {
+		h = card[i] + c_row[i] - i_row[i];
+		if (h > (unsigned int) nb_taxa/2) h = nb_taxa - h;
+		if (h < min_dist[i]) {
+			min_dist[i] = h;
+			min_dist_edge[i] = edge_id;
+		}
+	}
+}
+
+
+/* In the vector versions, min(h, nb_taxa - h) is the transfer distance: nb_taxa - h < h iff h > nb_taxa/2.
+   A cell is updated iff min(h, min_dist) differs from min_dist, i.e. iff h < min_dist: it keeps, as the scalar
+   version, the first edge at the min distance. */
+
+#ifdef HAMMING_X86
+
+__attribute__((target("sse4.1")))
+static void add_rows_sse41(unsigned short* dst, const unsigned short* src, int len) {
+	int i;
+	for (i = 0; i < len; i += 8) {
+		__m128i d = _mm_load_si128((const __m128i*) (dst + i));
+		_mm_store_si128((__m128i*) (dst + i), _mm_add_epi16(d, _mm_load_si128((const __m128i*) (src + i))));
+	}
+}
+
+__attribute__((target("sse4.1")))
+static void min_row_sse41(const unsigned short* card, const unsigned short* c_row, const unsigned short* i_row,
+			  int nb_taxa, int edge_id, unsigned short* min_dist, unsigned short* min_dist_edge, int len) {
+	const __m128i n = _mm_set1_epi16((short) nb_taxa), e = _mm_set1_epi16((short) edge_id);
+	int i;
+	for (i = 0; i < len; i += 8) {
+		__m128i h = _mm_sub_epi16(_mm_add_epi16(_mm_load_si128((const __m128i*) (card + i)),
+							_mm_load_si128((const __m128i*) (c_row + i))),
+					  _mm_load_si128((const __m128i*) (i_row + i)));
+		h = _mm_min_epu16(h, _mm_sub_epi16(n, h));
+		__m128i m = _mm_load_si128((const __m128i*) (min_dist + i));
+		__m128i kept = _mm_cmpeq_epi16(_mm_min_epu16(h, m), m);
+		_mm_store_si128((__m128i*) (min_dist + i), _mm_min_epu16(h, m));
+		_mm_store_si128((__m128i*) (min_dist_edge + i),
+				_mm_blendv_epi8(e, _mm_load_si128((const __m128i*) (min_dist_edge + i)), kept));
+	}
+}
+
+__attribute__((target("avx2")))
+static void add_rows_avx2(unsigned short* dst, const unsigned short* src, int len) {
+	int i;
+	for (i = 0; i < len; i += 16) {
+		__m256i d = _mm256_load_si256((const __m256i*) (dst + i));
+		_mm256_store_si256((__m256i*) (dst + i), _mm256_add_epi16(d, _mm256_load_si256((const __m256i*) (src + i))));
+	}
+}
+
+__attribute__((target("avx2")))
+static void min_row_avx2(const unsigned short* card, const unsigned short* c_row, const unsigned short* i_row,
+			 int nb_taxa, int edge_id, unsigned short* min_dist, unsigned short* min_dist_edge, int len) {
+	const __m256i n = _mm256_set1_epi16((short) nb_taxa), e = _mm256_set1_epi16((short) edge_id);
+	int i;
+	for (i = 0; i < len; i += 16) {
+		__m256i h = _mm256_sub_epi16(_mm256_add_epi16(_mm256_load_si256((const __m256i*) (card + i)),
+							      _mm256_load_si256((const __m256i*) (c_row + i))),
+					     _mm256_load_si256((const __m256i*) (i_row + i)));
+		h = _mm256_min_epu16(h, _mm256_sub_epi16(n, h));
+		__m256i m = _mm256_load_si256((const __m256i*) (min_dist + i));
+		__m256i kept = _mm256_cmpeq_epi16(_mm256_min_epu16(h, m), m);
+		_mm256_store_si256((__m256i*) (min_dist + i), _mm256_min_epu16(h, m));
+		_mm256_store_si256((__m256i*) (min_dist_edge + i),
+				   _mm256_blendv_epi8(e, _mm256_load_si256((const __m256i*) (min_dist_edge + i)), kept));
+	}
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void add_rows_avx512(unsigned short* dst, const unsigned short* src, int len) {
+	int i;
+	for (i = 0; i < len; i += 32) {
+		__m512i d = _mm512_load_si512((const void*) (dst + i));
+		_mm512_store_si512((void*) (dst + i), _mm512_add_epi16(d, _mm512_load_si512((const void*) (src + i))));
+	}
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void min_row_avx512(const unsigned short* card, const unsigned short* c_row, const unsigned short* i_row,
+			   int nb_taxa, int edge_id, unsigned short* min_dist, unsigned short* min_dist_edge, int len) {
+	const __m512i n = _mm512_set1_epi16((short) nb_taxa), e = _mm512_set1_epi16((short) edge_id);
+	int i;
+	for (i = 0; i < len; i += 32) {
+		__m512i h = _mm512_sub_epi16(_mm512_add_epi16(_mm512_load_si512((const void*) (card + i)),
+							      _mm512_load_si512((const void*) (c_row + i))),
+					     _mm512_load_si512((const void*) (i_row + i)));
+		h = _mm512_min_epu16(h, _mm512_sub_epi16(n, h));
+		__m512i m = _mm512_load_si512((const void*) (min_dist + i));
+		__mmask32 closer = _mm512_cmplt_epu16_mask(h, m);
+		_mm512_store_si512((void*) (min_dist + i), _mm512_mask_mov_epi16(m, closer, h));
+		_mm512_store_si512((void*) (min_dist_edge + i),
+				   _mm512_mask_mov_epi16(_mm512_load_si512((const void*) (min_dist_edge + i)), closer, e));
+	}
+}
+
+__attribute__((target("sse4.1")))
+static void add_rows32_sse41(unsigned int* dst, const unsigned int* src, int len) {
+	int i;
+	for (i = 0; i < len; i += 4) {
+		__m128i d = _mm_load_si128((const __m128i*) (dst + i));
+		_mm_store_si128((__m128i*) (dst + i), _mm_add_epi32(d, _mm_load_si128((const __m128i*) (src + i))));
+	}
+}
+
+__attribute__((target("sse4.1")))
+static void min_row32_sse41(const unsigned int* card, const unsigned int* c_row, const unsigned int* i_row,
+			    int nb_taxa, int edge_id, unsigned int* min_dist, unsigned int* min_dist_edge, int len) {
+	const __m128i n = _mm_set1_epi32(nb_taxa), e = _mm_set1_epi32(edge_id);
+	int i;
+	for (i = 0; i < len; i += 4) {
+		__m128i h = _mm_sub_epi32(_mm_add_epi32(_mm_load_si128((const __m128i*) (card + i)),
+							_mm_load_si128((const __m128i*) (c_row + i))),
+					  _mm_load_si128((const __m128i*) (i_row + i)));
+		h = _mm_min_epu32(h, _mm_sub_epi32(n, h));
+		__m128i m = _mm_load_si128((const __m128i*) (min_dist + i));
+		__m128i kept = _mm_cmpeq_epi32(_mm_min_epu32(h, m), m);
+		_mm_store_si128((__m128i*) (min_dist + i), _mm_min_epu32(h, m));
+		_mm_store_si128((__m128i*) (min_dist_edge + i),
+				_mm_blendv_epi8(e, _mm_load_si128((const __m128i*) (min_dist_edge + i)), kept));
+	}
+}
+
+__attribute__((target("avx2")))
+static void add_rows32_avx2(unsigned int* dst, const unsigned int* src, int len) {
+	int i;
+	for (i = 0; i < len; i += 8) {
+		__m256i d = _mm256_load_si256((const __m256i*) (dst + i));
+		_mm256_store_si256((__m256i*) (dst + i), _mm256_add_epi32(d, _mm256_load_si256((const __m256i*) (src + i))));
+	}
+}
+
+__attribute__((target("avx2")))
+static void min_row32_avx2(const unsigned int* card, const unsigned int* c_row, const unsigned int* i_row,
+			   int nb_taxa, int edge_id, unsigned int* min_dist, unsigned int* min_dist_edge, int len) {
+	const __m256i n = _mm256_set1_epi32(nb_taxa), e = _mm256_set1_epi32(edge_id);
+	int i;
+	for (i = 0; i < len; i += 8) {
+		__m256i h = _mm256_sub_epi32(_mm256_add_epi32(_mm256_load_si256((const __m256i*) (card + i)),
+							      _mm256_load_si256((const __m256i*) (c_row + i))),
+					     _mm256_load_si256((const __m256i*) (i_row + i)));
+		h = _mm256_min_epu32(h, _mm256_sub_epi32(n, h));
+		__m256i m = _mm256_load_si256((const __m256i*) (min_dist + i));
+		__m256i kept = _mm256_cmpeq_epi32(_mm256_min_epu32(h, m), m);
+		_mm256_store_si256((__m256i*) (min_dist + i), _mm256_min_epu32(h, m));
+		_mm256_store_si256((__m256i*) (min_dist_edge + i),
+				   _mm256_blendv_epi8(e, _mm256_load_si256((const __m256i*) (min_dist_edge + i)), kept));
+	}
+}
+
+__attribute__((target("avx512f")))
+static void add_rows32_avx512(unsigned int* dst, const unsigned int* src, int len) {
+	int i;
+	for (i = 0; i < len; i += 16) {
+		__m512i d = _mm512_load_si512((const void*) (dst + i));
+		_mm512_store_si512((void*) (dst + i), _mm512_add_epi32(d, _mm512_load_si512((const void*) (src + i))));
+	}
+}
+
+__attribute__((target("avx512f")))
+static void min_row32_avx512(const unsigned int* card, const unsigned int* c_row, const unsigned int* i_row,
+			     int nb_taxa, int edge_id, unsigned int* min_dist, unsigned int* min_dist_edge, int len) {
+	const __m512i n = _mm512_set1_epi32(nb_taxa), e = _mm512_set1_epi32(edge_id);
+	int i;
+	for (i = 0; i < len; i += 16) {
+		__m512i h = _mm512_sub_epi32(_mm512_add_epi32(_mm512_load_si512((const void*) (card + i)),
+							      _mm512_load_si512((const void*) (c_row + i))),
+					     _mm512_load_si512((const void*) (i_row + i)));
+		h = _mm512_min_epu32(h, _mm512_sub_epi32(n, h));
+		__m512i m = _mm512_load_si512((const void*) (min_dist + i));
+		__mmask16 closer = _mm512_cmplt_epu32_mask(h, m);
+		_mm512_store_si512((void*) (min_dist + i), _mm512_mask_mov_epi32(m, closer, h));
+		_mm512_store_si512((void*) (min_dist_edge + i),
+				   _mm512_mask_mov_epi32(_mm512_load_si512((const void*) (min_dist_edge + i)), closer, e));
+	}
+}
+
+#endif /* HAMMING_X86 */
+
+
+#ifdef HAMMING_NEON
+
+static void add_rows_neon(unsigned short* dst, const unsigned short* src, int len) {
+	int i;
+	for (i = 0; i < len; i += 8) vst1q_u16(dst + i, vaddq_u16(vld1q_u16(dst + i), vld1q_u16(src + i)));
+}
+
+static void min_row_neon(const unsigned short* card, const unsigned short* c_row, const unsigned short* i_row,
+			 int nb_taxa, int edge_id, unsigned short* min_dist, unsigned short* min_dist_edge, int len) {
+	const uint16x8_t n = vdupq_n_u16((uint16_t) nb_taxa), e = vdupq_n_u16((uint16_t) edge_id);
+	int i;
+	for (i = 0; i < len; i += 8) {
+		uint16x8_t h = vsubq_u16(vaddq_u16(vld1q_u16(card + i), vld1q_u16(c_row + i)), vld1q_u16(i_row + i));
+		h = vminq_u16(h, vsubq_u16(n, h));
+		uint16x8_t m = vld1q_u16(min_dist + i);
+		uint16x8_t closer = vcltq_u16(h, m);
+		vst1q_u16(min_dist + i, vminq_u16(h, m));
+		vst1q_u16(min_dist_edge + i, vbslq_u16(closer, e, vld1q_u16(min_dist_edge + i)));
+	}
+}
+
+static void add_rows32_neon(unsigned int* dst, const unsigned int* src, int len) {
+	int i;
+	for (i = 0; i < len; i += 4) vst1q_u32(dst + i, vaddq_u32(vld1q_u32(dst + i), vld1q_u32(src + i)));
+}
+
+static void min_row32_neon(const unsigned int* card, const unsigned int* c_row, const unsigned int* i_row,
+			   int nb_taxa, int edge_id, unsigned int* min_dist, unsigned int* min_dist_edge, int len) {
+	const uint32x4_t n = vdupq_n_u32((uint32_t) nb_taxa), e = vdupq_n_u32((uint32_t) edge_id);
+	int i;
+	for (i = 0; i < len; i += 4) {
+		uint32x4_t h = vsubq_u32(vaddq_u32(vld1q_u32(card + i), vld1q_u32(c_row + i)), vld1q_u32(i_row + i));
+		h = vminq_u32(h, vsubq_u32(n, h));
+		uint32x4_t m = vld1q_u32(min_dist + i);
+		uint32x4_t closer = vcltq_u32(h, m);
+		vst1q_u32(min_dist + i, vminq_u32(h, m));
+		vst1q_u32(min_dist_edge + i, vbslq_u32(closer, e, vld1q_u32(min_dist_edge + i)));
+	}
+}
+
+#endif /* HAMMING_NEON */
+
+
+/* RUNTIME SELECTION OF THE KERNELS */
+
+static hamming_kernels kernels = { "scalar", add_rows_scalar, min_row_scalar, add_rows32_scalar, min_row32_scalar };
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+/* uses the kernels of the given name if the cpu supports them, returns 0 (and changes nothing) if not */
+static int set_kernels(const char* name) {
+	hamming_kernels k = { NULL, NULL, NULL, NULL, NULL };
+#if defined(HAMMING_X86)
+	__builtin_cpu_init();
+	if (!strcmp(name, "avx512") && __builtin_cpu_supports("avx512bw"))
+		k = (hamming_kernels) { "avx512", add_rows_avx512, min_row_avx512, add_rows32_avx512, min_row32_avx512 };
+	else if (!strcmp(name, "avx2") && __builtin_cpu_supports("avx2"))
+		k = (hamming_kernels) { "avx2", add_rows_avx2, min_row_avx2, add_rows32_avx2, min_row32_avx2 };
+	else if (!strcmp(name, "sse4.1") && __builtin_cpu_supports("sse4.1"))
+		k = (hamming_kernels) { "sse4.1", add_rows_sse41, min_row_sse41, add_rows32_sse41, min_row32_sse41 };
+#elif defined(HAMMING_NEON)
+	if (!strcmp(name, "neon")) /* always there on aarch64 */
+		k = (hamming_kernels) { "neon", add_rows_neon, min_row_neon, add_rows32_neon, min_row32_neon };
+#endif
+	if (!strcmp(name, "scalar"))
+		k = (hamming_kernels) { "scalar", add_rows_scalar, min_row_scalar, add_rows32_scalar, min_row32_scalar };
+	if (k.name == NULL) return 0;
+	kernels = k;
+	return 1;
+}
+
+static void select_kernels() {
+	/* the best first */
+	if (!set_kernels("avx512") && !set_kernels("avx2") && !set_kernels("sse4.1")) set_kernels("neon");
+}
+
+static inline const hamming_kernels* get_kernels() {
+	pthread_once(&kernels_once, select_kernels);
+	return &kernels;
+}
+
+int hamming_use_kernels(const char* name) {
+	pthread_once(&kernels_once, select_kernels); /* so that the first call of a kernel does not select others */
+	return set_kernels(name);
+}
+
+const char* hamming_kernels_name() {
+	return get_kernels()->name;
+}
+
+
+void hamming_add_rows(unsigned short* dst, const unsigned short* src, int len) {
+	get_kernels()->add_rows(dst, src, len);
+}
+
+void hamming_min_row(const unsigned short* card, const unsigned short* c_row, const unsigned short* i_row,
+		     int nb_taxa, int edge_id, unsigned short* min_dist, unsigned short* min_dist_edge, int len) {
+	get_kernels()->min_row(card, c_row, i_row, nb_taxa, edge_id, min_dist, min_dist_edge, len);
+}
+
+void hamming_add_rows32(unsigned int* dst, const unsigned int* src, int len) {
+	get_kernels()->add_rows32(dst, src, len);
+}
+
+void hamming_min_row32(const unsigned int* card, const unsigned int* c_row, const unsigned int* i_row,
+		       int nb_taxa, int edge_id, unsigned int* min_dist, unsigned int* min_dist_edge, int len) {
+	get_kernels()->min_row32(card, c_row, i_row, nb_taxa, edge_id, min_dist, min_dist_edge, len);
+}
@@ -0,0 +1,58 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef _HAMMING_SIMD_H_
+#define _HAMMING_SIMD_H_
+
+/* Row kernels of the classic transfer index (see tbe_workspace.h), on packed 16 bits cells, and on 32 bits
+   cells for the trees with more than 65,535 taxa or edges (the *32 versions).
+
+   A row holds one cell per edge of the reference tree, for a given edge of the bootstrap tree. The rows are
+   aligned on 64 bytes and their length (len) is a multiple of 64 bytes worth of cells, so that the kernels have
+   no tail to handle. There are scalar, SSE4.1, AVX2 and AVX-512 versions on x86 and a NEON version on ARM: the
+   best one supported by the cpu is selected at runtime, the first time one of them is called. */
+
+/* dst[i] += src[i] */
+void hamming_add_rows(unsigned short* dst, const unsigned short* src, int len);
+
+/* for all i, with h = card[i] + c_row[i] - i_row[i] the Hamming distance between the cluster i of the reference
+   tree and the cluster of edge_id, and d = min(h, nb_taxa - h) the transfer distance:
+   if d < min_dist[i], then min_dist[i] = d and min_dist_edge[i] = edge_id */
+void hamming_min_row(const unsigned short* card, const unsigned short* c_row, const unsigned short* i_row,
+		     int nb_taxa, int edge_id, unsigned short* min_dist, unsigned short* min_dist_edge, int len);
+
+/* the same on 32 bits cells */
+void hamming_add_rows32(unsigned int* dst, const unsigned int* src, int len);
+void hamming_min_row32(const unsigned int* card, const unsigned int* c_row, const unsigned int* i_row,
+		       int nb_taxa, int edge_id, unsigned int* min_dist, unsigned int* min_dist_edge, int len);
+
+/* name of the kernels in use: "avx512", "avx2", "sse4.1", "neon" or "scalar" */
+const char* hamming_kernels_name();
+
+/* uses the kernels of the given name instead of the best ones, to compare them (see unit_tests.c): returns 0
+   if the cpu does not support them. Not to be called while other threads use the kernels */
+int hamming_use_kernels(const char* name);
+
+#endif /* _HAMMING_SIMD_H_ */
@@ -25,27 +25,36 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 /* This file implements bit arrays to store Taxon_ids, for use in the Edges of the Tree objects. */
 #include "hashtables_bfields.h"
-/* ntax is defined as an extern int in this header file.
-   chunksize is also defined there. */
+/* chunksize is defined in this header file. */
 
 
-id_hash_table_t* create_id_hash_table(int size)
+id_hash_table_t* create_id_hash_table(int nb_taxa)
 {
-	/* here we leave the size parameter for compatibility with the old hashtable implementation,
-	   but this parameter IS NOT USED in this one. We use the static variable nbchunks_bitarray insead. */
+	/* nb_taxa is the number of taxa of the tree: it gives the number of bits (hence of longs) of the bitfield */
     id_hash_table_t *new_table = (id_hash_table_t*) malloc(sizeof(id_hash_table_t));
     new_table->num_items = 0;
+    new_table->nb_taxa = nb_taxa;
 
     /* Attempt to allocate and initialize to 0 the memory for the bitfield  */
-    if ((new_table->bitarray = (bfield_t) calloc(nbchunks_bitarray, sizeof(unsigned long))) == NULL)
+    if ((new_table->bitarray = (bfield_t) calloc(nbchunks_bitarray(nb_taxa), sizeof(unsigned long))) == NULL)
         return NULL;
     else
     	return new_table;
 }
 
+id_hash_table_t* create_id_hash_table_in_arena(Arena* arena, int nb_taxa)
+{
+    if (arena == NULL) return create_id_hash_table(nb_taxa);
+    id_hash_table_t *new_table = (id_hash_table_t*) arena_alloc(arena, sizeof(id_hash_table_t));
+    new_table->num_items = 0;
+    new_table->nb_taxa = nb_taxa;
+    new_table->bitarray = (bfield_t) arena_calloc(arena, nbchunks_bitarray(nb_taxa), sizeof(unsigned long));
+    return new_table;
+}
+
 id_hash_table_t* complement_id_hashtbl(id_hash_table_t* h, int nbtaxa) {
 	/* this creates a new hashtable and populates it with the complement of h */
-	id_hash_table_t* c = create_id_hash_table(0);
+	id_hash_table_t* c = create_id_hash_table(h->nb_taxa);
 	int retval;
 	Taxon_id my_id;
 	for (my_id = 0; my_id < nbtaxa; my_id++) {
@@ -58,7 +67,7 @@ id_hash_table_t* complement_id_hashtbl(id_hash_table_t* h, int nbtaxa) {
 int lookup_id(id_hash_table_t *hashtable, Taxon_id my_id)
 {
     /* Returns whether the taxon is in the hashtable */ 
-	if(my_id >= ntax) {
+	if(my_id >= hashtable->nb_taxa) {
 	  fprintf(stderr,"Error in %s: taxon ID %d is out of range. Aborting.\n", __FUNCTION__, my_id);
 	  Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
 	}	       
@@ -112,7 +121,7 @@ int delete_id(id_hash_table_t *hashtable, Taxon_id my_id)
 
 void clear_id_hashtable(id_hash_table_t *hashtable) { /* clears completely the hashtable (no taxa) */
 	int chunk;
-	for (chunk = 0; chunk < nbchunks_bitarray; chunk++) hashtable->bitarray[chunk] = 0UL;
+	for (chunk = 0; chunk < nbchunks_bitarray(hashtable->nb_taxa); chunk++) hashtable->bitarray[chunk] = 0UL;
 	hashtable->num_items = 0;
 }
 
@@ -120,7 +129,7 @@ void clear_id_hashtable(id_hash_table_t *hashtable) { /* clears completely the h
 void fill_id_hashtable(id_hash_table_t *hashtable, int nb_taxa) { /* sets all bits to 1 in the whole hashtable (all taxa) */
 	int chunk;
 	unsigned long full_one = ~(0UL);
-	for (chunk = 0; chunk < nbchunks_bitarray; chunk++) hashtable->bitarray[chunk] = full_one;
+	for (chunk = 0; chunk < nbchunks_bitarray(hashtable->nb_taxa); chunk++) hashtable->bitarray[chunk] = full_one;
 	/* the last bits of the last chunk are MEANINGLESS when chunksize is not a divisor of nb_taxa. */
 	hashtable->num_items = nb_taxa;
 }
@@ -128,35 +137,18 @@ void fill_id_hashtable(id_hash_table_t *hashtable, int nb_taxa) { /* sets all bi
 void complement_id_hashtable(id_hash_table_t *destination, const id_hash_table_t *source, int nb_taxa) {
 	/* transforms destination into the complement of source */
 	int chunk;
-	for (chunk = 0; chunk < nbchunks_bitarray; chunk++) destination->bitarray[chunk] = ~(source->bitarray[chunk]);
+	for (chunk = 0; chunk < nbchunks_bitarray(destination->nb_taxa); chunk++) destination->bitarray[chunk] = ~(source->bitarray[chunk]);
 	destination->num_items = nb_taxa - source->num_items;
 }
 
 unsigned int bitCount (unsigned long value) {
-    unsigned int count = 0;
-    while (value) {           // until all bits are zero
-        if (value & 0x1)     // check LSB
-            count++;
-        value >>= 1;              // shift bits, deleting LSB
-    }
-    return count;
+    return __builtin_popcountl(value); /* the popcnt instruction where the target has it */
 }
 
 void update_id_hashtable(id_hash_table_t *source, id_hash_table_t *destination) {
 	/* copies all the items from source into destination. Doesn't erase anything anywhere.
 	   Doesn't produce duplicate entries in the destination. */
-	int chunk;
-	unsigned int added;
-
-	for (chunk = 0; chunk < nbchunks_bitarray; chunk++) {
-		/* we first need to know how many new taxa we are going to add in destination */
-		added = bitCount(source->bitarray[chunk] & ~destination->bitarray[chunk]); /* 1 in source AND O in dest */
-		if (added) {
-			/* copy all items from source->bitarray[chunk] into destination */
-			destination->bitarray[chunk] = (destination->bitarray[chunk] | source->bitarray[chunk]);
-			destination->num_items += added;
-		} /* end if added */
-	} /* end of the for loop */
+	destination->num_items += bitset_or_count_added(destination->bitarray, source->bitarray, nbchunks_bitarray(destination->nb_taxa));
 } /* end update_id_hashtable */
 
 
@@ -167,13 +159,8 @@ int equal_id_hashtables(id_hash_table_t *tbl1, id_hash_table_t *tbl2) {
 	if(tbl2 == NULL) return 0; /* because tbl1 not null */
 	if(tbl1->num_items != tbl2->num_items) return 0; /* tables cannot be identical if they don't have the
 							    same number of stored elements */
-	int chunk;
-	/* we simply test the equality of the successive longs */
-	for (chunk = 0; chunk < nbchunks_bitarray; chunk++) {
-		if (tbl1->bitarray[chunk] != tbl2->bitarray[chunk]) return 0;
-	}
-	/* here all the ids in tbl1 have been found also in tbl2, and the two tables have same size: */
-	return 1;
+	/* we simply test the equality of the successive longs (ignoring the bits beyond nb_taxa) */
+	return bitset_equal(tbl1->bitarray, tbl2->bitarray, tbl1->nb_taxa);
 
 } /* end equal_id_hashtables */
 
@@ -184,7 +171,6 @@ int complement_id_hashtables(id_hash_table_t *tbl1, id_hash_table_t *tbl2,int nb
   if(tbl1 == NULL) return (tbl2 == NULL);
   if(tbl2 == NULL) return 0; /* because tbl1 not null */
   
-  int chunk;
   /* we simply test the equality of the successive longs ==> Does not work for the last chunk */
   /* If the last long is < nbtaxa : the direct complement does not work!
      Example: 
@@ -199,16 +185,7 @@ int complement_id_hashtables(id_hash_table_t *tbl1, id_hash_table_t *tbl2,int nb
 	==> OK
 	The mask is (((unsigned long)1 << (nb_taxa%chunksize)) - 1);
    */
-  for (chunk = 0; chunk < nbchunks_bitarray; chunk++) {
-    /* Initialize Mask with 1111....11*/
-    unsigned long mask = -1;
-    if(nb_taxa<(chunk+1)*chunksize){
-      mask = (((unsigned long)1 << (nb_taxa%chunksize)) - 1);
-    }
-    if ((tbl1->bitarray[chunk]&mask) != ((~(tbl2->bitarray[chunk]))&mask)) return 0;
-  }
-  /* here all the ids in tbl1 have been found also in tbl2, and the two tables have same size: */
-  return 1;
+  return bitset_complement(tbl1->bitarray, tbl2->bitarray, nb_taxa);
 } /* end equal_id_hashtables */
 
 
@@ -219,7 +196,7 @@ int equal_or_complement_id_hashtables(id_hash_table_t *tbl1, id_hash_table_t *tb
 
 
 id_hash_table_t* suffle_hash_table(id_hash_table_t *hashtable, int total){
-  id_hash_table_t * output = create_id_hash_table(total);
+  id_hash_table_t * output = create_id_hash_table(hashtable->nb_taxa);
   Taxon_id* taxid_array = malloc(total*sizeof(Taxon_id));
   Taxon_id i = 0;
   for(i=0;i<total;i++){
@@ -252,7 +229,7 @@ void print_id_hashtable(FILE* stream, id_hash_table_t *hashtable, int nbtaxa) {
 	int i, chunk;
 	unsigned long mylong, base = 0, mask = 1, true_index;
 	char c;
-   	for (chunk = 0; chunk < nbchunks_bitarray; chunk++) {
+   	for (chunk = 0; chunk < nbchunks_bitarray(hashtable->nb_taxa); chunk++) {
 		mylong = hashtable->bitarray[chunk];
 		for (i = 0; i < chunksize; i++) { /* for all the bits in the unsigned long, starting with the LSB */
 			true_index = base + i;
@@ -32,30 +32,33 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <assert.h>
 #include <limits.h>
 #include "stats.h"
-#include "externs.h" /* gives the extern declaration of ntax, actual number of taxa in the tree(s) dealt with */
+#include "arena.h"
+#include "bitset_simd.h"	/* word level kernels on the bit arrays */
 
 /* here we implement bit arrays to store taxon IDs. A taxon ID is an integer, and thus an index in a large bit array.
    A bipartition (== a subset of all the taxa) is a bit array in which the taxa that are present are all the bits set to 1.
    To be efficient in terms of storing the bipartitions, it is essential to have a variable length for our large bitfields.
-   The bitfields are allocated at runtime, when we know the value of ntax, the number of taxa in the tree.
+   The bitfields are allocated at runtime, when we know the number of taxa in the tree. Each table records that
+   number itself, so that trees on different taxon sets (e.g. in independent contexts of libbooster) can coexist.
 */
 
 /* TYPE DEFINITIONS */
 
-#define MAX_TAXON_ID	USHRT_MAX
-typedef unsigned short Taxon_id;	/* this gives us room for at least 65,536 taxa in the tree, maybe more
-					   (depending on implementation). Taxon id 0 IS VALID. We can tweak it further here. */
+#define MAX_TAXON_ID	UINT_MAX
+typedef unsigned int Taxon_id;	/* this gives us room for at least 4 billion taxa in the tree (the trees with more than
+				   65,535 taxa do not fit in unsigned shorts). Taxon id 0 IS VALID. */
 
 
 typedef unsigned long* bfield_t;	/* the bitfield type: a series of consecutive unsigned longs. */
 #define chunksize (8 * sizeof(unsigned long))	/* number of bits in a bitfield chunk, e.g. sizeof(unsigned long) = 4 means that chunksize = 32 */
-#define nbchunks_bitarray (ntax/chunksize + (ntax%chunksize != 0 ? 1 : 0)) /* euclidean division */
-/* and then this value never changes, it is the size of a bitarray in longs for this number of taxa. */
+#define nbchunks_bitarray(nb_taxa) ((nb_taxa)/chunksize + ((nb_taxa)%chunksize != 0 ? 1 : 0)) /* euclidean division */
+/* this is the size of a bitarray in longs for this number of taxa. */
 
 
 
 typedef struct _id_hash_table_t_ {
     int num_items;		/* the true number of items (ids) stored in this bit field */
+    int nb_taxa;		/* the number of taxa (bits) this bit field was allocated for: ids are in [0, nb_taxa) */
     bfield_t bitarray;	      	/* the bit field */
 } id_hash_table_t;
 
@@ -64,7 +67,9 @@ typedef struct _id_hash_table_t_ {
 
 
 /* on id hash tables */
-id_hash_table_t* create_id_hash_table(int size);
+id_hash_table_t* create_id_hash_table(int nb_taxa);
+/* same as create_id_hash_table, in the given arena (in which case the table must not be freed) */
+id_hash_table_t* create_id_hash_table_in_arena(Arena* arena, int nb_taxa);
 id_hash_table_t* complement_id_hashtbl(id_hash_table_t* h, int nbtaxa);
 
 int lookup_id(id_hash_table_t *hashtable, Taxon_id my_id);
@@ -0,0 +1,199 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+/* The supports of booster from trees in memory: see libbooster.h */
+#include "libbooster.h"
+#include "tree.h"
+#include "arena.h"
+#include "rapid_transfer.h"
+#include "tbe_workspace.h"
+#include "fbp_intervals.h"
+#include <math.h>
+
+struct __BoosterContext {
+	BoosterAlgo algo;
+	Tree* ref_tree;
+	char** taxname_lookup_table;	/* of the reference tree: the taxon ids of all the trees are indices in it */
+	map_t taxid_map;		/* its hashmap */
+	Arena* arena;			/* the current bootstrap tree is built in it */
+	RapidTIContext* rapid;		/* BOOSTER_RTBE */
+	TBEWorkspace* tbe_ws;		/* BOOSTER_TBE */
+	FBPIndex* fbp_index;		/* BOOSTER_FBP */
+	FBPWorkspace* fbp_ws;
+	int* values;			/* transfer indices, or ids of the found edges, of the current bootstrap tree */
+	long* sums;			/* sums of the transfer indices, or numbers of times the edges are found */
+	int num_trees;
+};
+
+
+BoosterContext* booster_new(const char* nh, int length, BoosterAlgo algo) {
+	char** taxname_lookup_table = NULL;
+	/* only the classic TBE needs the bitsets on the edges (the parser does not modify the buffer) */
+	Tree* ref_tree = complete_parse_nh_buffer((char*) nh, length, &taxname_lookup_table, NULL, algo != BOOSTER_TBE, NULL);
+	if (ref_tree == NULL) return NULL;
+
+	BoosterContext* ctx = (BoosterContext*) calloc(1, sizeof(BoosterContext));
+	int n = ref_tree->nb_taxa, m = ref_tree->nb_edges;
+	ctx->algo = algo;
+	ctx->ref_tree = ref_tree;
+	ctx->taxname_lookup_table = taxname_lookup_table;
+	ctx->taxid_map = build_taxid_hashmap(taxname_lookup_table, n);
+	ctx->arena = arena_new(ARENA_BLOCK_SIZE);
+	switch (algo) {
+	case BOOSTER_RTBE:
+		ctx->rapid = new_rapidTI_context(ref_tree);
+		break;
+	case BOOSTER_TBE:
+		ctx->tbe_ws = new_tbe_workspace(ref_tree, 2*n-2);
+		break;
+	case BOOSTER_FBP:
+		ctx->fbp_ws = new_fbp_workspace(ref_tree->nb_nodes);
+		ctx->fbp_index = new_fbp_index(ref_tree, ctx->fbp_ws);
+		break;
+	}
+	/* at most 2n-2 edges are found in a bootstrap tree with the taxa of the reference tree */
+	ctx->values = (int*) malloc((m > 2*n ? m : 2*n) * sizeof(int));
+	ctx->sums = (long*) calloc(m, sizeof(long));
+	return ctx;
+}
+
+
+void booster_free(BoosterContext* ctx) {
+	int i;
+	if (ctx == NULL) return;
+	if (ctx->rapid) free_rapidTI_context(ctx->rapid);
+	if (ctx->tbe_ws) free_tbe_workspace(ctx->tbe_ws);
+	if (ctx->fbp_index) free_fbp_index(ctx->fbp_index);
+	if (ctx->fbp_ws) free_fbp_workspace(ctx->fbp_ws);
+	arena_free(ctx->arena);
+	free_taxid_hashmap(ctx->taxid_map);
+	for (i = 0; i < ctx->ref_tree->nb_taxa; i++) free(ctx->taxname_lookup_table[i]);
+	free(ctx->taxname_lookup_table);
+	free_tree(ctx->ref_tree);
+	free(ctx->values);
+	free(ctx->sums);
+	free(ctx);
+}
+
+
+/* whether the leaves of tree are the taxa of the reference tree */
+static int has_ref_taxa(const BoosterContext* ctx, Tree* tree) {
+	int i;
+	if (tree->nb_taxa != ctx->ref_tree->nb_taxa) return 0;
+	for (i = 0; i < tree->nb_nodes; i++)
+		if (tree->a_nodes[i]->nneigh == 1 && tree->a_nodes[i]->taxon_id < 0) return 0;
+	return 1;
+}
+
+
+int booster_add_bootstrap(BoosterContext* ctx, const char* nh, int length) {
+	Tree* ref_tree = ctx->ref_tree;
+	Tree* boot_tree;
+	int n = ref_tree->nb_taxa, m = ref_tree->nb_edges;
+	int i, nb_found;
+
+	arena_reset(ctx->arena); /* drops the previous tree */
+	/* the steps of complete_parse_nh_buffer(), with the taxa checked before anything is built from them:
+	   the bitsets of the classic TBE cannot be built with unknown taxa */
+	boot_tree = parse_nh_buffer((char*) nh, length, ctx->arena);
+	if (boot_tree == NULL) return BOOSTER_BAD_TREE;
+	boot_tree->taxname_lookup_table = ctx->taxname_lookup_table;
+	set_leaf_taxon_ids(boot_tree, ctx->taxid_map);
+	if (!has_ref_taxa(ctx, boot_tree)) return BOOSTER_OTHER_TAXA;
+	prepare_parsed_tree(boot_tree, ctx->algo != BOOSTER_TBE);
+
+	switch (ctx->algo) {
+	case BOOSTER_RTBE:
+		for (i = 0; i < m; i++) ctx->values[i] = 0;
+		prepare_alt_tree_rapidTI(boot_tree, ctx->rapid);
+		compute_transfer_indices_prepared(ref_tree, n, m, boot_tree, ctx->values, ctx->rapid);
+		for (i = 0; i < m; i++) ctx->sums[i] += ctx->values[i];
+		break;
+	case BOOSTER_TBE:
+		tbe_min_distances(ctx->tbe_ws, ref_tree, boot_tree);
+		for (i = 0; i < m; i++) ctx->sums[i] += ctx->tbe_ws->min_dist[i];
+		break;
+	case BOOSTER_FBP:
+		nb_found = fbp_found_edges(ctx->fbp_index, boot_tree, ctx->fbp_ws, ctx->values);
+		for (i = 0; i < nb_found; i++) ctx->sums[ctx->values[i]]++;
+		break;
+	}
+	ctx->num_trees++;
+	return BOOSTER_OK;
+}
+
+
+int booster_num_trees(const BoosterContext* ctx) {
+	return ctx->num_trees;
+}
+
+
+int booster_num_edges(const BoosterContext* ctx) {
+	return ctx->ref_tree->nb_edges;
+}
+
+
+void booster_supports(const BoosterContext* ctx, double* supports) {
+	Tree* ref_tree = ctx->ref_tree;
+	int i;
+	for (i = 0; i < ref_tree->nb_edges; i++) {
+		Edge* e = ref_tree->a_edges[i];
+		double avg = ctx->num_trees > 0 ? (double) ctx->sums[i] / ctx->num_trees : NAN;
+		if (e->right->nneigh == 1 || ctx->num_trees == 0) supports[i] = NAN;
+		/* the same formulas as in booster (see tbe_supports and fbp_supports) */
+		else if (ctx->algo == BOOSTER_FBP) supports[i] = avg;
+		else supports[i] = 1.0 - avg / (e->topo_depth - 1.0);
+	}
+}
+
+
+char* booster_support_tree(BoosterContext* ctx, double* supports) {
+	Tree* ref_tree = ctx->ref_tree;
+	int i, m = ref_tree->nb_edges;
+	double* values = supports != NULL ? supports : (double*) malloc(m * sizeof(double));
+	char* nh = NULL;
+	size_t nh_length = 0;
+	FILE* stream;
+
+	booster_supports(ctx, values);
+	/* the support of an edge is the name of its descendant (always the right side of the edge, by convention) */
+	for (i = 0; i < m; i++) {
+		Edge* e = ref_tree->a_edges[i];
+		if (e->right->nneigh == 1 || isnan(values[i])) continue;
+		free(e->right->name);
+		e->right->name = (char*) malloc(16 * sizeof(char));
+		sprintf(e->right->name, "%.6f", values[i]);
+		e->branch_support = values[i];
+	}
+	if (values != supports) free(values);
+
+	if ((stream = open_memstream(&nh, &nh_length)) == NULL) {
+		fprintf(stderr,"Fatal error : cannot write the tree in memory! Aborting.\n");
+		Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+	}
+	write_nh_tree(ref_tree, stream);
+	fclose(stream);
+	return nh;
+}
@@ -0,0 +1,69 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef _LIBBOOSTER_H_
+#define _LIBBOOSTER_H_
+
+/* libbooster: the supports of booster, computed from trees in memory (make libbooster).
+
+   A context holds a reference tree, prepared once, and the sums of the comparisons of the bootstrap trees
+   given to it one at a time, as Newick strings. The contexts are independent: several of them can be used at
+   the same time by different threads, as long as a context is only used by one thread at a time.
+   The fatal errors (out of memory) still print a message and exit, as in booster. */
+
+typedef enum { BOOSTER_TBE, BOOSTER_RTBE, BOOSTER_FBP } BoosterAlgo;
+
+typedef struct __BoosterContext BoosterContext;
+
+/* the return codes of booster_add_bootstrap */
+#define BOOSTER_OK		0
+#define BOOSTER_BAD_TREE	-1	/* not a correct Newick tree */
+#define BOOSTER_OTHER_TAXA	-2	/* its taxa are not the taxa of the reference tree */
+
+/* parses the reference tree in the length first chars of nh (that need not be null-terminated) and prepares
+   it for algo (BOOSTER_TBE: classic TBE, BOOSTER_RTBE: rapid TBE, BOOSTER_FBP: Felsenstein bootstrap).
+   Returns NULL if it is not a correct Newick tree. */
+BoosterContext* booster_new(const char* nh, int length, BoosterAlgo algo);
+void booster_free(BoosterContext* ctx);
+
+/* compares the bootstrap tree in the length first chars of nh to the reference tree, and adds it to the sums.
+   Returns BOOSTER_OK, or an error code if the tree was skipped. */
+int booster_add_bootstrap(BoosterContext* ctx, const char* nh, int length);
+
+/* number of bootstrap trees added so far */
+int booster_num_trees(const BoosterContext* ctx);
+
+/* number of edges of the reference tree, i.e. of values written by booster_supports */
+int booster_num_edges(const BoosterContext* ctx);
+
+/* writes into supports[i] the support of the edge i of the reference tree, from the trees added so far
+   (NAN for the terminal edges, and for all the edges while no tree was added) */
+void booster_supports(const BoosterContext* ctx, double* supports);
+
+/* same as booster_supports, if not NULL, and returns the reference tree with its supports as the names of
+   its internal nodes, as a null-terminated Newick string to be freed by the caller */
+char* booster_support_tree(BoosterContext* ctx, double* supports);
+
+#endif /* _LIBBOOSTER_H_ */
@@ -0,0 +1,453 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "nh_reader.h"
+#include "io.h"
+#include <limits.h>
+
+#include <ctype.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <time.h>
+
+#define NH_READER_INIT_CAPACITY	1024
+#define NH_READER_INTERRUPTED	(EOF - 1)	/* returned by nh_reader_getc() when the wait for data is interrupted */
+#define NH_READER_POLL_MS	100		/* how often an interruptible wait checks the interrupt flag */
+
+
+/* reads at most size bytes of the raw (maybe compressed) file into out, starting with the magic bytes.
+   The stream is unbuffered: what a pipe has is returned right away, without waiting for size bytes.
+   Returns the number of bytes read, 0 at the end of the file, -1 on error. */
+static int nh_reader_read_raw(NHReader* reader, unsigned char* out, int size) {
+	int nb = 0;
+	ssize_t nb_read;
+	while (reader->magic_pos < reader->magic_size && nb < size) out[nb++] = reader->magic[reader->magic_pos++];
+	if (nb == 0) {
+		do nb_read = read(fileno(reader->stream), out, size);
+		while (nb_read < 0 && errno == EINTR);
+		if (nb_read < 0) return -1;
+		nb = (int) nb_read;
+	}
+	return nb;
+} /* end nh_reader_read_raw */
+
+
+/* reads (and decompresses) at most size bytes of the file into out.
+   Returns the number of bytes read, 0 at the end of the file, -1 on error (a truncated compressed file is one:
+   its end comes in the middle of a gzip member or a zstd frame). */
+static int nh_reader_read_block(NHReader* reader, char* out, int size) {
+	int nb;
+	switch (reader->format) {
+	case NH_GZIP: {
+		z_stream* z = &reader->gz_stream;
+		int ret;
+		z->next_out = (Bytef*) out;
+		z->avail_out = size;
+		while (z->avail_out > 0) {
+			if (z->avail_in == 0) {
+				/* what the input read so far gives is handed out, rather than waiting for more of a stream */
+				if (z->avail_out < (uInt) size) break;
+				nb = nh_reader_read_raw(reader, reader->in_buffer, NH_READER_IN_SIZE);
+				if (nb < 0 || (nb == 0 && reader->member_open)) return -1;
+				if (nb == 0) break;
+				z->next_in = reader->in_buffer;
+				z->avail_in = nb;
+			}
+			ret = inflate(z, Z_NO_FLUSH);
+			reader->member_open = (ret != Z_STREAM_END);
+			if (ret == Z_STREAM_END) inflateReset(z); /* the file may be made of several concatenated gzip members */
+			else if (ret != Z_OK) return -1;
+		}
+		return size - z->avail_out;
+	}
+#ifdef HAVE_ZSTD
+	case NH_ZSTD: {
+		ZSTD_outBuffer output = { out, size, 0 };
+		size_t ret;
+		while (output.pos < output.size) {
+			if (reader->zstd_in.pos == reader->zstd_in.size) {
+				if (output.pos > 0) break; /* as for gzip */
+				nb = nh_reader_read_raw(reader, reader->in_buffer, NH_READER_IN_SIZE);
+				if (nb < 0 || (nb == 0 && reader->member_open)) return -1;
+				if (nb == 0) break;
+				reader->zstd_in.src = reader->in_buffer;
+				reader->zstd_in.size = nb;
+				reader->zstd_in.pos = 0;
+			}
+			ret = ZSTD_decompressStream(reader->zstd_stream, &output, &reader->zstd_in);
+			if (ZSTD_isError(ret)) return -1;
+			reader->member_open = (ret != 0); /* 0: the frame is decoded and flushed */
+		}
+		return (int) output.pos;
+	}
+#endif
+	default:
+		return nh_reader_read_raw(reader, (unsigned char*) out, size);
+	}
+} /* end nh_reader_read_block */
+
+
+/* body of the decompression thread: fills the free blocks of the ring, in order */
+static void* nh_reader_decompress(void* arg) {
+	NHReader* reader = (NHReader*) arg;
+	int next_block = 0; /* index of the next block to fill */
+	int size;
+
+	while (true) {
+		pthread_mutex_lock(&reader->lock);
+		while (reader->nb_filled == NH_READER_NB_BLOCKS && !reader->closing)
+			pthread_cond_wait(&reader->not_full, &reader->lock);
+		if (reader->closing) { pthread_mutex_unlock(&reader->lock); break; }
+		pthread_mutex_unlock(&reader->lock);
+
+		/* the block is free: the consumer only looks at the filled ones */
+		size = nh_reader_read_block(reader, reader->blocks[next_block], NH_READER_BLOCK_SIZE);
+
+		pthread_mutex_lock(&reader->lock);
+		if (size <= 0) {
+			reader->end_of_file = true;
+			reader->read_error = (size < 0);
+			pthread_cond_signal(&reader->not_empty);
+			pthread_mutex_unlock(&reader->lock);
+			break;
+		}
+		reader->block_sizes[next_block] = size;
+		reader->nb_filled++;
+		pthread_cond_signal(&reader->not_empty);
+		pthread_mutex_unlock(&reader->lock);
+		next_block = (next_block + 1) % NH_READER_NB_BLOCKS;
+	}
+	return NULL;
+} /* end nh_reader_decompress */
+
+
+/* gives the current block back to the decompression thread and waits for the next one.
+   Returns 1, 0 at the end of the file, or NH_READER_INTERRUPTED if reader->interrupt was set while waiting. */
+static int nh_reader_next_block(NHReader* reader) {
+	pthread_mutex_lock(&reader->lock);
+	if (reader->holding_block) {
+		reader->first_block = (reader->first_block + 1) % NH_READER_NB_BLOCKS;
+		reader->nb_filled--;
+		reader->holding_block = false;
+		pthread_cond_signal(&reader->not_full);
+	}
+	while (reader->nb_filled == 0 && !reader->end_of_file) {
+		if (reader->interrupt == NULL) {
+			pthread_cond_wait(&reader->not_empty, &reader->lock);
+			continue;
+		}
+		/* a signal handler can not wake us up: the flag is polled */
+		if (*reader->interrupt) {
+			pthread_mutex_unlock(&reader->lock);
+			return NH_READER_INTERRUPTED;
+		}
+		struct timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_nsec += NH_READER_POLL_MS * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L) { deadline.tv_sec++; deadline.tv_nsec -= 1000000000L; }
+		pthread_cond_timedwait(&reader->not_empty, &reader->lock, &deadline);
+	}
+	if (reader->nb_filled == 0) {
+		pthread_mutex_unlock(&reader->lock);
+		if (reader->read_error) {
+			fprintf(stderr,"Fatal error: the tree file can not be read or decompressed. Aborting.\n");
+			Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+		}
+		return 0;
+	}
+	reader->current = reader->blocks[reader->first_block];
+	reader->current_size = reader->block_sizes[reader->first_block];
+	reader->current_pos = 0;
+	reader->holding_block = true;
+	pthread_mutex_unlock(&reader->lock);
+	return 1;
+} /* end nh_reader_next_block */
+
+
+/* returns the next char, EOF at the end of the file, or NH_READER_INTERRUPTED */
+static inline int nh_reader_getc(NHReader* reader) {
+	if (reader->current_pos == reader->current_size) {
+		int ret = nh_reader_next_block(reader);
+		if (ret != 1) return ret == 0 ? EOF : NH_READER_INTERRUPTED;
+	}
+	return (unsigned char) reader->current[reader->current_pos++];
+}
+
+
+/* binary bootstrap set: the whole file is mapped, and its header and index are checked once for all */
+static void nh_reader_open_binary(NHReader* reader, const char* filename) {
+	struct stat file_stat;
+	const NHBinaryHeader* header;
+	int i;
+	if (fstat(fileno(reader->stream), &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+		fprintf(stderr,"Fatal error: the binary bootstrap set %s must be a regular file. Aborting.\n", filename);
+		Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+	}
+	void* map = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fileno(reader->stream), 0);
+	if (map == MAP_FAILED) {
+		fprintf(stderr,"Fatal error: can not map the binary bootstrap set %s. Aborting.\n", filename);
+		Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+	}
+	reader->map = (char*) map;
+	reader->map_size = file_stat.st_size;
+	header = (const NHBinaryHeader*) map;
+
+	if (reader->map_size < sizeof(NHBinaryHeader) || header->version != NH_BINARY_VERSION) {
+		fprintf(stderr,"Fatal error: %s is not a binary bootstrap set of this version of booster, or was written"
+			" on a machine of another byte order: convert its NH trees again. Aborting.\n", filename);
+		Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+	}
+	if (header->nb_names < 0 || header->nb_trees < 0
+	    || header->names_offset < (int64_t) sizeof(NHBinaryHeader) || header->names_offset > header->index_offset
+	    || header->index_offset % 8 != 0
+	    || (uint64_t) header->index_offset + ((uint64_t) header->nb_trees + 1) * sizeof(int64_t) > reader->map_size) {
+		fprintf(stderr,"Fatal error: the binary bootstrap set %s is truncated or corrupted. Aborting.\n", filename);
+		Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+	}
+	reader->binary = header;
+	reader->binary_index = (const int64_t*) (reader->map + header->index_offset);
+	/* the records are read through their double and int32 arrays (see load_bin_tree): they must be 8-byte aligned */
+	for (i = 0; i <= header->nb_trees; i++) {
+		int64_t begin = (i == 0 ? (int64_t) sizeof(NHBinaryHeader) : reader->binary_index[i-1]);
+		if (reader->binary_index[i] < begin || reader->binary_index[i] > header->names_offset
+		    || reader->binary_index[i] % 8 != 0
+		    || reader->binary_index[i] - begin > INT_MAX) {
+			fprintf(stderr,"Fatal error: the binary bootstrap set %s is truncated or corrupted. Aborting.\n", filename);
+			Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+		}
+	}
+} /* end nh_reader_open_binary */
+
+
+NHReader* nh_reader_open(const char* filename) {
+	int i;
+	/* the standard input is duplicated, so that closing the reader does not close it */
+	FILE* stream = strcmp(filename, "-") ? fopen(filename, "rb") : fdopen(dup(STDIN_FILENO), "rb");
+	if (stream == NULL) return NULL;
+	setvbuf(stream, NULL, _IONBF, 0); /* the blocks are read by read(2) (see nh_reader_read_raw) */
+
+	NHReader* reader = (NHReader*) calloc(1, sizeof(NHReader));
+
+	/* detecting the compression format from the magic number of the file.
+	   The stream is not rewound (it may be a pipe): the magic bytes are given back by nh_reader_read_raw() */
+	unsigned char* magic = reader->magic;
+	reader->stream = stream;
+	reader->magic_size = (int) fread(magic, 1, 4, stream);
+	reader->magic_pos = 0;
+	if (reader->magic_size >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+		reader->format = NH_GZIP;
+		reader->in_buffer = (unsigned char*) malloc(NH_READER_IN_SIZE * sizeof(unsigned char));
+		if (inflateInit2(&reader->gz_stream, 15 + 16 /* gzip header */) != Z_OK) {
+			fprintf(stderr,"Fatal error: can not initialize the decompression of %s. Aborting.\n", filename);
+			Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+		}
+	} else if (reader->magic_size == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) {
+#ifdef HAVE_ZSTD
+		reader->format = NH_ZSTD;
+		reader->in_buffer = (unsigned char*) malloc(NH_READER_IN_SIZE * sizeof(unsigned char));
+		reader->zstd_stream = ZSTD_createDStream();
+		ZSTD_initDStream(reader->zstd_stream);
+		reader->zstd_in.src = reader->in_buffer;
+		reader->zstd_in.size = 0;
+		reader->zstd_in.pos = 0;
+#else
+		fprintf(stderr,"Fatal error: %s is zstd-compressed, but booster was compiled without zstd support (make zstd=1). Aborting.\n", filename);
+		Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+#endif
+	} else if (reader->magic_size == 4 && memcmp(magic, NH_BINARY_MAGIC, 4) == 0) {
+		reader->format = NH_BINARY;
+		nh_reader_open_binary(reader, filename);
+		return reader;
+	} else {
+		reader->format = NH_PLAIN;
+		/* regular files are mapped: no decompression thread, no ring of blocks, no copy */
+		struct stat file_stat;
+		if (fstat(fileno(stream), &file_stat) == 0 && S_ISREG(file_stat.st_mode) && file_stat.st_size > 0) {
+			/* read-only, as the binary sets: the parser only reads the char* it gets (a write would fault) */
+			void* map = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fileno(stream), 0);
+			if (map != MAP_FAILED) {
+				madvise(map, file_stat.st_size, MADV_SEQUENTIAL);
+				reader->map = (char*) map;
+				reader->map_size = file_stat.st_size;
+				reader->map_pos = 0;
+				return reader;
+			}
+		}
+	}
+
+	for (i = 0; i < NH_READER_NB_BLOCKS; i++)
+		reader->blocks[i] = (char*) malloc(NH_READER_BLOCK_SIZE * sizeof(char));
+	pthread_mutex_init(&reader->lock, NULL);
+	pthread_cond_init(&reader->not_empty, NULL);
+	pthread_cond_init(&reader->not_full, NULL);
+
+	reader->capacity = NH_READER_INIT_CAPACITY;
+	reader->buffer = (char*) malloc(reader->capacity * sizeof(char));
+
+	if (pthread_create(&reader->decompressor, NULL, nh_reader_decompress, reader) != 0) {
+		fprintf(stderr,"Fatal error: can not start the thread reading %s. Aborting.\n", filename);
+		Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+	}
+	return reader;
+} /* end nh_reader_open */
+
+
+/* mapped file: the tree is the next piece of the mapping ending with a ';' */
+static char* nh_reader_next_mapped(NHReader* reader, int* length) {
+	char* tree_begin;
+	char* tree_end;
+	while (reader->map_pos < reader->map_size && isspace((unsigned char) reader->map[reader->map_pos])) reader->map_pos++;
+	if (reader->map_pos == reader->map_size) return NULL;
+
+	tree_begin = reader->map + reader->map_pos;
+	tree_end = memchr(tree_begin, ';', reader->map_size - reader->map_pos); /* vectorized in the libc */
+	if (tree_end == NULL) { /* a trailing piece of text with no ';' is not a tree */
+		reader->map_pos = reader->map_size;
+		return NULL;
+	}
+	if (tree_end - tree_begin + 1 > INT_MAX) {
+		fprintf(stderr,"Fatal error: tree of more than %d characters, are you sure it is an NH tree file? Aborting.\n", INT_MAX);
+		Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+	}
+	reader->map_pos = tree_end - reader->map + 1;
+	reader->num_read++;
+	if (length) *length = (int) (tree_end - tree_begin + 1);
+	return tree_begin;
+} /* end nh_reader_next_mapped */
+
+
+/* binary bootstrap set: the tree is its next record */
+static char* nh_reader_next_binary(NHReader* reader, int* length) {
+	int i = reader->num_read;
+	if (i == reader->binary->nb_trees) return NULL;
+	reader->num_read++;
+	if (length) *length = (int) (reader->binary_index[i+1] - reader->binary_index[i]);
+	return reader->map + reader->binary_index[i];
+} /* end nh_reader_next_binary */
+
+
+int nh_reader_binary_names(const NHReader* reader, char*** names) {
+	int i;
+	if (reader->binary == NULL) return -1;
+	/* the names are checked to be null-terminated inside their table */
+	const char* name = reader->map + reader->binary->names_offset;
+	const char* end = reader->map + reader->binary->index_offset;
+	*names = (char**) malloc(reader->binary->nb_names * sizeof(char*));
+	for (i = 0; i < reader->binary->nb_names; i++) {
+		const char* name_end = memchr(name, '\0', end - name);
+		if (name_end == NULL) {
+			fprintf(stderr,"Fatal error: the table of the taxa names of the binary bootstrap set is corrupted. Aborting.\n");
+			Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+		}
+		(*names)[i] = (char*) name;
+		name = name_end + 1;
+	}
+	return reader->binary->nb_names;
+} /* end nh_reader_binary_names */
+
+
+char* nh_reader_next(NHReader* reader, int* length) {
+	/* we skip whitespaces and stop right after the terminal ';'.
+	   A trailing piece of text with no ';' is not a tree. */
+	int index_in_string = reader->pending; /* the beginning of the tree may have been read before an interruption */
+	int u;
+	if (reader->binary) return nh_reader_next_binary(reader, length);
+	if (reader->map) return nh_reader_next_mapped(reader, length);
+	reader->pending = 0;
+	while ((u = nh_reader_getc(reader)) != ';') {
+		if (u == EOF) return NULL;
+		if (u == NH_READER_INTERRUPTED) { reader->pending = index_in_string; return NULL; }
+		if (isspace(u)) continue;
+		if (index_in_string + 2 >= reader->capacity) { /* room for the ';' and the '\0' */
+			if (reader->capacity > INT_MAX / 2) {
+				fprintf(stderr,"Fatal error: tree of more than %d characters, are you sure it is an NH tree file? Aborting.\n", INT_MAX);
+				Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+			}
+			reader->capacity *= 2;
+			reader->buffer = (char*) realloc(reader->buffer, reader->capacity * sizeof(char));
+		}
+		reader->buffer[index_in_string++] = (char) u;
+	}
+	reader->buffer[index_in_string++] = ';';
+	reader->buffer[index_in_string] = '\0';
+
+	reader->num_read++;
+	if (length) *length = index_in_string;
+	/* the buffer is reused for the next tree: the caller gets its own copy, of the exact size */
+	char* tree_string = (char*) malloc((index_in_string+1) * sizeof(char));
+	memcpy(tree_string, reader->buffer, index_in_string+1);
+	return tree_string;
+} /* end nh_reader_next */
+
+
+void nh_reader_release(NHReader* reader, char* tree_string) {
+	if (reader->map) return; /* nothing to do, it is a part of the mapping */
+	free(tree_string);
+}
+
+
+void nh_reader_close(NHReader* reader) {
+	int i;
+	if (reader == NULL) return;
+
+	if (reader->map) {
+		munmap(reader->map, reader->map_size);
+		fclose(reader->stream);
+		free(reader);
+		return;
+	}
+
+	pthread_mutex_lock(&reader->lock);
+	reader->closing = true;
+	pthread_cond_signal(&reader->not_full);
+	pthread_mutex_unlock(&reader->lock);
+	pthread_join(reader->decompressor, NULL);
+
+	switch (reader->format) {
+	case NH_GZIP:
+		inflateEnd(&reader->gz_stream);
+		break;
+#ifdef HAVE_ZSTD
+	case NH_ZSTD:
+		ZSTD_freeDStream(reader->zstd_stream);
+		break;
+#endif
+	default:
+		break;
+	}
+	free(reader->in_buffer);
+	fclose(reader->stream);
+
+	pthread_mutex_destroy(&reader->lock);
+	pthread_cond_destroy(&reader->not_empty);
+	pthread_cond_destroy(&reader->not_full);
+	for (i = 0; i < NH_READER_NB_BLOCKS; i++) free(reader->blocks[i]);
+	free(reader->buffer);
+	free(reader);
+} /* end nh_reader_close */
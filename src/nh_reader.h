@@ -0,0 +1,162 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef _NH_READER_H_
+#define _NH_READER_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <signal.h>
+#include <zlib.h>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+/* A reader handing out the NH trees of a file one at a time, so that the
+   bootstrap trees never have to be all loaded in memory at the same time.
+
+   The file may be plain text, gzip-compressed or (when compiled with
+   HAVE_ZSTD) zstd-compressed: the format is detected from its first bytes.
+   Plain regular files are memory-mapped: the trees are then handed out as
+   pointers into the mapping, with no copy, and the boundaries (';') of
+   each tree are only searched when the tree is asked for.
+   Other files are read by a dedicated thread, which decompresses them into
+   a small ring of blocks, so that decompression overlaps with the parsing
+   of the trees.
+
+   The reader is not thread safe by itself: when it is shared between the
+   workers of a parallel loop, calls to nh_reader_next() must be done in a
+   critical section. Each worker then owns the string it got, until it gives
+   it back with nh_reader_release(). Thus, at any time, the number of tree
+   strings in memory is bounded by the number of workers.
+
+   The file may also be a pipe, a FIFO or the standard input ("-"), whose
+   trees keep arriving: each tree is handed out as soon as its ';' is read.
+   A wait for the next tree can then be interrupted (see interrupt).
+
+   Finally, the file may be a binary bootstrap set written by booster convert
+   (see bin_trees.h), which must be a regular file: it is mapped, and each
+   tree is handed out as a pointer to its record in the mapping. */
+
+#define NH_READER_BLOCK_SIZE	(1 << 20)	/* size of the decompressed blocks */
+#define NH_READER_NB_BLOCKS	4		/* number of blocks in the ring */
+#define NH_READER_IN_SIZE	(1 << 18)	/* size of the compressed input buffer */
+
+typedef enum { NH_PLAIN, NH_GZIP, NH_ZSTD, NH_BINARY } nh_format_t;
+
+/* header of a binary bootstrap set: the records of the trees follow it, then its table of the taxa
+   names (null-terminated strings) and the index of the records. All the offsets are from the beginning
+   of the file, and all the sections are 8-byte aligned. The values are in the byte order of the machine
+   that wrote the file: the version of a file written with the other byte order is not recognized. */
+#define NH_BINARY_MAGIC		"BTRB"
+#define NH_BINARY_VERSION	1
+
+typedef struct __NHBinaryHeader {
+	char magic[4];
+	uint32_t version;
+	int32_t nb_names;	/* size of the table of the taxa names */
+	int32_t nb_trees;
+	int64_t names_offset;
+	int64_t index_offset;	/* nb_trees+1 offsets: the beginning of each record, then the end of the last one */
+} NHBinaryHeader;
+
+typedef struct __NHReader {
+	nh_format_t format;
+	char* map;		/* the mapped file, or NULL if the file is streamed */
+	size_t map_size;
+	size_t map_pos;		/* where to look for the next tree in the mapping */
+
+	FILE* stream;
+	unsigned char magic[4];	/* first bytes of the file, read to detect its format: the stream may not be seekable */
+	int magic_size;
+	int magic_pos;		/* number of magic bytes already given back by the stream */
+	unsigned char* in_buffer;	/* compressed input */
+	z_stream gz_stream;
+#ifdef HAVE_ZSTD
+	ZSTD_DStream* zstd_stream;
+	ZSTD_inBuffer zstd_in;
+#endif
+	bool member_open;	/* a gzip member or zstd frame is begun and not finished: the file can't end here */
+
+	/* ring of blocks filled by the decompression thread */
+	pthread_t decompressor;
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+	char* blocks[NH_READER_NB_BLOCKS];
+	int block_sizes[NH_READER_NB_BLOCKS];
+	int first_block;	/* index of the oldest filled block */
+	int nb_filled;		/* number of filled blocks */
+	bool end_of_file;	/* set by the decompression thread when it has nothing more to give */
+	bool read_error;	/* set by the decompression thread when the file can't be read/decompressed */
+	bool closing;		/* set by nh_reader_close() to stop the decompression thread */
+
+	/* block being consumed by nh_reader_next() */
+	char* current;
+	int current_size;
+	int current_pos;
+	bool holding_block;	/* whether current is a block of the ring, to be given back */
+
+	char* buffer;		/* growing buffer in which the current tree is copied */
+	int capacity;		/* allocated size of the buffer */
+	int pending;		/* number of chars of the current tree already in the buffer, when it was interrupted */
+	int num_read;		/* number of trees handed out so far */
+
+	const NHBinaryHeader* binary;	/* for a binary bootstrap set, its header in the mapping, NULL otherwise */
+	const int64_t* binary_index;
+
+	volatile sig_atomic_t* interrupt;	/* if not NULL, a wait for more data stops as soon as it is set (e.g. by
+						   a signal handler): nh_reader_next() then returns NULL, and the tree that
+						   was being read is kept for the next call */
+} NHReader;
+
+/* opens the given NH file ("-" for the standard input), possibly compressed, and starts its decompression thread.
+   Returns NULL if the file can not be opened. */
+NHReader* nh_reader_open(const char* filename);
+
+/* returns the next tree of the file, terminated by ';', and sets *length to its number of characters
+   if length is not NULL. Returns NULL when there is no more tree to read (or when interrupted, see interrupt).
+   @warning  when the file is mapped, the tree is NOT null-terminated and may contain whitespaces:
+             it has to be parsed with parse_nh_buffer(tree, length). It stays valid until nh_reader_close().
+             Otherwise the tree is a null-terminated copy with the whitespaces removed.
+             For a binary bootstrap set, it is the record of the tree (see load_bin_tree).
+             In any case, the caller must give it back with nh_reader_release() */
+char* nh_reader_next(NHReader* reader, int* length);
+
+/* for a binary bootstrap set, sets *names to its table of the taxa names, pointing into the mapping
+   (to be freed by the caller, but not the names), and returns the number of names. Returns -1 otherwise. */
+int nh_reader_binary_names(const NHReader* reader, char*** names);
+
+/* releases a tree string obtained with nh_reader_next() */
+void nh_reader_release(NHReader* reader, char* tree_string);
+
+/* stops the decompression thread, unmaps/closes the file and frees the reader */
+void nh_reader_close(NHReader* reader);
+
+#endif /* _NH_READER_H_ */
@@ -0,0 +1,160 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#define _GNU_SOURCE	/* sched_setaffinity, sched_getaffinity and the CPU_ macros */
+#include "numa.h"
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUMA_SYSFS	"/sys/devices/system/node"
+#define NUMA_MAX_NODES	1024
+
+struct __NumaAffinity {
+	cpu_set_t cpus;
+};
+
+
+/* appends to cpus the allowed cpus of a cpulist like "0-15,32-47", returns their number */
+static int parse_cpulist(const char* list, const cpu_set_t* allowed, int* cpus) {
+	int nb = 0, first, last, cpu, nb_chars;
+	while (sscanf(list, "%d%n", &first, &nb_chars) == 1) {
+		list += nb_chars;
+		last = first;
+		if (*list == '-' && sscanf(list + 1, "%d%n", &last, &nb_chars) == 1) list += 1 + nb_chars;
+		for (cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+			if (CPU_ISSET(cpu, allowed)) cpus[nb++] = cpu;
+		if (*list != ',') break;
+		list++;
+	}
+	return nb;
+}
+
+
+NumaTopology* numa_detect() {
+	NumaTopology* topo = (NumaTopology*) calloc(1, sizeof(NumaTopology));
+	cpu_set_t allowed;
+	char path[64], list[4096];
+	int node, cpu, nb_allowed;
+	FILE* f;
+
+	CPU_ZERO(&allowed);
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+		for (cpu = 0; cpu < CPU_SETSIZE; cpu++) CPU_SET(cpu, &allowed);
+	nb_allowed = CPU_COUNT(&allowed);
+
+	/* the nodes are numbered from 0, maybe with holes: the ones without allowed cpus are left out */
+	for (node = 0; node < NUMA_MAX_NODES; node++) {
+		snprintf(path, sizeof(path), NUMA_SYSFS "/node%d/cpulist", node);
+		if ((f = fopen(path, "r")) == NULL) continue;
+		if (fgets(list, sizeof(list), f) != NULL) {
+			int* cpus = (int*) malloc(nb_allowed * sizeof(int));
+			int nb = parse_cpulist(list, &allowed, cpus);
+			if (nb > 0) {
+				topo->cpus = (int**) realloc(topo->cpus, (topo->nb_nodes + 1) * sizeof(int*));
+				topo->nb_cpus = (int*) realloc(topo->nb_cpus, (topo->nb_nodes + 1) * sizeof(int));
+				topo->cpus[topo->nb_nodes] = cpus;
+				topo->nb_cpus[topo->nb_nodes++] = nb;
+			} else free(cpus);
+		}
+		fclose(f);
+	}
+
+	if (topo->nb_nodes == 0) { /* no NUMA information: one node */
+		topo->nb_nodes = 1;
+		topo->cpus = (int**) malloc(sizeof(int*));
+		topo->nb_cpus = (int*) malloc(sizeof(int));
+		topo->cpus[0] = (int*) malloc(nb_allowed * sizeof(int));
+		topo->nb_cpus[0] = 0;
+		for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+			if (CPU_ISSET(cpu, &allowed)) topo->cpus[0][topo->nb_cpus[0]++] = cpu;
+	}
+	return topo;
+}
+
+
+void free_numa_topology(NumaTopology* topo) {
+	int node;
+	if (topo == NULL) return;
+	for (node = 0; node < topo->nb_nodes; node++) free(topo->cpus[node]);
+	free(topo->cpus);
+	free(topo->nb_cpus);
+	free(topo);
+}
+
+
+/* first of the threads of the node, among nb_threads: the nodes before it have nb_cpus_before of the nb_cpus.
+   Rounded up: with fewer threads than nodes of the same size, the first nodes are used */
+static int numa_first_thread(long nb_cpus_before, long nb_cpus, int nb_threads) {
+	return (int) ((nb_cpus_before * nb_threads + nb_cpus - 1) / nb_cpus);
+}
+
+
+/* gives the first thread of the node of the thread in *first */
+static int numa_node_and_first(const NumaTopology* topo, int thread, int nb_threads, int* first) {
+	long nb_cpus = 0, nb_cpus_before = 0;
+	int node;
+	for (node = 0; node < topo->nb_nodes; node++) nb_cpus += topo->nb_cpus[node];
+	/* the node of the thread is the last one whose block begins at or before it */
+	for (node = 0; node < topo->nb_nodes - 1; node++) {
+		if (numa_first_thread(nb_cpus_before + topo->nb_cpus[node], nb_cpus, nb_threads) > thread) break;
+		nb_cpus_before += topo->nb_cpus[node];
+	}
+	*first = numa_first_thread(nb_cpus_before, nb_cpus, nb_threads);
+	return node;
+}
+
+
+int numa_thread_node(const NumaTopology* topo, int thread, int nb_threads) {
+	int first;
+	return numa_node_and_first(topo, thread, nb_threads, &first);
+}
+
+
+int numa_pin_thread(const NumaTopology* topo, int thread, int nb_threads, NumaAffinity** saved) {
+	int first;
+	int node = numa_node_and_first(topo, thread, nb_threads, &first);
+	cpu_set_t set;
+	*saved = (NumaAffinity*) malloc(sizeof(NumaAffinity));
+	if (sched_getaffinity(0, sizeof((*saved)->cpus), &(*saved)->cpus) != 0) { /* nothing to restore */
+		free(*saved);
+		*saved = NULL;
+	}
+	/* the threads of a node take its cpus in turn */
+	CPU_ZERO(&set);
+	CPU_SET(topo->cpus[node][(thread - first) % topo->nb_cpus[node]], &set);
+	if (sched_setaffinity(0, sizeof(set), &set) != 0)
+		fprintf(stderr,"Warning: thread %d could not be pinned to a cpu of NUMA node %d\n", thread, node);
+	return node;
+}
+
+
+void numa_unpin_thread(NumaAffinity* saved) {
+	if (saved == NULL) return;
+	if (sched_setaffinity(0, sizeof(saved->cpus), &saved->cpus) != 0)
+		fprintf(stderr,"Warning: a thread could not be given back its cpus after its NUMA pinning\n");
+	free(saved);
+}
@@ -0,0 +1,60 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef _NUMA_H_
+#define _NUMA_H_
+
+/* Placement of the threads on the NUMA nodes of the machine (--numa).
+
+   The nodes and their cpus are read from /sys/devices/system/node (Linux, no libnuma needed), restricted to the
+   cpus the process may run on. Without this information, the machine is one node with all these cpus.
+   The threads are given to the nodes in contiguous blocks, in proportion to the allowed cpus of each node (with
+   2 cpus on the first node and 30 on the second, 2 of 32 threads go to the first one; a node can get none),
+   and pinned to a cpu of their node: the memory they allocate and first touch is then on their node. */
+
+typedef struct __NumaTopology {
+	int nb_nodes;
+	int* nb_cpus;		/* nb_cpus[node] */
+	int** cpus;		/* cpus[node][i]: the ids of the cpus of the node */
+} NumaTopology;
+
+NumaTopology* numa_detect();
+void free_numa_topology(NumaTopology* topo);
+
+/* node of the given thread among nb_threads */
+int numa_thread_node(const NumaTopology* topo, int thread, int nb_threads);
+
+/* the cpus a thread could run on before it was pinned */
+typedef struct __NumaAffinity NumaAffinity;
+
+/* pins the calling thread, the given one among nb_threads, to a cpu of its node, and returns the node.
+   Its previous cpus are saved in *saved, to be given back by numa_unpin_thread at the end of the parallel
+   region: the threads of the OpenMP pool are reused by the next regions, maybe with other numbers of threads */
+int numa_pin_thread(const NumaTopology* topo, int thread, int nb_threads, NumaAffinity** saved);
+
+/* restores the cpus of the calling thread saved by numa_pin_thread, and frees saved (nothing if NULL) */
+void numa_unpin_thread(NumaAffinity* saved);
+
+#endif /* _NUMA_H_ */
@@ -0,0 +1,289 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "partial_result.h"
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#ifdef HAVE_MPI
+#include <mpi.h>
+#endif
+
+#define PARTIAL_RESULT_MAGIC "#booster partial result"
+#define PARTIAL_RESULT_VERSION 3
+
+
+static int is_tbe_algo(const char* algo) {
+	return !strcmp(algo, "tbe") || !strcmp(algo, "rtbe");
+}
+
+
+/* allocates a result with nothing accumulated */
+static PartialResult* alloc_partial_result(const char* algo, int nb_taxa, int nb_edges, int stats, int per_branch) {
+	int i;
+	PartialResult* res = (PartialResult*) calloc(1, sizeof(PartialResult));
+	strncpy(res->algo, algo, sizeof(res->algo) - 1);
+	res->nb_taxa = nb_taxa;
+	res->nb_edges = nb_edges;
+	res->sums = (long*) calloc(nb_edges, sizeof(long));
+	if (is_tbe_algo(algo)) {
+		res->has_squares = 1;
+		res->sums_sq = (long*) calloc(nb_edges, sizeof(long));
+		res->has_stats = stats;
+		res->moved_species_counts = (double*) calloc(nb_taxa, sizeof(double));
+		res->has_per_branch = stats && per_branch;
+	}
+	if (res->has_per_branch) {
+		int* block = (int*) calloc((size_t) nb_edges * nb_taxa, sizeof(int));
+		if (block == NULL) {
+			fprintf(stderr,"Fatal error : cannot allocate the %d x %d counts of moved taxa per branch! Aborting.\n", nb_edges, nb_taxa);
+			Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+		}
+		res->moved_species_counts_per_branch = (int**) malloc(nb_edges * sizeof(int*));
+		for (i = 0; i < nb_edges; i++) res->moved_species_counts_per_branch[i] = block + (size_t) i * nb_taxa;
+	}
+	return res;
+}
+
+PartialResult* new_partial_result(const char* algo, Tree* ref_tree, int stats, int per_branch) {
+	PartialResult* res = alloc_partial_result(algo, ref_tree->nb_taxa, ref_tree->nb_edges, stats, per_branch);
+	res->fingerprint = ref_tree_fingerprint(ref_tree);
+	return res;
+}
+
+
+void free_partial_result(PartialResult* res) {
+	if (res == NULL) return;
+	free(res->sums);
+	free(res->sums_sq);
+	free(res->moved_species_counts);
+	if (res->moved_species_counts_per_branch) {
+		free(res->moved_species_counts_per_branch[0]);
+		free(res->moved_species_counts_per_branch);
+	}
+	free(res);
+}
+
+
+/* 64 bits FNV-1a */
+static unsigned long long fnv_add(unsigned long long h, const void* data, size_t len) {
+	const unsigned char* p = (const unsigned char*) data;
+	size_t i;
+	for (i = 0; i < len; i++) { h ^= p[i]; h *= 1099511628211ULL; }
+	return h;
+}
+
+unsigned long long ref_tree_fingerprint(Tree* ref_tree) {
+	unsigned long long h = 14695981039346656037ULL;
+	int i;
+	for (i = 0; i < ref_tree->nb_taxa; i++)
+		h = fnv_add(h, ref_tree->taxname_lookup_table[i], strlen(ref_tree->taxname_lookup_table[i]) + 1);
+	for (i = 0; i < ref_tree->nb_edges; i++)
+		h = fnv_add(h, &ref_tree->a_edges[i]->topo_depth, sizeof(int));
+	return h;
+}
+
+
+void merge_partial_result(PartialResult* dst, const PartialResult* src) {
+	int i, j;
+	if (strcmp(dst->algo, src->algo) || dst->nb_taxa != src->nb_taxa || dst->nb_edges != src->nb_edges
+	    || dst->fingerprint != src->fingerprint) {
+		fprintf(stderr,"The partial results do not come from the same algorithm (%s, %s) on the same reference tree. Aborting.\n", dst->algo, src->algo);
+		Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+	}
+	if ((dst->has_stats && !src->has_stats) || (dst->has_per_branch && !src->has_per_branch)) {
+		fprintf(stderr,"A partial result does not have the statistics of the others (were they all computed with -S, -c?). Aborting.\n");
+		Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+	}
+	dst->num_trees += src->num_trees;
+	if (src->trees_read > dst->trees_read) dst->trees_read = src->trees_read;
+	for (i = 0; i < dst->nb_edges; i++) dst->sums[i] += src->sums[i];
+	if (!src->has_squares) dst->has_squares = 0; /* the variance is unknown from now on */
+	if (dst->has_squares)
+		for (i = 0; i < dst->nb_edges; i++) dst->sums_sq[i] += src->sums_sq[i];
+	if (dst->has_stats)
+		for (j = 0; j < dst->nb_taxa; j++) dst->moved_species_counts[j] += src->moved_species_counts[j];
+	if (dst->has_per_branch)
+		for (i = 0; i < dst->nb_edges; i++)
+			for (j = 0; j < dst->nb_taxa; j++)
+				dst->moved_species_counts_per_branch[i][j] += src->moved_species_counts_per_branch[i][j];
+}
+
+
+double support_ci_halfwidth(const PartialResult* res, Tree* ref_tree) {
+	const double z = 1.96;	/* 95% */
+	double max_half = 0.0, half, n = res->num_trees;
+	int i;
+	if (is_tbe_algo(res->algo) && (!res->has_squares || res->num_trees < 2)) return HUGE_VAL;
+	for (i = 0; i < res->nb_edges; i++) {
+		if (ref_tree->a_edges[i]->right->nneigh == 1) continue;
+		if (is_tbe_algo(res->algo)) {
+			/* the support of a tree is 1 - TI / (depth - 1): its variance is the one of TI scaled down */
+			double var = (res->sums_sq[i] - (double) res->sums[i] * res->sums[i] / n) / (n - 1);
+			half = z * sqrt((var > 0 ? var : 0) / n) / (ref_tree->a_edges[i]->topo_depth - 1);
+		} else {
+			/* the Agresti-Coull interval is not empty when no tree (or all of them) has the bipartition */
+			double nt = n + z * z, p = (res->sums[i] + z * z / 2) / nt;
+			half = z * sqrt(p * (1 - p) / nt);
+		}
+		if (half > max_half) max_half = half;
+	}
+	return max_half;
+}
+
+
+static void write_block(FILE* out, const PartialResult* res) {
+	int i, j;
+	fprintf(out, "%s\nversion %d\nalgo %s\ntaxa %d\nedges %d\nfingerprint %llx\ntrees %d\nread %d\nstats %d\nper_branch %d\nsquares %d\n",
+		PARTIAL_RESULT_MAGIC, PARTIAL_RESULT_VERSION, res->algo, res->nb_taxa, res->nb_edges, res->fingerprint,
+		res->num_trees, res->trees_read, res->has_stats, res->has_per_branch, res->has_squares);
+	for (i = 0; i < res->nb_edges; i++) fprintf(out, "%ld\n", res->sums[i]);
+	if (res->has_squares)
+		for (i = 0; i < res->nb_edges; i++) fprintf(out, "%ld\n", res->sums_sq[i]);
+	/* %.17g prints the doubles exactly */
+	if (res->has_stats)
+		for (j = 0; j < res->nb_taxa; j++) fprintf(out, "%.17g\n", res->moved_species_counts[j]);
+	if (res->has_per_branch)
+		for (i = 0; i < res->nb_edges; i++) {
+			for (j = 0; j < res->nb_taxa; j++) fprintf(out, j ? "\t%d" : "%d", res->moved_species_counts_per_branch[i][j]);
+			fprintf(out, "\n");
+		}
+}
+
+void write_partial_results(PartialResult** res, int nb, const char* filename) {
+	int k;
+	char* tmp_name = (char*) malloc(strlen(filename) + 5);
+	FILE* out;
+	sprintf(tmp_name, "%s.tmp", filename);
+	out = fopen(tmp_name, "w");
+	if (out == NULL) {
+		fprintf(stderr,"File %s not found or not writable. Aborting.\n", tmp_name);
+		Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+	}
+	for (k = 0; k < nb; k++) write_block(out, res[k]);
+	if (fclose(out) != 0 || rename(tmp_name, filename) != 0) {
+		fprintf(stderr,"Error while writing the partial result file %s. Aborting.\n", filename);
+		Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+	}
+	free(tmp_name);
+}
+
+
+static void bad_partial_result(const char* filename, const char* what) {
+	fprintf(stderr,"File %s is not a correct partial result file (%s). Aborting.\n", filename, what);
+	Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+}
+
+/* reads the next result of the file, returns NULL at its end */
+static PartialResult* read_block(FILE* in, const char* filename) {
+	char line[64], algo[8];
+	int version, nb_taxa, nb_edges, num_trees, trees_read = 0, stats, per_branch, squares = 0, i, j;
+	unsigned long long fingerprint;
+	PartialResult* res;
+	if (fscanf(in, " ") == EOF || fgets(line, sizeof(line), in) == NULL) return NULL;
+	if (strncmp(line, PARTIAL_RESULT_MAGIC, strlen(PARTIAL_RESULT_MAGIC)))
+		bad_partial_result(filename, "no header");
+	if (fscanf(in, " version %d", &version) != 1 || version < 1 || version > PARTIAL_RESULT_VERSION)
+		bad_partial_result(filename, "unknown version");
+	if (fscanf(in, " algo %7s taxa %d edges %d fingerprint %llx trees %d",
+		   algo, &nb_taxa, &nb_edges, &fingerprint, &num_trees) != 5
+	    || (version >= 2 && fscanf(in, " read %d", &trees_read) != 1)
+	    || fscanf(in, " stats %d per_branch %d", &stats, &per_branch) != 2
+	    || (version >= 3 && fscanf(in, " squares %d", &squares) != 1)
+	    || (!is_tbe_algo(algo) && strcmp(algo, "fbp")) || nb_taxa <= 0 || nb_edges <= 0 || num_trees < 0 || trees_read < 0)
+		bad_partial_result(filename, "incorrect header");
+
+	res = alloc_partial_result(algo, nb_taxa, nb_edges, stats, per_branch);
+	res->fingerprint = fingerprint;
+	res->num_trees = num_trees;
+	res->trees_read = trees_read;
+	if (!squares || !res->has_squares) {
+		res->has_squares = 0;
+		free(res->sums_sq);
+		res->sums_sq = NULL;
+	}
+	for (i = 0; i < nb_edges; i++)
+		if (fscanf(in, "%ld", &res->sums[i]) != 1) bad_partial_result(filename, "truncated sums");
+	if (res->has_squares)
+		for (i = 0; i < nb_edges; i++)
+			if (fscanf(in, "%ld", &res->sums_sq[i]) != 1) bad_partial_result(filename, "truncated sums of squares");
+	if (res->has_stats)
+		for (j = 0; j < nb_taxa; j++)
+			if (fscanf(in, "%lf", &res->moved_species_counts[j]) != 1) bad_partial_result(filename, "truncated statistics");
+	if (res->has_per_branch)
+		for (i = 0; i < nb_edges; i++)
+			for (j = 0; j < nb_taxa; j++)
+				if (fscanf(in, "%d", &res->moved_species_counts_per_branch[i][j]) != 1)
+					bad_partial_result(filename, "truncated statistics per branch");
+	return res;
+}
+
+PartialResult** read_partial_results(const char* filename, int* nb) {
+	PartialResult** res = NULL;
+	PartialResult* block;
+	FILE* in = fopen(filename, "r");
+	if (in == NULL) {
+		fprintf(stderr,"File %s not found or impossible to access media. Aborting.\n", filename);
+		Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+	}
+	*nb = 0;
+	while ((block = read_block(in, filename)) != NULL) {
+		res = (PartialResult**) realloc(res, (*nb + 1) * sizeof(PartialResult*));
+		res[(*nb)++] = block;
+	}
+	fclose(in);
+	if (*nb == 0) bad_partial_result(filename, "empty");
+	return res;
+}
+
+
+#ifdef HAVE_MPI
+/* MPI counts are ints: the large arrays are reduced by chunks */
+#define MPI_REDUCE_CHUNK (1 << 24)
+
+static void reduce_in_place(void* data, size_t count, MPI_Datatype type, size_t type_size, int root, int rank) {
+	size_t done, n;
+	for (done = 0; done < count; done += n) {
+		char* p = (char*) data + done * type_size;
+		n = count - done < MPI_REDUCE_CHUNK ? count - done : MPI_REDUCE_CHUNK;
+		if (rank == root) MPI_Reduce(MPI_IN_PLACE, p, (int) n, type, MPI_SUM, root, MPI_COMM_WORLD);
+		else MPI_Reduce(p, NULL, (int) n, type, MPI_SUM, root, MPI_COMM_WORLD);
+	}
+}
+
+void reduce_partial_result_mpi(PartialResult* res, int root) {
+	int rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	reduce_in_place(&res->num_trees, 1, MPI_INT, sizeof(int), root, rank);
+	reduce_in_place(res->sums, res->nb_edges, MPI_LONG, sizeof(long), root, rank);
+	if (res->has_squares)
+		reduce_in_place(res->sums_sq, res->nb_edges, MPI_LONG, sizeof(long), root, rank);
+	if (res->has_stats)
+		reduce_in_place(res->moved_species_counts, res->nb_taxa, MPI_DOUBLE, sizeof(double), root, rank);
+	if (res->has_per_branch)
+		reduce_in_place(res->moved_species_counts_per_branch[0], (size_t) res->nb_edges * res->nb_taxa,
+				MPI_INT, sizeof(int), root, rank);
+}
+#endif /* HAVE_MPI */
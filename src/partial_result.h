@@ -0,0 +1,103 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef _PARTIAL_RESULT_H_
+#define _PARTIAL_RESULT_H_
+
+#include "tree.h"
+
+/* The accumulated results of a set of bootstrap trees against a reference tree: everything the supports and
+   the statistics are computed from. Results of disjoint sets of bootstrap trees (shards of the bootstrap file)
+   are merged by summing them, be they written to partial result files or reduced between MPI ranks.
+   A partial result file is also the checkpoint of a run, that can then resume after the trees_read first
+   trees of the bootstrap file.
+
+   A partial result file is a text file, holding one result per reference tree (in their order) as:
+     #booster partial result
+     version 3
+     algo <tbe|rtbe|fbp>
+     taxa <nb_taxa>
+     edges <nb_edges>
+     fingerprint <hex fingerprint of the reference tree>
+     trees <num_trees>
+     read <trees_read>
+     stats <0|1>
+     per_branch <0|1>
+     squares <0|1>
+   followed by the nb_edges sums, one per line, then (if squares) the nb_edges sums of squares, then (if stats) the nb_taxa moved species counts, one per line,
+   then (if per_branch) the nb_edges lines of nb_taxa counts. */
+typedef struct __PartialResult {
+	char algo[8];			/* "tbe", "rtbe" or "fbp" */
+	int nb_taxa;
+	int nb_edges;
+	unsigned long long fingerprint;	/* of the reference tree, see ref_tree_fingerprint() */
+	int num_trees;			/* number of bootstrap trees accumulated */
+	int trees_read;			/* number of the first trees of the bootstrap file that were processed (by this
+					   shard: the trees of the other shards are read but not accumulated) */
+	long* sums;			/* per edge of the reference tree: sum of its transfer indices (tbe, rtbe),
+					   or number of trees having its bipartition (fbp) */
+	int has_squares;		/* whether sums_sq is accumulated (always for tbe and rtbe, except after
+					   merging a result of a version 2 file) */
+	long* sums_sq;			/* per edge: sum of the squares of its transfer indices, for the variance of
+					   the supports (see support_ci_halfwidth()) */
+	int has_stats;			/* whether moved_species_counts is accumulated */
+	double* moved_species_counts;	/* per taxon: sum over the trees of the rates of close branches around which it moves */
+	int has_per_branch;		/* whether moved_species_counts_per_branch is accumulated */
+	int** moved_species_counts_per_branch;	/* [edge][taxon]: number of trees in which the taxon moves around the
+						   close edge. The rows are one contiguous block. */
+} PartialResult;
+
+/* an empty result for the given algorithm and reference tree. sums_sq and moved_species_counts are always allocated for
+   tbe and rtbe (the classic tbe always fills it), moved_species_counts_per_branch only if per_branch. */
+PartialResult* new_partial_result(const char* algo, Tree* ref_tree, int stats, int per_branch);
+void free_partial_result(PartialResult* res);
+
+/* identifies the reference tree by the names of its taxa and the topological depths of its edges: the
+   results of two runs can only be merged if their edge ids designate the same bipartitions */
+unsigned long long ref_tree_fingerprint(Tree* ref_tree);
+
+/* adds src into dst (trees_read becomes the largest of both). Aborts if they are not results of the same algorithm on the same reference tree, or if
+   src lacks statistics that dst accumulates. */
+void merge_partial_result(PartialResult* dst, const PartialResult* src);
+
+/* the largest half-width of the 95% confidence intervals of the supports of the internal edges of ref_tree,
+   estimated from the num_trees trees of res: from the variance of the transfer indices for tbe and rtbe
+   (HUGE_VAL if res has no squares or less than 2 trees), from the Agresti-Coull interval of the proportion
+   for fbp. */
+double support_ci_halfwidth(const PartialResult* res, Tree* ref_tree);
+
+/* writes the nb results res[0..nb-1] into the file. It is replaced at once (written aside, then renamed): an
+   interrupted run leaves the previous one */
+void write_partial_results(PartialResult** res, int nb, const char* filename);
+/* returns the results of the file, and sets *nb to their number. Aborts if the file cannot be read or is not a
+   partial result file. Files of version 1 have no trees_read, and the ones of versions 1 and 2 no squares. */
+PartialResult** read_partial_results(const char* filename, int* nb);
+
+#ifdef HAVE_MPI
+/* sums the results of all the ranks of MPI_COMM_WORLD into the one of rank root (the others are left as is) */
+void reduce_partial_result_mpi(PartialResult* res, int root);
+#endif
+
+#endif /* _PARTIAL_RESULT_H_ */
@@ -0,0 +1,147 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "profile.h"
+#include "io.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/resource.h>
+
+static const char* phase_names[NB_PHASES] = {
+	"read_ref", "merge", "resume", "bootstrap", "checkpoint", "reduce", "output"
+};
+
+
+double profile_wall() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+double profile_cpu() {
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+Profile* new_profile(int nb_threads) {
+	Profile* profile = (Profile*) calloc(1, sizeof(Profile));
+	profile->nb_threads = nb_threads;
+	profile->threads = (ProfileThread*) calloc(nb_threads, sizeof(ProfileThread));
+	profile->start_wall = profile_wall();
+	profile->start_cpu = profile_cpu();
+	return profile;
+}
+
+void free_profile(Profile* profile) {
+	if (profile == NULL) return;
+	free(profile->threads);
+	free(profile);
+}
+
+
+void profile_phase_begin(Profile* profile) {
+	profile->current_wall = profile_wall();
+	profile->current_cpu = profile_cpu();
+}
+
+void profile_phase_end(Profile* profile, ProfilePhase phase) {
+	profile->phase_wall[phase] += profile_wall() - profile->current_wall;
+	profile->phase_cpu[phase] += profile_cpu() - profile->current_cpu;
+}
+
+
+static int hist_bucket(double seconds) {
+	double us = seconds * 1e6;
+	int b = 0;
+	while (us >= 1.0 && b < PROFILE_HIST_BUCKETS - 1) { us /= 2; b++; }
+	return b;
+}
+
+void profile_tree(ProfileThread* thread, double parse_seconds, double compare_seconds) {
+	thread->busy_seconds += parse_seconds + compare_seconds;
+	thread->trees++;
+	thread->parse_hist[hist_bucket(parse_seconds)]++;
+	thread->compare_hist[hist_bucket(compare_seconds)]++;
+}
+
+
+static void write_hist(FILE* out, const char* name, const Profile* profile, int compare) {
+	int b, t;
+	fprintf(out, "    \"%s\": [", name);
+	for (b = 0; b < PROFILE_HIST_BUCKETS; b++) {
+		long count = 0;
+		for (t = 0; t < profile->nb_threads; t++)
+			count += compare ? profile->threads[t].compare_hist[b] : profile->threads[t].parse_hist[b];
+		fprintf(out, b ? ", %ld" : "%ld", count);
+	}
+	fprintf(out, "]");
+}
+
+void write_profile(Profile* profile, const char* filename) {
+	int i;
+	long compared = 0, skipped = 0;
+	struct rusage usage;
+	FILE* out = fopen(filename, "w");
+	if (out == NULL) {
+		fprintf(stderr,"File %s not found or not writable. Aborting.\n", filename);
+		Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+	}
+	getrusage(RUSAGE_SELF, &usage);
+	for (i = 0; i < profile->nb_threads; i++) {
+		compared += profile->threads[i].trees;
+		skipped += profile->threads[i].skipped;
+	}
+
+	fprintf(out, "{\n  \"version\": \"%s\",\n  \"threads\": %d,\n", VERSION, profile->nb_threads);
+	fprintf(out, "  \"wall_seconds\": %.6f,\n  \"cpu_seconds\": %.6f,\n",
+		profile_wall() - profile->start_wall, profile_cpu() - profile->start_cpu);
+	fprintf(out, "  \"peak_rss_kb\": %ld,\n", (long) usage.ru_maxrss); /* kilobytes on Linux */
+	fprintf(out, "  \"phases\": {\n");
+	for (i = 0; i < NB_PHASES; i++)
+		fprintf(out, "    \"%s\": {\"wall_seconds\": %.6f, \"cpu_seconds\": %.6f}%s\n", phase_names[i],
+			profile->phase_wall[i], profile->phase_cpu[i], i < NB_PHASES - 1 ? "," : "");
+	fprintf(out, "  },\n");
+	fprintf(out, "  \"counters\": {\"trees_read\": %ld, \"trees_compared\": %ld, \"trees_skipped\": %ld, \"duplicate_topologies\": %ld},\n",
+		profile->trees_read, compared, skipped, profile->duplicates);
+	fprintf(out, "  \"per_thread\": [\n");
+	for (i = 0; i < profile->nb_threads; i++) {
+		const ProfileThread* t = &profile->threads[i];
+		fprintf(out, "    {\"thread\": %d, \"numa_node\": %d, \"trees\": %ld, \"skipped\": %ld, \"busy_seconds\": %.6f, \"read_seconds\": %.6f, \"reduce_seconds\": %.6f}%s\n",
+			i, t->numa_node, t->trees, t->skipped, t->busy_seconds, t->read_seconds, t->reduce_seconds, i < profile->nb_threads - 1 ? "," : "");
+	}
+	fprintf(out, "  ],\n");
+	/* the upper bound of bucket i is 2^i microseconds */
+	fprintf(out, "  \"latency_histograms_us\": {\n    \"bucket_upper_bounds\": [");
+	for (i = 0; i < PROFILE_HIST_BUCKETS; i++) fprintf(out, i ? ", %.0f" : "%.0f", (double) (1UL << i));
+	fprintf(out, "],\n");
+	write_hist(out, "parse", profile, 0);
+	fprintf(out, ",\n");
+	write_hist(out, "compare", profile, 1);
+	fprintf(out, "\n  }\n}\n");
+	fclose(out);
+}
@@ -0,0 +1,90 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+/* Instrumentation of a run (--profile): wall and CPU time of its phases, busy time of each thread, latency
+   histograms of the parsing and the comparison of the bootstrap trees, peak RSS and counters, written as a JSON
+   file at the end of the run.
+   When --profile is not given there is no Profile: each measure costs one test of a NULL pointer. This is
+   separate from the DB_TRACE debug output of debug.h. */
+
+/* the phases of main() */
+typedef enum {
+	PHASE_READ_REF,		/* reading and parsing the reference trees (with their hashtables) */
+	PHASE_MERGE,		/* reading the partial results (--merge) */
+	PHASE_RESUME,		/* reading the checkpoint and skipping the trees already processed */
+	PHASE_BOOTSTRAP,	/* tbe() or fbp(): reading, parsing and comparing the bootstrap trees */
+	PHASE_CHECKPOINT,	/* writing the checkpoint */
+	PHASE_REDUCE,		/* summing the results of the MPI ranks */
+	PHASE_OUTPUT,		/* computing the supports and writing the output files */
+	NB_PHASES
+} ProfilePhase;
+
+/* latencies in microseconds: bucket i counts the ones in [2^(i-1), 2^i[ (bucket 0: below 1 us) */
+#define PROFILE_HIST_BUCKETS 32
+
+/* what one thread measured in the loops of tbe() and fbp() */
+typedef struct __ProfileThread {
+	double busy_seconds;		/* parsing and comparing the trees */
+	double read_seconds;		/* getting the tree strings from the reader (waiting for it included) */
+	double reduce_seconds;		/* adding the sums of the thread to the results */
+	long trees;			/* number of trees compared */
+	long skipped;			/* number of trees skipped (not a tree, or not the taxa of the reference) */
+	int numa_node;			/* node on which the thread is pinned (--numa), 0 otherwise */
+	long parse_hist[PROFILE_HIST_BUCKETS];
+	long compare_hist[PROFILE_HIST_BUCKETS];
+} ProfileThread;
+
+typedef struct __Profile {
+	double start_wall, start_cpu;
+	double phase_wall[NB_PHASES];
+	double phase_cpu[NB_PHASES];
+	double current_wall, current_cpu;	/* start of the current phase */
+	int nb_threads;
+	ProfileThread* threads;		/* indexed by omp thread number */
+	long trees_read;		/* number of trees of the bootstrap file read (skipped or not) */
+	long duplicates;		/* number of trees whose topology was already compared (--dedup) */
+} Profile;
+
+Profile* new_profile(int nb_threads);
+void free_profile(Profile* profile);
+
+/* elapsed and process CPU times, in seconds */
+double profile_wall();
+double profile_cpu();
+
+/* the time between these calls is added to the phase */
+void profile_phase_begin(Profile* profile);
+void profile_phase_end(Profile* profile, ProfilePhase phase);
+
+/* counts the parse and compare latencies (in seconds) of one tree */
+void profile_tree(ProfileThread* thread, double parse_seconds, double compare_seconds);
+
+/* writes the profile as a JSON file (with the peak RSS of the process) */
+void write_profile(Profile* profile, const char* filename);
+
+#endif /* _PROFILE_H_ */
@@ -3,6 +3,80 @@ Here we implement the faster, tree traversal based, Transfer Index computation.
 */
 #include "rapid_transfer.h"
 
+#include <limits.h>
+
+
+/*
+Allocate a context for the rapid Transfer Index computations on ref_tree.
+*/
+RapidTIContext* new_rapidTI_context(const Tree *ref_tree)
+{
+  RapidTIContext *ctx = malloc(sizeof(RapidTIContext));
+  ctx->ti_min = calloc(ref_tree->nb_nodes, sizeof(int));
+  ctx->ti_max = calloc(ref_tree->nb_nodes, sizeof(int));
+  ctx->ti_min_at = calloc(ref_tree->nb_nodes, sizeof(int));
+  ctx->ti_max_at = calloc(ref_tree->nb_nodes, sizeof(int));
+  ctx->other = calloc(ref_tree->nb_taxa, sizeof(int));
+  ctx->alt = new_flat_tree(ref_tree->nb_nodes); //alt_tree has the same leaves
+  ctx->path_capacity = ref_tree->nb_nodes;
+  ctx->path = malloc(ctx->path_capacity * sizeof(int));
+  ctx->ref_stack = malloc(ref_tree->nb_nodes * sizeof(Node*));
+  ctx->in_u = calloc(ref_tree->nb_taxa, sizeof(int));
+  ctx->in_v = calloc(ref_tree->nb_taxa, sizeof(int));
+  ctx->stamp = 0;
+  ctx->borrowed_alt = false;
+  return ctx;
+}
+
+/*
+Allocate a context for ref_tree that uses the flat alt_tree of owner.
+*/
+RapidTIContext* new_rapidTI_context_sharing(const Tree *ref_tree,
+                                            RapidTIContext *owner)
+{
+  RapidTIContext *ctx = new_rapidTI_context(ref_tree);
+  free(ctx->other);
+  free_flat_tree(ctx->alt);
+  ctx->other = owner->other;
+  ctx->alt = owner->alt;
+  ctx->borrowed_alt = true;
+  return ctx;
+}
+
+/*
+Make sure that the scratch space of ctx is large enough for alt_tree.
+A path from a leaf to the root can not have more nodes than the tree.
+*/
+void reserve_rapidTI_context(RapidTIContext *ctx, const Tree *alt_tree)
+{
+  if(alt_tree->nb_nodes > ctx->path_capacity)
+  {
+    ctx->path_capacity = alt_tree->nb_nodes;
+    ctx->path = realloc(ctx->path, ctx->path_capacity * sizeof(int));
+  }
+}
+
+/*
+Free the given context.
+*/
+void free_rapidTI_context(RapidTIContext *ctx)
+{
+  free(ctx->ti_min);
+  free(ctx->ti_max);
+  free(ctx->ti_min_at);
+  free(ctx->ti_max_at);
+  free(ctx->path);
+  free(ctx->ref_stack);
+  free(ctx->in_u);
+  free(ctx->in_v);
+  if(!ctx->borrowed_alt)
+  {
+    free(ctx->other);
+    free_flat_tree(ctx->alt);
+  }
+  free(ctx);
+}
+
 
 /*
 Compute the Transfer Index (TI) for all edges, comparing a reference tree to
@@ -20,22 +94,50 @@ u', as long as u is the "heavy" child of u'. This is repeated, starting at
 each leaf.
 
 At the end, transfer_index[i] will have the transfer index for edge i.
+
+The ref_tree is only read: the per node values go in ctx, so that several
+threads can share the same ref_tree.
 */
 void compute_transfer_indices_new(Tree *ref_tree, const int n,
                                   const int m, Tree *alt_tree,
-                                  int *transfer_index)
+                                  int *transfer_index, RapidTIContext *ctx)
+{
+  prepare_alt_tree_rapidTI(alt_tree, ctx);
+  compute_transfer_indices_prepared(ref_tree, n, m, alt_tree, transfer_index,
+                                    ctx);
+}
+
+/*
+Flatten alt_tree in ctx, and map its leaves.
+*/
+void prepare_alt_tree_rapidTI(const Tree *alt_tree, RapidTIContext *ctx)
+{
+  flatten_tree(ctx->alt, alt_tree);  //The kernel works on the flat alt_tree
+  set_leaf_bijection_rapidTI(alt_tree, ctx);  //Map leaves between the trees
+}
+
+/*
+Compute the Transfer Index of ref_tree against the alt_tree prepared in ctx.
+Each heavy path is reset after its computation, so that the flat alt_tree can
+be used again.
+*/
+void compute_transfer_indices_prepared(Tree *ref_tree, const int n,
+                                       const int m, Tree *alt_tree,
+                                       int *transfer_index,
+                                       RapidTIContext *ctx)
 {
-  set_leaf_bijection(ref_tree, alt_tree);  //Map leaves between the two trees
+  reserve_rapidTI_context(ctx, alt_tree);
 
   DB_CALL(0, print_nodes_post_order(ref_tree));
   DB_TRACE(0, "alt_tree:\n");
-  DB_CALL(0, print_nodes_post_order(alt_tree));
+  DB_CALL(0, print_flat_tree_TIvars(ctx->alt));
 
   Node** ref_leaves = ref_tree->leaves->a; //Leaves in ref_tree
 
     //Compute the TI for each node, following paths from leaves in ref_tree up
     //to the root, calling add_leaf on leaves from pendant subtrees. At the end
-    //of each loop, the TI will be the value of d_min at the root of alt_tree.
+    //of each loop, the TI will be the value of d_min at the root of alt_tree
+    //(node 0 of the flat tree).
   Node* u;                                 //Node to follow to root of ref_tree
   for(int i=0; i < ref_tree->nb_taxa; i++)
   {
@@ -44,9 +146,9 @@ void compute_transfer_indices_new(Tree *ref_tree, const int n,
     DB_TRACE(0, "------------------ new heavy -------------------------\n");
     DB_CALL(0, fprintf(stderr, "ref_tree "); print_node(u));
     DB_CALL(0, fprintf(stderr, "alt_tree ");
-               print_nodes_TIvars(alt_tree->a_nodes, alt_tree->nb_nodes));
+               print_flat_tree_TIvars(ctx->alt));
 
-    add_heavy_path(u, alt_tree);   //Compute TI on heavy path starting at u
+    add_heavy_path(u, alt_tree, ctx); //Compute TI on heavy path starting at u
     //for(int j=0; j < alt_tree->nb_nodes; j++)
     //{
     //  if(alt_tree->a_nodes[j]->d_lazy < 0)
@@ -55,28 +157,205 @@ void compute_transfer_indices_new(Tree *ref_tree, const int n,
     //    exit(0);
     //  }
     //}
-    reset_heavy_path(u);           //Reset TI associated variables on alt_tree
+    reset_heavy_path(u, ctx);         //Reset TI associated variables on alt_tree
   }
 
-  nodeTI_to_edgeTI(ref_tree);                //Move node values to the edges
-  edgeTI_to_array(ref_tree, transfer_index); //Copy edge values into the array
+  nodeTI_to_edgeTI(ref_tree, ctx, transfer_index); //Node values to the edges
+}
+
+
+/*
+Allocate a worker, with no room yet: bind_rapidTI_worker() makes it.
+*/
+RapidTIWorker* new_rapidTI_worker(void)
+{
+  RapidTIWorker *w = calloc(1, sizeof(RapidTIWorker));
+  if(!w)
+  {
+    fprintf(stderr, "Error: cannot allocate a rapid TI worker\n");
+    Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+  }
+  return w;
 }
 
+/*
+Free the given worker (not the structure of the flat alt_tree it borrows).
+*/
+void free_rapidTI_worker(RapidTIWorker *w)
+{
+  free(w->d_lazy);
+  free(w->diff);
+  free(w->d_min);
+  free(w->d_max);
+  free(w->d_min_at);
+  free(w->d_max_at);
+  free(w->path);
+  free(w);
+}
 
 /*
-Copy the edge Transfer Index values into the given array.
+Make w work on the flat alt_tree of ctx: borrow its structure, and copy its
+values, which are in their prepared state (each heavy path is reset after its
+computation).  The arrays are only reallocated for a larger tree.
 */
-void edgeTI_to_array(Tree *tree, int *transfer_index)
+void bind_rapidTI_worker(RapidTIWorker *w, const RapidTIContext *ctx)
 {
-  for(int i=0; i < tree->nb_edges; i++)
-    transfer_index[i] = tree->a_edges[i]->transfer_index;
+  const FlatTree *t = ctx->alt;
+  int nb = t->nb_nodes;
+  if(nb > w->capacity)
+  {
+    w->capacity = nb;
+    w->d_lazy = realloc(w->d_lazy, nb * sizeof(int));
+    w->diff = realloc(w->diff, nb * sizeof(int));
+    w->d_min = realloc(w->d_min, nb * sizeof(int));
+    w->d_max = realloc(w->d_max, nb * sizeof(int));
+    w->d_min_at = realloc(w->d_min_at, nb * sizeof(int));
+    w->d_max_at = realloc(w->d_max_at, nb * sizeof(int));
+    w->path = realloc(w->path, nb * sizeof(int));
+    if(!w->d_lazy || !w->diff || !w->d_min || !w->d_max || !w->d_min_at ||
+       !w->d_max_at || !w->path)
+    {
+      fprintf(stderr, "Error: cannot allocate a rapid TI worker of %d nodes\n",
+              nb);
+      Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+    }
+  }
+  memcpy(w->d_lazy, t->d_lazy, nb * sizeof(int));
+  memcpy(w->diff, t->diff, nb * sizeof(int));
+  memcpy(w->d_min, t->d_min, nb * sizeof(int));
+  memcpy(w->d_max, t->d_max, nb * sizeof(int));
+  memcpy(w->d_min_at, t->d_min_at, nb * sizeof(int));
+  memcpy(w->d_max_at, t->d_max_at, nb * sizeof(int));
+
+  w->alt = *t;                           //The structure of t, with w's values
+  w->alt.d_lazy = w->d_lazy;
+  w->alt.diff = w->diff;
+  w->alt.d_min = w->d_min;
+  w->alt.d_max = w->d_max;
+  w->alt.d_min_at = w->d_min_at;
+  w->alt.d_max_at = w->d_max_at;
+}
+
+/*
+Compute, in ctx, the TI of the heavy paths starting at ref_leaves[first] to
+ref_leaves[last-1], on the copy of the flat alt_tree in w.  The heavy path
+functions run on a view of ctx: its node values, with the flat alt_tree and the
+path of w.
+*/
+void compute_heavy_paths_rapidTI(Tree *ref_tree, int first, int last,
+                                 Tree *alt_tree, RapidTIContext *ctx,
+                                 RapidTIWorker *w)
+{
+  RapidTIContext view = *ctx;
+  view.alt = &w->alt;
+  view.path = w->path;
+  view.path_capacity = w->capacity;
+
+  Node** ref_leaves = ref_tree->leaves->a;
+  for(int i=first; i < last; i++)
+  {
+    add_heavy_path(ref_leaves[i], alt_tree, &view);
+    reset_heavy_path(ref_leaves[i], &view);
+  }
+}
+
+
+/*
+Write into ids the taxa to move to go from the edge above u (in ref_tree) to
+its closest edge in alt_tree, and return their number.
+
+The transfer index of the edge is min(ti_min, n - ti_max): it is either the
+size of L(u) - L(v) U L(v) - L(u), with v the node at which ti_min was found,
+or the number of taxa out of this symmetric difference, with v the node at
+which ti_max was found.  L(u) is collected with a traversal of the subtree of
+u and L(v) is a run of the flat alt_tree; both sets are marked by taxon with
+the current stamp, so that nothing needs to be cleared between two calls.
+*/
+int rapid_moved_taxa(const Node *u, int n, RapidTIContext *ctx, int *ids)
+{
+  FlatTree *t = ctx->alt;
+  bool out = n - ctx->ti_max[u->id] < ctx->ti_min[u->id];
+  int v = out ? ctx->ti_max_at[u->id] : ctx->ti_min_at[u->id];
+  int nb = 0;
+  if(ctx->stamp == INT_MAX)            //Start the stamps over
+  {
+    memset(ctx->in_u, 0, n * sizeof(int));
+    memset(ctx->in_v, 0, n * sizeof(int));
+    ctx->stamp = 0;
+  }
+  int stamp = ++ctx->stamp;
+
+  int top = 0;                         //L(u): the leaves below u
+  ctx->ref_stack[top++] = (Node*) u;
+  while(top)
+  {
+    Node *w = ctx->ref_stack[--top];
+    if(w->nneigh == 1)
+      ctx->in_u[w->taxon_id] = stamp;
+    else
+      for(int j=1; j < w->nneigh; j++) //neigh[0] is the parent
+        ctx->ref_stack[top++] = w->neigh[j];
+  }
+  for(int k = v; k < t->end[v]; k++)   //L(v)
+    if(t->taxon[k] >= 0)
+      ctx->in_v[t->taxon[k]] = stamp;
+
+  if(!out)
+  {
+    for(int k = v; k < t->end[v]; k++) //L(v) - L(u)
+      if(t->taxon[k] >= 0 && ctx->in_u[t->taxon[k]] != stamp)
+        ids[nb++] = t->taxon[k];
+    top = 0;                           //L(u) - L(v)
+    ctx->ref_stack[top++] = (Node*) u;
+    while(top)
+    {
+      Node *w = ctx->ref_stack[--top];
+      if(w->nneigh == 1)
+      {
+        if(ctx->in_v[w->taxon_id] != stamp)
+          ids[nb++] = w->taxon_id;
+      }
+      else
+        for(int j=1; j < w->nneigh; j++)
+          ctx->ref_stack[top++] = w->neigh[j];
+    }
+  }
+  else                                 //in both, or in none of L(u) and L(v)
+    for(int i=0; i < n; i++)
+      if((ctx->in_u[i] == stamp) == (ctx->in_v[i] == stamp))
+        ids[nb++] = i;
+
+  return nb;
+}
+
+
+/*
+Map each taxon to the index of its leaf in the flat alt_tree, in ctx.  The leaf
+of ref_tree with the same taxon_id is then paired with it, without having to
+compare the names.
+
+@warning  assumes alt_tree was flattened in ctx->alt
+*/
+void set_leaf_bijection_rapidTI(const Tree *alt_tree, RapidTIContext *ctx)
+{
+  for(int i=0; i < alt_tree->leaves->i; i++)
+  {
+    Node *leaf = alt_tree->leaves->a[i];
+    if(leaf->taxon_id < 0)
+    {
+      fprintf(stderr, "Fatal error : taxon %s not found! Aborting.\n",
+              leaf->name);
+      Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+    }
+    ctx->other[leaf->taxon_id] = ctx->alt->index[leaf->id];
+  }
 }
 
 /*
 Follow a leaf in ref_tree up to the root.  Call add_leaf on the leaves in the
 subtrees off the path.
 */
-void add_heavy_path(Node *u, Tree *alt_tree)
+void add_heavy_path(Node *u, Tree *alt_tree, RapidTIContext *ctx)
 {
   while(u)                               //Have not visited the root and have
   {                                      //not seen a heavier sibling
@@ -87,19 +366,22 @@ void add_heavy_path(Node *u, Tree *alt_tree)
     if(u->nneigh == 1)                          //a leaf
     {
       DB_TRACE(0, "leaf - "); DB_CALL(0, print_node(u));
-      add_leaf(u->other);                       //call add_leaf on v
+      add_leaf(ctx->other[u->taxon_id], ctx);   //call add_leaf on v
     }
     else
     {
       DB_TRACE(0, "subtree - "); DB_CALL(0, printLA(u->lightleaves));
       for(int i=0; i < u->lightleaves->i; i++)  //a subtree
-        add_leaf(u->lightleaves->a[i]->other);  //add_leaf on leaves in subtree
+        add_leaf(ctx->other[u->lightleaves->a[i]->taxon_id], ctx); //subtree
     }
 
       //Record the transfer index:
-    u->ti_min = alt_tree->node0->d_min;
-    u->ti_max = alt_tree->node0->d_max;
-    DB_CALL(0, fprintf(stderr, "++++++++ TI: %i %i\n", u->ti_min, u->ti_max));
+    ctx->ti_min[u->id] = ctx->alt->d_min[0];
+    ctx->ti_max[u->id] = ctx->alt->d_max[0];
+    ctx->ti_min_at[u->id] = ctx->alt->d_min_at[0];
+    ctx->ti_max_at[u->id] = ctx->alt->d_max_at[0];
+    DB_CALL(0, fprintf(stderr, "++++++++ TI: %i %i\n", ctx->ti_min[u->id],
+                       ctx->ti_max[u->id]));
 
       //Head upwards:
     if(u->depth != 0 && u == u->neigh[0]->heavychild)
@@ -114,16 +396,16 @@ void add_heavy_path(Node *u, Tree *alt_tree)
 Follow a leaf in ref_tree up to the root. Call reset_leaf on the leaves in
 the subtrees off the path.
 */
-void reset_heavy_path(Node* u)
+void reset_heavy_path(Node* u, const RapidTIContext *ctx)
 {
   while(u)                               //Have not visited the root and have
   {                                      //not seen a heavier sibling
       //Add the leaves from the light subtree:
     if(u->nneigh == 1)       //a leaf
-      reset_leaf(u->other);  //call add_leaf on v
+      reset_leaf(ctx->other[u->taxon_id], ctx->alt);  //call reset_leaf on v
     else
       for(int i=0; i < u->lightleaves->i; i++)
-        reset_leaf(u->lightleaves->a[i]->other);
+        reset_leaf(ctx->other[u->lightleaves->a[i]->taxon_id], ctx->alt);
 
       //Head upwards:
     if(u->depth == 0 || u != u->neigh[0]->heavychild)
@@ -135,116 +417,165 @@ void reset_heavy_path(Node* u)
 
 
 /*
-Add the given leaf (from alt_tree) to the set L(v) for all v on a path from
-leaf to the root.
+Add the given leaf (from the flat alt_tree) to the set L(v) for all v on a path
+from leaf to the root.  The path is built in the scratch space of ctx, so that
+nothing is allocated here.
 */
-void add_leaf(Node *leaf)
+void add_leaf(int leaf, RapidTIContext *ctx)
 {
-  assert_is_leaf(leaf);
+  FlatTree *t = ctx->alt;
+  assert_is_leaf(t, leaf);
 
     //Follow the path from the root to the leaf, updating the d_lazy values
     //with the diff values, subtracting 1, but adding 1 to the diff values of
     //nodes off the path:
-  Node **path = path_to_root(leaf);
-  for(int i = leaf->depth; i > 0; i--)              //For all non leaf Nodes
+  int *path = ctx->path;
+  int depth = t->depth[leaf];
+  flat_path_to_root(t, leaf, path);
+  for(int i = depth; i > 0; i--)                    //For all non leaf Nodes
   {
-    DB_TRACE(0, "current: "); DB_CALL(0, print_node(path[i]));
-    DB_TRACE(0, "         "); DB_CALL(0, print_node_TIvars(path[i]));
-    path[i]->d_lazy += path[i]->diff - 1;
-    path[i-1]->diff += path[i]->diff;               //Push difference down
-
-    int startindex = 1;                             //Not the root
-    if(path[i]->depth == 0)
-      startindex = 0;                               //The root
-
-    for(int j = startindex; j < path[i]->nneigh; j++)
-      if(path[i]->neigh[j] != path[i-1])
-        path[i]->neigh[j]->diff += path[i]->diff+1; //The node off the path
-
-    path[i]->diff = 0;
-    DB_TRACE(0, "         "); DB_CALL(0, print_node_TIvars(path[i]));
+    int p = path[i];
+    DB_TRACE(0, "current: %i d_lazy: %i diff: %i\n", p, t->d_lazy[p],
+             t->diff[p]);
+    t->d_lazy[p] += t->diff[p] - 1;
+    t->diff[path[i-1]] += t->diff[p];               //Push difference down
+
+    int sibling = t->sibling[path[i-1]];
+    if(sibling >= 0)                                //The node off the path
+      t->diff[sibling] += t->diff[p]+1;
+    else                                            //The nodes off the path
+      for(int j = t->child_start[p]; j < t->child_start[p+1]; j++)
+        if(t->child[j] != path[i-1])
+          t->diff[t->child[j]] += t->diff[p]+1;
+
+    t->diff[p] = 0;
   }
-  DB_TRACE(0, "leaf   : "); DB_CALL(0, print_node(path[0]));
-  DB_TRACE(0, "         "); DB_CALL(0, print_node_TIvars(path[0]));
-  leaf->d_lazy += leaf->diff - 1;
-  leaf->diff = 0;
-  DB_TRACE(0, "         "); DB_CALL(0, print_node_TIvars(path[0]));
+  t->d_lazy[leaf] += t->diff[leaf] - 1;
+  t->diff[leaf] = 0;
+  DB_TRACE(0, "leaf   : %i d_lazy: %i\n", leaf, t->d_lazy[leaf]);
 
     //Follow the path back up to the root, updating the d_min and d_max values
     //for each pair of siblings:
-  update_dminmax_on_path(path, leaf->depth+1);
-  free(path);
+  update_dminmax_on_path(t, path, depth+1);
 }
 
 
 /*
 Reset the d_min, d_max, d_lazy, and diff values for the path from the given
-leaf (from alt_tree) to the root.
+leaf (from the flat alt_tree) to the root.
 */
-void reset_leaf(Node *leaf)
+void reset_leaf(int leaf, FlatTree *t)
 {
-  assert_is_leaf(leaf);
+  assert_is_leaf(t, leaf);
 
-    //Follow the path from the root to the leaf, resetting the values along
-    //the way:
-  Node *n = leaf;
-  while(1)                     //While not the root
+    //Follow the path from the leaf to the root, resetting the values along
+    //the way.  The child on the path was reset just before its parent:
+  int n = leaf, prev = -1;
+  while(1)
   {
-    n->d_lazy = n->subtreesize;
-    n->d_max = n->subtreesize;
-    n->d_min = 1;
-    n->diff = 0;
-    if(n->nneigh != 1)         //not the leaf
-    {
-      for(int i=1; i < n->nneigh; i++)
-        n->neigh[i]->diff = 0; //reset all children (including one on path)
+    t->d_lazy[n] = t->subtreesize[n];
+    t->d_max[n] = t->subtreesize[n];
+    t->d_min[n] = 1;
+    t->d_max_at[n] = n;
+    t->d_min_at[n] = t->first_leaf[n];
+    t->diff[n] = 0;
+    if(prev >= 0 && t->sibling[prev] >= 0)
+      t->diff[t->sibling[prev]] = 0;
+    else
+      for(int j = t->child_start[n]; j < t->child_start[n+1]; j++)
+        t->diff[t->child[j]] = 0;  //reset all children
 
-      if(n->depth == 0)        //the root
-      {
-        n->neigh[0]->diff = 0; //reset the first child
-        return;
-      }
-    }
-    n = n->neigh[0];
+    if(t->parent[n] < 0)         //the root
+      return;
+    prev = n;
+    n = t->parent[n];
   }
 }
 
 /*
-Follow the nodes on the path from a leaf to the root, updating d_min and
-d_max on the way up.
+Update d_min and d_max of node p from the values of its children, in the order
+of their indices: on a tie, the first child gives the node.
 */
-void update_dminmax_on_path(Node** path, int pathlength)
+static inline void update_dminmax_children(FlatTree *t, int p)
 {
-  path[0]->d_min = path[0]->d_lazy;  //The leaf values
-  path[0]->d_max = path[0]->d_lazy;
-  for(int i = 1; i < pathlength; i++)
+  int d_min = t->d_lazy[p], d_min_at = p;
+  int d_max = t->d_lazy[p], d_max_at = p;
+
+  for(int j = t->child_start[p]; j < t->child_start[p+1]; j++)
   {
-    path[i]->d_min = path[i]->d_lazy;
-    path[i]->d_max = path[i]->d_lazy;
-
-      //Check values of the children:
-    int startind = 1;
-    if(path[i]->depth == 0)          //The root
-      startind = 0;                  //Not the root
-    for(int j = startind; j < path[i]->nneigh; j++)
+    int c = t->child[j];
+    if(t->d_min[c] + t->diff[c] < d_min)
     {
-      path[i]->d_min = min(path[i]->d_min,
-                           path[i]->neigh[j]->d_min + path[i]->neigh[j]->diff);
-      path[i]->d_max = max(path[i]->d_max,
-                           path[i]->neigh[j]->d_max + path[i]->neigh[j]->diff);
+      d_min = t->d_min[c] + t->diff[c];
+      d_min_at = t->d_min_at[c];
     }
+    if(t->d_max[c] + t->diff[c] > d_max)
+    {
+      d_max = t->d_max[c] + t->diff[c];
+      d_max_at = t->d_max_at[c];
+    }
+  }
+  t->d_min[p] = d_min;
+  t->d_max[p] = d_max;
+  t->d_min_at[p] = d_min_at;
+  t->d_max_at[p] = d_max_at;
+}
+
+/*
+The same for a node p whose two children are c and its sibling: the values
+are selected without branches, the first child being the one of lower index.
+*/
+static inline void update_dminmax_two_children(FlatTree *t, int p, int c)
+{
+  int s = t->sibling[c];
+  int c1 = c < s ? c : s, c2 = c < s ? s : c;
+  int min1 = t->d_min[c1] + t->diff[c1], min2 = t->d_min[c2] + t->diff[c2];
+  int max1 = t->d_max[c1] + t->diff[c1], max2 = t->d_max[c2] + t->diff[c2];
+  int d_min = t->d_lazy[p], d_min_at = p;
+  int d_max = t->d_lazy[p], d_max_at = p;
+
+  d_min_at = min1 < d_min ? t->d_min_at[c1] : d_min_at;
+  d_min = min1 < d_min ? min1 : d_min;
+  d_min_at = min2 < d_min ? t->d_min_at[c2] : d_min_at;
+  d_min = min2 < d_min ? min2 : d_min;
+  d_max_at = max1 > d_max ? t->d_max_at[c1] : d_max_at;
+  d_max = max1 > d_max ? max1 : d_max;
+  d_max_at = max2 > d_max ? t->d_max_at[c2] : d_max_at;
+  d_max = max2 > d_max ? max2 : d_max;
+
+  t->d_min[p] = d_min;
+  t->d_max[p] = d_max;
+  t->d_min_at[p] = d_min_at;
+  t->d_max_at[p] = d_max_at;
+}
 
-    DB_TRACE(0, "up: dmin %d ", path[i]->d_min);DB_CALL(0, print_node(path[i]));
-    DB_TRACE(0, "up: dmax %d\n", path[i]->d_max);
+/*
+Follow the nodes on the path from a leaf to the root, updating d_min and
+d_max on the way up.  On a binary tree, only the root (of three children if
+the tree is unrooted) goes through the loop over the children.
+*/
+void update_dminmax_on_path(FlatTree *t, const int *path, int pathlength)
+{
+  t->d_min[path[0]] = t->d_lazy[path[0]];  //The leaf values
+  t->d_max[path[0]] = t->d_lazy[path[0]];
+  t->d_min_at[path[0]] = t->d_max_at[path[0]] = path[0];
+  for(int i = 1; i < pathlength; i++)
+  {
+    if(t->sibling[path[i-1]] >= 0)           //Two children
+      update_dminmax_two_children(t, path[i], path[i-1]);
+    else                                     //A polytomy
+      update_dminmax_children(t, path[i]);
+    DB_TRACE(0, "up: %i dmin %d dmax %d\n", path[i], t->d_min[path[i]],
+             t->d_max[path[i]]);
   }
 }
 
 /*
-Die if the given node is not a leaf.
+Die if the given node of the flat tree is not a leaf.
 */
-void assert_is_leaf(Node* leaf)
+void assert_is_leaf(const FlatTree *t, int leaf)
 {
-  if(leaf->nneigh != 1)   //not a leaf
+  if(!flat_is_leaf(t, leaf))
   {
 	  fprintf(stderr, "Error: leaf not given to add_leaf().\n");
 	  Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
@@ -332,25 +663,29 @@ Node** leaf_to_leaf(Node **leaves1, Node **leaves2, int n)
 }
 
 /*
-Compute the edge Transfer Index from the child node transfer index.
+Compute the edge Transfer Index from the child node transfer index, and put it
+in the given array.
 */
-void nodeTI_to_edgeTI(Tree *tree)
+void nodeTI_to_edgeTI(const Tree *ref_tree, const RapidTIContext *ctx,
+                      int *transfer_index)
 {
-  for(int i=0; i < tree->nb_nodes; i++)
-    set_edge_TI(tree->a_nodes[i], tree->nb_taxa);
+  for(int i=0; i < ref_tree->nb_nodes; i++)
+    set_edge_TI(ref_tree->a_nodes[i], ref_tree->nb_taxa, ctx, transfer_index);
 }
 
 /*
 Set the Transfer Index of the edge above this node (in ref_tree).
 
-@warning  assume that ti_min and ti_max are already set.
+@warning  assume that ti_min and ti_max are already set in ctx.
 */
-void set_edge_TI(Node *u, int n)
+void set_edge_TI(const Node *u, int n, const RapidTIContext *ctx,
+                 int *transfer_index)
 {
   if(u->depth != 0)              //Not the root
   {
-    DB_TRACE(0, "min %i max %i ", u->ti_min, n - u->ti_max);
+    DB_TRACE(0, "min %i max %i ", ctx->ti_min[u->id], n - ctx->ti_max[u->id]);
     DB_CALL(0, print_node(u));
-    u->br[0]->transfer_index = min(u->ti_min, n - u->ti_max);
+    transfer_index[u->br[0]->id] = min(ctx->ti_min[u->id],
+                                       n - ctx->ti_max[u->id]);
   }
 }
\ No newline at end of file
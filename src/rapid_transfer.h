@@ -3,8 +3,63 @@
 
 #include "tree.h"
 #include "debug.h"
-
-
+#include "flat_tree.h"
+
+
+/* The part of a rapid Transfer Index computation that changes with the
+alt_tree.  The ref_tree (with its heavy paths and light leaves) is only read,
+so that it can be shared by all the threads, each one having its own context.
+*/
+typedef struct __RapidTIContext {
+  int *ti_min;   // rooted transfer index for each node of ref_tree (by id)
+  int *ti_max;   // max rooted transfer distance for each node of ref_tree
+  int *ti_min_at; // node of the flat alt_tree at which ti_min is found
+  int *ti_max_at; // node of the flat alt_tree at which ti_max is found
+  int *other;    // leaf of alt (below) for each taxon (by taxon_id)
+
+         // The alt_tree and scratch space, so that add_leaf does not allocate:
+  FlatTree *alt;      // compact copy of alt_tree, on which the TI is computed
+  int *path;          // path from a leaf of alt to its root
+  int path_capacity;  // number of indices that fit in path
+
+         // Scratch space of rapid_moved_taxa():
+  Node **ref_stack;   // traversal of a subtree of ref_tree
+  int *in_u;          // in_u[taxon_id] == stamp iff the taxon is in L(u)
+  int *in_v;          // in_v[taxon_id] == stamp iff the taxon is in L(v)
+  int stamp;
+  bool borrowed_alt;  // alt and other belong to another context
+} RapidTIContext;
+
+/* A thread of a computation whose heavy paths are split over several threads
+(see compute_heavy_paths_rapidTI()): the heavy paths are independent, as long
+as each thread updates its own copy of the values of the flat alt_tree.
+The structure of the flat alt_tree is only read from the prepared context.
+*/
+typedef struct __RapidTIWorker {
+  FlatTree alt;       // structure of the prepared alt_tree, with the values below
+  int *d_lazy;        // the values of alt that add_leaf() updates, own copy
+  int *diff;
+  int *d_min;
+  int *d_max;
+  int *d_min_at;
+  int *d_max_at;
+  int *path;          // path from a leaf of alt to its root
+  int capacity;       // number of nodes that fit in the arrays
+} RapidTIWorker;
+
+/* Allocate a context for the rapid Transfer Index computations on ref_tree.
+*/
+RapidTIContext* new_rapidTI_context(const Tree *ref_tree);
+/* Allocate a context for ref_tree that uses the flat alt_tree (and its leaf
+bijection) of owner: an alt_tree prepared once in owner with
+prepare_alt_tree_rapidTI() can then be compared to several reference trees
+having the same taxa.  owner must be freed after the context.
+*/
+RapidTIContext* new_rapidTI_context_sharing(const Tree *ref_tree,
+                                            RapidTIContext *owner);
+/* Free the given context.
+*/
+void free_rapidTI_context(RapidTIContext *ctx);
 
 
 /* Compute the Transfer Index comparing a reference tree to an alternative
@@ -22,47 +77,105 @@ index of its child u.  The symmetric difference of leaf sets is kept implicity
 in the alt_tree.
 
 At the end, transfer_index[i] will have the transfer index for edge i.
+
+ref_tree is not modified, the node values are kept in ctx.
 */
 void compute_transfer_indices_new(Tree *ref_tree, const int n,
                                   const int m, Tree *alt_tree,
-                                  int *transfer_index);
+                                  int *transfer_index, RapidTIContext *ctx);
 
+/* The two halves of compute_transfer_indices_new(): flatten alt_tree in ctx and
+map its leaves, then compute the Transfer Index of ref_tree against the alt_tree
+prepared in ctx (or in the context whose alt_tree ctx shares).  The flat
+alt_tree is back to its prepared state after each computation.
+*/
+void prepare_alt_tree_rapidTI(const Tree *alt_tree, RapidTIContext *ctx);
+void compute_transfer_indices_prepared(Tree *ref_tree, const int n,
+                                       const int m, Tree *alt_tree,
+                                       int *transfer_index,
+                                       RapidTIContext *ctx);
 
-/* Compute the edge Transfer Index from the child node transfer index.
+/* Allocate a worker, and free it.
+*/
+RapidTIWorker* new_rapidTI_worker(void);
+void free_rapidTI_worker(RapidTIWorker *w);
+/* Make w work on the alt_tree prepared in ctx (or in the context whose alt_tree
+ctx shares), by copying its values: O(nodes of alt_tree).  To be called by each
+worker after prepare_alt_tree_rapidTI(), and before the workers compute.
 */
-void nodeTI_to_edgeTI(Tree* ref_tree);
+void bind_rapidTI_worker(RapidTIWorker *w, const RapidTIContext *ctx);
+/* Compute, in ctx, the rooted transfer index of the nodes of the heavy paths
+starting at the leaves first to last-1 of ref_tree, against the alt_tree
+bound to w.  The flat alt_tree of ctx is not modified, and the nodes of two
+heavy paths are different: several workers can compute disjoint ranges of
+leaves on the same ctx at the same time.  Once all the leaves are done,
+nodeTI_to_edgeTI() gives the transfer indices.
+*/
+void compute_heavy_paths_rapidTI(Tree *ref_tree, int first, int last,
+                                 Tree *alt_tree, RapidTIContext *ctx,
+                                 RapidTIWorker *w);
+
+/* Write into ids the taxa (taxon_id) to move to go from the edge above the node
+u of ref_tree to its closest edge in alt_tree, and return their number (the
+transfer index of the edge).  The closest edge is the one found by the last
+compute_transfer_indices_new() call: the taxa are read from the symmetric
+difference of L(u) and L(v), v being the node of alt_tree at the min (or at the
+max, then the taxa are the ones out of the difference).
 
-/* Copy the edge Transfer Index values into the given array.
+The cost is O(|L(u)| + |L(v)|), plus O(n) when the max gives the index.
 */
-void edgeTI_to_array(Tree *tree, int *transfer_index);
+int rapid_moved_taxa(const Node *u, int n, RapidTIContext *ctx, int *ids);
+
+/* Map each taxon to the index of its leaf in the flat alt_tree, in ctx.
+
+@warning  assumes alt_tree was flattened in ctx->alt
+*/
+void set_leaf_bijection_rapidTI(const Tree *alt_tree, RapidTIContext *ctx);
+
+/* Compute the edge Transfer Index from the child node transfer index, and
+put it in the given array.
+*/
+void nodeTI_to_edgeTI(const Tree *ref_tree, const RapidTIContext *ctx,
+                      int *transfer_index);
 
 /* Follow a leaf in ref_tree up to the root.  Call add_leaf on the leaves in the
 subtrees off the path.
 */
-void add_heavy_path(Node* u, Tree* alt_tree);
+void add_heavy_path(Node* u, Tree* alt_tree, RapidTIContext *ctx);
 /* Follow a leaf in ref_tree up to the root. Call reset_leaf on the leaves in
 the subtrees off the path.
 */
-void reset_heavy_path(Node* u);
+void reset_heavy_path(Node* u, const RapidTIContext *ctx);
+
+/* Make sure that the scratch space of ctx is large enough for alt_tree.
+*/
+void reserve_rapidTI_context(RapidTIContext *ctx, const Tree *alt_tree);
 
-/* Add the given leaf (from alt_tree) to the set L(v) for all v on a path from
-leaf to the root.
+/* Add the given leaf (from the flat alt_tree) to the set L(v) for all v on a
+path from leaf to the root.  The path is built in the scratch space of ctx.
 */
-void add_leaf(Node *leaf);
+void add_leaf(int leaf, RapidTIContext *ctx);
 /* Reset the d_min, d_max, d_lazy, and diff values for the path from the given
-leaf (from alt_tree) to the root.
+leaf (from the flat alt_tree) to the root.
 */
-void reset_leaf(Node *leaf);
+void reset_leaf(int leaf, FlatTree *t);
 
 /* Follow the nodes on the path, updating d_min and d_max on the way up.
 */
-void update_dminmax_on_path(Node** path, int pathlength);
+void update_dminmax_on_path(FlatTree *t, const int *path, int pathlength);
+
 
 
+/* Print a node of ref_tree with its transfer index values from ctx.
+*/
+void print_node_TI(const Node* n, const RapidTIContext *ctx);
+/* Print the nodes from the given Node* array (with the transfer index).
+*/
+void print_nodes_TI(Node **nodes, const int n, const RapidTIContext *ctx);
 
-/* Die if the given node is not a leaf.
+/* Die if the given node of the flat tree is not a leaf.
 */
-void assert_is_leaf(Node* leaf);
+void assert_is_leaf(const FlatTree *t, int leaf);
 
 /* Return the minimum of two integers.
 */
@@ -98,8 +211,9 @@ Node** leaf_to_leaf(Node **leaves1, Node **leaves2, int n);
 
 /* Set the Transfer Index of the edge above this node (in ref_tree).
 
-@warning  assume that ti_min and ti_max are already set.
+@warning  assume that ti_min and ti_max are already set in ctx.
 */
-void set_edge_TI(Node *u, int n);
+void set_edge_TI(const Node *u, int n, const RapidTIContext *ctx,
+                 int *transfer_index);
 
 #endif
\ No newline at end of file
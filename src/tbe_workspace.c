@@ -0,0 +1,224 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "tbe_workspace.h"
+#include "hamming_simd.h"
+#include <limits.h>
+#include <string.h>
+
+#define TBE_CACHE_LINE 64
+
+
+static void* aligned_block(size_t size) {
+	void* block = NULL;
+	if (size == 0) size = TBE_CACHE_LINE;
+	if (posix_memalign(&block, TBE_CACHE_LINE, size) != 0) {
+		fprintf(stderr,"Fatal error : cannot allocate the %lu bytes of the TBE matrices! Aborting.\n", (unsigned long) size);
+		Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+	}
+	memset(block, 0, size); /* the padding cells are then never uninitialized */
+	return block;
+}
+
+
+/* (re)allocates the cells of the given size, for nb_rows rows */
+static void alloc_cells(TBEWorkspace* ws, int cell_size, int nb_rows) {
+	const int per_line = TBE_CACHE_LINE / cell_size;
+	int i;
+	free(ws->card); free(ws->cell_min); free(ws->cell_min_edge);
+	free(ws->c_block); free(ws->i_block);
+	ws->cell_size = cell_size;
+	ws->stride = (ws->nb_edges_ref + per_line - 1) / per_line * per_line;
+	ws->nb_rows = nb_rows;
+	ws->card = aligned_block((size_t) ws->stride * cell_size);
+	ws->cell_min = aligned_block((size_t) ws->stride * cell_size);
+	ws->cell_min_edge = aligned_block((size_t) ws->stride * cell_size);
+	ws->c_block = aligned_block((size_t) ws->nb_rows * ws->stride * cell_size);
+	ws->i_block = aligned_block((size_t) ws->nb_rows * ws->stride * cell_size);
+	for (i = 0; i < ws->nb_edges_ref; i++) {
+		if (cell_size == 2) ((unsigned short*) ws->card)[i] = ws->ref_card[i];
+		else ((unsigned int*) ws->card)[i] = ws->ref_card[i];
+	}
+}
+
+
+/* 16 bits cells hold the distances (at most nb_taxa) and the edge ids of the bootstrap tree */
+static int needed_cell_size(int nb_taxa, int nb_edges_boot) {
+	return (nb_taxa > USHRT_MAX || nb_edges_boot > USHRT_MAX) ? 4 : 2;
+}
+
+
+TBEWorkspace* new_tbe_workspace(Tree* ref_tree, int nb_edges_boot) {
+	int i;
+	TBEWorkspace* ws = (TBEWorkspace*) malloc(sizeof(TBEWorkspace));
+	ws->nb_taxa = ref_tree->nb_taxa;
+	ws->nb_edges_ref = ref_tree->nb_edges;
+	ws->ref_card = (int*) malloc(ws->nb_edges_ref * sizeof(int));
+	for (i = 0; i < ws->nb_edges_ref; i++) ws->ref_card[i] = ref_tree->a_edges[i]->hashtbl[1]->num_items;
+	ws->min_dist = (int*) malloc(ws->nb_edges_ref * sizeof(int));
+	ws->min_dist_edge = (int*) malloc(ws->nb_edges_ref * sizeof(int));
+
+	ws->ref_leaf = (Node**) calloc(ws->nb_taxa, sizeof(Node*));
+	for (i = 0; i < ref_tree->nb_nodes; i++)
+		if (ref_tree->a_nodes[i]->nneigh == 1) ws->ref_leaf[ref_tree->a_nodes[i]->taxon_id] = ref_tree->a_nodes[i];
+	ws->moved_species = (int*) malloc(ws->nb_taxa * sizeof(int));
+
+	ws->card = ws->cell_min = ws->cell_min_edge = ws->c_block = ws->i_block = NULL;
+	alloc_cells(ws, needed_cell_size(ws->nb_taxa, nb_edges_boot), nb_edges_boot);
+	return ws;
+}
+
+
+void free_tbe_workspace(TBEWorkspace* ws) {
+	free(ws->c_block); free(ws->i_block);
+	free(ws->card); free(ws->cell_min); free(ws->cell_min_edge);
+	free(ws->ref_card); free(ws->ref_leaf);
+	free(ws->min_dist); free(ws->min_dist_edge);
+	free(ws->moved_species);
+	free(ws);
+}
+
+
+void reserve_tbe_workspace(TBEWorkspace* ws, int nb_edges_boot) {
+	int cell_size = needed_cell_size(ws->nb_taxa, nb_edges_boot);
+	if (nb_edges_boot <= ws->nb_rows && cell_size <= ws->cell_size) return;
+	alloc_cells(ws, cell_size > ws->cell_size ? cell_size : ws->cell_size,
+		    nb_edges_boot > ws->nb_rows ? nb_edges_boot : ws->nb_rows);
+}
+
+
+void reset_tbe_workspace(TBEWorkspace* ws) {
+	int i;
+	for (i = 0; i < ws->nb_edges_ref; i++) { /* initialization to the nb of taxa */
+		if (ws->cell_size == 2) ((unsigned short*) ws->cell_min)[i] = ws->nb_taxa;
+		else ((unsigned int*) ws->cell_min)[i] = ws->nb_taxa;
+	}
+	memset(ws->moved_species, 0, ws->nb_taxa * sizeof(int));
+}
+
+
+/* the cells of a row, whatever their size */
+static inline void* c_row(TBEWorkspace* ws, int boot_edge) { return (char*) ws->c_block + (size_t) boot_edge * ws->stride * ws->cell_size; }
+static inline void* i_row(TBEWorkspace* ws, int boot_edge) { return (char*) ws->i_block + (size_t) boot_edge * ws->stride * ws->cell_size; }
+
+static inline void set_cell(TBEWorkspace* ws, void* row, int i, unsigned int value) {
+	if (ws->cell_size == 2) ((unsigned short*) row)[i] = value;
+	else ((unsigned int*) row)[i] = value;
+}
+
+static void fill_row(TBEWorkspace* ws, void* row, unsigned int value) {
+	int i;
+	if (ws->cell_size == 2) for (i = 0; i < ws->stride; i++) ((unsigned short*) row)[i] = value;
+	else for (i = 0; i < ws->stride; i++) ((unsigned int*) row)[i] = value;
+}
+
+
+/* first part of the Brehelin/Gascuel/Martin algorithm: the rows of the terminal edges of the bootstrap tree.
+   The taxon of such an edge is in the cluster of an edge of the reference tree iff this edge is on the path
+   from the leaf of the taxon to the root of the reference tree. */
+static void fill_terminal_rows(TBEWorkspace* ws, Tree* ref_tree, Tree* boot_tree) {
+	int j;
+	for (j = 0; j < boot_tree->nb_edges; j++) {
+		Node* leaf = boot_tree->a_edges[j]->right;
+		if (leaf->nneigh != 1) continue;
+		if (leaf->taxon_id < 0 || leaf->taxon_id >= ws->nb_taxa || ws->ref_leaf[leaf->taxon_id] == NULL) {
+			fprintf(stderr,"Fatal error : taxon %s not found!\n", leaf->name);
+			Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+		}
+		void* ir = i_row(ws, j);
+		void* cr = c_row(ws, j);
+		fill_row(ws, ir, 0);
+		fill_row(ws, cr, 1);
+		Node* u;
+		for (u = ws->ref_leaf[leaf->taxon_id]; u != ref_tree->node0; u = u->neigh[0]) {
+			assert(u->br[0]->right == u); /* the descendant should always be the right side of the edge */
+			set_cell(ws, ir, u->br[0]->id, 1);
+			set_cell(ws, cr, u->br[0]->id, 0);
+		}
+	}
+}
+
+
+static inline void add_rows(TBEWorkspace* ws, void* dst, const void* src) {
+	if (ws->cell_size == 2) hamming_add_rows((unsigned short*) dst, (const unsigned short*) src, ws->stride);
+	else hamming_add_rows32((unsigned int*) dst, (const unsigned int*) src, ws->stride);
+}
+
+static inline void min_row(TBEWorkspace* ws, int edge_id) {
+	if (ws->cell_size == 2)
+		hamming_min_row((const unsigned short*) ws->card, (const unsigned short*) c_row(ws, edge_id),
+				(const unsigned short*) i_row(ws, edge_id), ws->nb_taxa, edge_id,
+				(unsigned short*) ws->cell_min, (unsigned short*) ws->cell_min_edge, ws->stride);
+	else
+		hamming_min_row32((const unsigned int*) ws->card, (const unsigned int*) c_row(ws, edge_id),
+				  (const unsigned int*) i_row(ws, edge_id), ws->nb_taxa, edge_id,
+				  (unsigned int*) ws->cell_min, (unsigned int*) ws->cell_min_edge, ws->stride);
+}
+
+
+/* second part: post-order traversal of the bootstrap tree, each row being the sum of the rows of the
+   edges below it, and the min distances being updated from each row. This is its step on target, whose
+   edge to orig is the one of the row: the rows of the edges below are already complete */
+static void post_order_boot_step(TBEWorkspace* ws, Node* orig, Node* target) {
+	int j, dir, target_to_orig = dir_a_to_b(target, orig);
+	int edge_id = target->br[target_to_orig]->id;
+
+	if (target->nneigh != 1) {
+		/* the row of a terminal edge is already filled */
+		memset(i_row(ws, edge_id), 0, (size_t) ws->stride * ws->cell_size);
+		memset(c_row(ws, edge_id), 0, (size_t) ws->stride * ws->cell_size);
+		for (j = 1; j < target->nneigh; j++) {
+			dir = (target_to_orig + j) % target->nneigh;
+			add_rows(ws, i_row(ws, edge_id), i_row(ws, target->br[dir]->id));
+			add_rows(ws, c_row(ws, edge_id), c_row(ws, target->br[dir]->id));
+		}
+	}
+	min_row(ws, edge_id);
+}
+
+
+void tbe_min_distances(TBEWorkspace* ws, Tree* ref_tree, Tree* boot_tree) {
+	int i;
+	Node** order = get_post_order(boot_tree); /* computed when the tree was parsed */
+	reserve_tbe_workspace(ws, boot_tree->nb_edges);
+	reset_tbe_workspace(ws);
+	fill_terminal_rows(ws, ref_tree, boot_tree);
+	for (i = 0; i < boot_tree->nb_nodes; i++)
+		if (boot_tree->post_order_from[i] != NULL) /* not the pseudoroot */
+			post_order_boot_step(ws, boot_tree->post_order_from[i], order[i]);
+
+	for (i = 0; i < ref_tree->nb_edges; i++) {
+		if (ws->cell_size == 2) {
+			ws->min_dist[i] = ((unsigned short*) ws->cell_min)[i];
+			ws->min_dist_edge[i] = ((unsigned short*) ws->cell_min_edge)[i];
+		} else {
+			ws->min_dist[i] = ((unsigned int*) ws->cell_min)[i];
+			ws->min_dist_edge[i] = ((unsigned int*) ws->cell_min_edge)[i];
+		}
+		assert(ws->min_dist[i] <= ws->nb_taxa / 2);
+		if (ref_tree->a_edges[i]->right->nneigh == 1)
+			assert(ws->min_dist[i] == 0); /* any terminal edge should have an exact match in any bootstrap tree */
+	}
+}
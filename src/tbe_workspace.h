@@ -0,0 +1,74 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef _TBE_WORKSPACE_H_
+#define _TBE_WORKSPACE_H_
+
+#include "tree.h"
+
+/* per thread scratch space of the classic (Brehelin/Gascuel/Martin) transfer index computation.
+
+   The I matrix (cardinals of intersections) and the C matrix (cardinals of complements) have one row per edge
+   of the bootstrap tree and one column per edge of the reference tree: the post-order traversal of the
+   bootstrap tree then only adds whole rows, and updates the min distances of all the edges of the reference
+   tree from a row at once (see hamming_simd.h). Each matrix is one contiguous block, whose rows are padded to
+   a multiple of the size of a cache line and aligned on it.
+   The cells are 16 bits wide, or 32 bits wide when the number of taxa or of edges does not fit in 16 bits.
+   It is allocated once per thread and reused for all the bootstrap trees. */
+typedef struct __TBEWorkspace {
+	int nb_taxa;
+	int nb_edges_ref;		/* number of meaningful columns */
+	int cell_size;			/* 2 or 4 bytes */
+	int stride;			/* number of columns of a padded row */
+	int nb_rows;			/* number of rows (edges of a bootstrap tree) the blocks can hold */
+	void* c_block;			/* nb_rows * stride cells */
+	void* i_block;
+	void* card;			/* card[i]: number of taxa in the cluster of the edge i of the reference tree */
+	void* cell_min;			/* the min distances and their edges while a bootstrap tree is traversed */
+	void* cell_min_edge;
+	int* ref_card;			/* card, as ints */
+	Node** ref_leaf;		/* ref_leaf[taxon_id]: leaf of the reference tree of this taxon */
+	int* min_dist;			/* min Hamming (transfer) distance of each edge of the reference tree */
+	int* min_dist_edge;		/* edge of the bootstrap tree at this min distance */
+	int* moved_species;		/* number of close branches around which each taxon moves, in one bootstrap tree */
+} TBEWorkspace;
+
+/* the reference tree must have its id hashtables */
+TBEWorkspace* new_tbe_workspace(Tree* ref_tree, int nb_edges_boot);
+void free_tbe_workspace(TBEWorkspace* ws);
+
+/* makes the blocks hold at least nb_edges_boot rows (the content is lost if they have to grow, or to widen
+   because nb_edges_boot does not fit in 16 bits) */
+void reserve_tbe_workspace(TBEWorkspace* ws, int nb_edges_boot);
+
+/* prepares the workspace for a new bootstrap tree: the min distances to nb_taxa, moved_species to 0.
+   By construction of the post-order traversals, the matrices need not be reset. */
+void reset_tbe_workspace(TBEWorkspace* ws);
+
+/* resets the workspace and computes into ws->min_dist and ws->min_dist_edge, for all the edges of ref_tree,
+   the min transfer distance to an edge of boot_tree and this edge */
+void tbe_min_distances(TBEWorkspace* ws, Tree* ref_tree, Tree* boot_tree);
+
+#endif /* _TBE_WORKSPACE_H_ */
@@ -0,0 +1,195 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#include "topo_dedup.h"
+
+#include <string.h>
+
+struct __TopoCacheEntry {
+	TopoKey key;
+	int nb;
+	int* values;
+};
+
+
+TopoWorkspace* new_topo_workspace(int capacity) {
+	TopoWorkspace* ws = (TopoWorkspace*) malloc(sizeof(TopoWorkspace));
+	ws->capacity = capacity;
+	ws->stack_node = (Node**) malloc(capacity * sizeof(Node*));
+	ws->stack_parent = (int*) malloc(capacity * sizeof(int));
+	ws->order = (Node**) malloc(capacity * sizeof(Node*));
+	ws->parent_pos = (int*) malloc(capacity * sizeof(int));
+	ws->h1 = (unsigned long long*) malloc(capacity * sizeof(unsigned long long));
+	ws->h2 = (unsigned long long*) malloc(capacity * sizeof(unsigned long long));
+	return ws;
+}
+
+
+void free_topo_workspace(TopoWorkspace* ws) {
+	free(ws->stack_node); free(ws->stack_parent);
+	free(ws->order); free(ws->parent_pos);
+	free(ws->h1); free(ws->h2);
+	free(ws);
+}
+
+
+static void reserve_topo_workspace(TopoWorkspace* ws, int capacity) {
+	if (capacity <= ws->capacity) return;
+	TopoWorkspace* bigger = new_topo_workspace(capacity);
+	TopoWorkspace tmp = *ws;
+	*ws = *bigger;
+	*bigger = tmp;
+	free_topo_workspace(bigger); /* which now holds the old arrays */
+}
+
+
+/* splitmix64: the random keys of the taxa are derived from their ids, the same in all the trees */
+static inline unsigned long long mix64(unsigned long long x) {
+	x += 0x9E3779B97F4A7C15ULL;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	return x ^ (x >> 31);
+}
+
+
+TopoKey tree_topology_key(Tree* tree, TopoWorkspace* ws) {
+	TopoKey key = { 0, 0, tree->nb_edges };
+	Node* start = NULL;
+	int i, k, top = 0, nb = 0;
+
+	for (i = 0; i < tree->nb_nodes; i++)
+		if (tree->a_nodes[i]->nneigh == 1 && tree->a_nodes[i]->taxon_id == 0) { start = tree->a_nodes[i]; break; }
+	if (start == NULL) {
+		fprintf(stderr,"Fatal error : the first taxon of the reference tree is not found in a bootstrap tree! Aborting.\n");
+		Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+	}
+
+	reserve_topo_workspace(ws, tree->nb_nodes);
+	ws->stack_node[top] = start; ws->stack_parent[top] = -1; top++;
+	while (top) {
+		top--;
+		Node* u = ws->stack_node[top];
+		int pos = nb++;
+		ws->order[pos] = u;
+		ws->parent_pos[pos] = ws->stack_parent[top];
+		Node* parent = (pos == 0 ? NULL : ws->order[ws->parent_pos[pos]]);
+		for (i = 0; i < u->nneigh; i++) {
+			if (u->neigh[i] == parent) continue;
+			ws->stack_node[top] = u->neigh[i]; ws->stack_parent[top] = pos; top++;
+		}
+	}
+
+	for (k = 1; k < nb; k++) ws->h1[k] = ws->h2[k] = 0;
+	for (k = nb - 1; k > 0; k--) { /* children before their parent */
+		Node* u = ws->order[k];
+		if (u->nneigh == 1) {
+			if (u->taxon_id < 0) {
+				fprintf(stderr,"Fatal error : taxon %s not found! Aborting.\n", u->name);
+				Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+			}
+			ws->h1[k] = mix64(2 * (unsigned long long) u->taxon_id);
+			ws->h2[k] = mix64(2 * (unsigned long long) u->taxon_id + 1);
+		} else {
+			/* the clade of the edge to the parent of u (the ones of the leaves are in all the trees) */
+			key.h1 += mix64(ws->h1[k]);
+			key.h2 += mix64(ws->h2[k] ^ 0x5851F42D4C957F2DULL);
+		}
+		int p = ws->parent_pos[k];
+		if (p > 0) {
+			ws->h1[p] += ws->h1[k];
+			ws->h2[p] += ws->h2[k];
+		}
+	}
+	return key;
+}
+
+
+TopoCache* new_topo_cache() {
+	TopoCache* cache = (TopoCache*) calloc(1, sizeof(TopoCache));
+	cache->table_size = 64;
+	cache->table = (TopoCacheEntry**) calloc(cache->table_size, sizeof(TopoCacheEntry*));
+	return cache;
+}
+
+
+void free_topo_cache(TopoCache* cache) {
+	int i;
+	for (i = 0; i < cache->table_size; i++)
+		if (cache->table[i] != NULL) {
+			free(cache->table[i]->values);
+			free(cache->table[i]);
+		}
+	free(cache->table);
+	free(cache);
+}
+
+
+static inline int same_topo_key(TopoKey a, TopoKey b) {
+	return a.h1 == b.h1 && a.h2 == b.h2 && a.nb_edges == b.nb_edges;
+}
+
+/* the slot of key in the table, or the empty slot where it goes */
+static int topo_cache_slot(TopoCacheEntry** table, int table_size, TopoKey key) {
+	int slot = (int) (key.h1 & (table_size - 1));
+	while (table[slot] != NULL && !same_topo_key(table[slot]->key, key)) slot = (slot + 1) & (table_size - 1);
+	return slot;
+}
+
+
+const int* topo_cache_get(TopoCache* cache, TopoKey key, int* nb) {
+	TopoCacheEntry* entry = cache->table[topo_cache_slot(cache->table, cache->table_size, key)];
+	cache->nb_lookups++;
+	if (entry == NULL) return NULL;
+	cache->nb_hits++;
+	*nb = entry->nb;
+	return entry->values; /* never modified once in the table */
+}
+
+
+void topo_cache_put(TopoCache* cache, TopoKey key, const int* values, int nb) {
+	int i;
+	int slot = topo_cache_slot(cache->table, cache->table_size, key);
+	/* another thread may have computed the same topology meanwhile */
+	if (cache->table[slot] == NULL && cache->bytes + (long) nb * sizeof(int) <= TOPO_CACHE_MAX_BYTES) {
+		TopoCacheEntry* entry = (TopoCacheEntry*) malloc(sizeof(TopoCacheEntry));
+		entry->key = key;
+		entry->nb = nb;
+		entry->values = (int*) malloc(nb * sizeof(int));
+		memcpy(entry->values, values, nb * sizeof(int));
+		cache->table[slot] = entry;
+		cache->bytes += (long) nb * sizeof(int);
+		cache->nb_entries++;
+		if (2 * cache->nb_entries > cache->table_size) {
+			int new_size = 2 * cache->table_size;
+			TopoCacheEntry** bigger = (TopoCacheEntry**) calloc(new_size, sizeof(TopoCacheEntry*));
+			for (i = 0; i < cache->table_size; i++)
+				if (cache->table[i] != NULL)
+					bigger[topo_cache_slot(bigger, new_size, cache->table[i]->key)] = cache->table[i];
+			free(cache->table);
+			cache->table = bigger;
+			cache->table_size = new_size;
+		}
+	}
+}
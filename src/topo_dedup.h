@@ -0,0 +1,90 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+#ifndef _TOPO_DEDUP_H_
+#define _TOPO_DEDUP_H_
+
+#include "tree.h"
+
+/* Deduplication of the bootstrap trees by topology (--dedup).
+
+   The key of a topology is a hash of the set of its clades: the tree is traversed from the leaf of taxon 0,
+   each edge is given by its clade on the side away from that leaf (the bipartitions of an unrooted tree), and
+   the hash of a clade is the sum of random keys of its taxa. The clade hashes are then mixed and summed, which
+   does not depend on the order of the children nor on the names of the nodes. Two 64 bits hashes with
+   independent taxa keys are used: a collision of both is not a concern. The number of edges is also part of the
+   key: a tree rooted on an edge (a root of degree 2) is not merged with its unrooted version.
+
+   The results computed on a topology (the transfer indices, or the found edges) are kept in a cache shared by
+   the threads, and added again for each next tree of the same topology instead of being recomputed. The cache
+   is not thread safe: its callers serialize the calls to topo_cache_get() and topo_cache_put(). */
+
+/* the cache keeps the results of the topologies until it holds that many bytes, and then only looks them up */
+#define TOPO_CACHE_MAX_BYTES (512L * 1024 * 1024)
+
+typedef struct __TopoKey {
+	unsigned long long h1, h2;
+	int nb_edges;
+} TopoKey;
+
+/* per thread scratch space for the traversals, grown to the number of nodes of the trees */
+typedef struct __TopoWorkspace {
+	int capacity;
+	Node** stack_node;
+	int* stack_parent;	/* position in order of the parent of the node */
+	Node** order;		/* the nodes in the order of the traversal (pre-order) */
+	int* parent_pos;
+	unsigned long long* h1;	/* hashes of the clades of the nodes of order */
+	unsigned long long* h2;
+} TopoWorkspace;
+
+typedef struct __TopoCacheEntry TopoCacheEntry;
+
+typedef struct __TopoCache {
+	int table_size;		/* a power of 2, at least twice the number of entries */
+	int nb_entries;
+	TopoCacheEntry** table;
+	long bytes;		/* held by the values of the entries */
+	long nb_hits;		/* number of lookups that found their topology */
+	long nb_lookups;
+} TopoCache;
+
+TopoWorkspace* new_topo_workspace(int capacity);
+void free_topo_workspace(TopoWorkspace* ws);
+
+/* the key of the topology of tree, whose leaves must all have a taxon id */
+TopoKey tree_topology_key(Tree* tree, TopoWorkspace* ws);
+
+TopoCache* new_topo_cache();
+void free_topo_cache(TopoCache* cache);
+
+/* returns the nb values kept for the topology of key (the cache keeps them until it is freed), or NULL if it
+   has none */
+const int* topo_cache_get(TopoCache* cache, TopoKey key, int* nb);
+/* keeps a copy of the nb values computed for the topology of key, if the cache has room for them and does not
+   have them yet */
+void topo_cache_put(TopoCache* cache, TopoKey key, const int* values, int nb);
+
+#endif /* _TOPO_DEDUP_H_ */
@@ -24,9 +24,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 */
 
 #include "tree.h"
-#include "externs.h"
 
-int ntax;		/* this global var is set here, in parse_nh */
 
 /* UTILS/DEBUG: counting specific branches or nodes in the tree */
 
@@ -225,7 +223,8 @@ void parse_double(char* in_str, int begin, int end, double* location) {
 	  return;
 	}
 	char numerical_string[52] = { '\0' };
-	strncpy(numerical_string, in_str+begin, end-begin+1);
+	/* the range may contain trailing whitespaces when the string comes unmodified from the file */
+	strncpy(numerical_string, in_str+begin, (end-begin+1 > 51 ? 51 : end-begin+1));
 	int n_matches = sscanf(numerical_string, "%lg", location);
 	if (n_matches != 1) {
 	  fprintf(stderr,"Fatal error in parse_double: unable to parse a number out of \"%s\". Aborting.\n", numerical_string);
@@ -245,6 +244,7 @@ Node* new_node(const char* name, Tree* t, int degree) {
 	nn->neigh = malloc(degree * sizeof(Node*));
 	nn->br = malloc(degree * sizeof(Edge*));
 	nn->id = t->next_avail_node_id++;
+	nn->taxon_id = -1;
 	if(degree==1 && !name) { fprintf(stderr,"Fatal error : won't create a leaf with no name. Aborting.\n"); Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);}
 	if(name) { nn->name = strdup(name); } else nn->name = NULL;
 	if(degree==1) { t->taxa_names[t->next_avail_taxon_id++] = strdup(name); }
@@ -274,6 +274,7 @@ Tree* new_tree(int nb_taxa, const char* name) {
 	   tree with finally one leaf with no name */
 	if (nb_taxa <= 0) return NULL; /* at least one node, that is node0 */
 	Tree* t = (Tree*) malloc(sizeof(Tree));
+	t->arena = NULL;
 	t->taxa_names = (char**) calloc(nb_taxa, sizeof(char*)); /* store only once the taxa names */
 	t->next_avail_node_id = t->next_avail_edge_id = t->next_avail_taxon_id = t->nb_nodes = t->nb_edges = 0;
 	t->nb_taxa = nb_taxa; /* here we don't put the actual number of taxa, but the value to be reached by growing the tree */
@@ -285,57 +286,16 @@ Tree* new_tree(int nb_taxa, const char* name) {
 	t->node0 = new_node(name, t, 1);	/* this first node _is_ a leaf */
 
 	t->taxname_lookup_table = NULL;
+	t->post_order = t->post_order_from = NULL;
 	return t;
 }
 
-/*
-Replicate only the parts of the given tree important to the computation of
-the rapid Transfer Index (don't copy things like hashtables).
-*/
-Tree* copy_tree_rapidTI(Tree* oldt) {
-  Tree* newt = (Tree*) malloc(sizeof(Tree));
-
-    //Initialize unused stuff:
-  newt->taxa_names = NULL;
-  newt->taxname_lookup_table = NULL;
-  newt->next_avail_node_id = newt->next_avail_edge_id = newt->length_hashtables
-                           = newt->next_avail_taxon_id = 0;
-
-    //Initialize used stuff:
-  newt->nb_taxa = oldt->nb_taxa;
-  newt->a_nodes = (Node**) calloc(2*newt->nb_taxa-1, sizeof(Node*));
-  newt->nb_nodes = oldt->nb_nodes;
-  newt->a_edges = (Edge**) calloc(2*newt->nb_taxa-2, sizeof(Edge*));
-  newt->nb_edges = oldt->nb_edges;
-
-    //Copy basic root variables:
-  newt->node0 = copy_node_rapidTI(oldt->node0);
-  newt->a_nodes[newt->node0->id] = newt->node0;
-
-    //Copy all the nodes (and structure) of the tree:
-  copy_tree_rapidTI_rec(newt, oldt->node0, newt->node0);
-
-  //for(int i=0; i < newt->nb_nodes; i++)
-  //  fprintf(stderr, "node: %p\n", (void*)newt->a_nodes[i]);
-  //  //print_node(newt->a_nodes[i]);
-
-  newt->leaves = allocateLA(oldt->leaves->n);
-  for(int i=0; i < oldt->leaves->i; i++)
-  {
-    addLeafLA(newt->leaves, newt->a_nodes[oldt->leaves->a[i]->id]);
-    assert(newt->leaves->a[i]->id == oldt->leaves->a[i]->id &&
-           newt->leaves->a[i]->nneigh == 1);
-  }
-
-  return newt;
-}
-
 /*
 Copy the children of the old Node to the new Node.
 
 @warning  assumes newn is already innitialized with copy_node_rapidTI()
 */
-Tree* copy_tree_rapidTI_rec(Tree* newt, Node* oldn, Node* newn) {
+static void copy_children_rapidTI(Tree* newt, Node* oldn, Node* newn) {
   int start = 1;
   if(oldn->depth == 0)  //root
     start = 0;
@@ -351,13 +311,22 @@ Tree* copy_tree_rapidTI_rec(Tree* newt, Node* oldn, Node* newn) {
     newt->a_edges[newedge->id] = newedge;
     newn->br[i] = newedge;
     newn->neigh[i]->br[0] = newedge;
-    copy_tree_rapidTI_rec(newt, oldn->neigh[i], newn->neigh[i]);
 
     if(oldn->heavychild == oldn->neigh[i])
       newn->heavychild = newn->neigh[i];
   }
+}
+
+/*
+Set the lightleaves of the new Node.
+
+@warning  assumes the subtree of newn is completely copied
+*/
+static void copy_lightleaves_rapidTI(Node* newn) {
+  int start = 1;
+  if(newn->depth == 0)  //root
+    start = 0;
 
-    //Set lightleaves for newn:
   if(newn->nneigh == 1)    //A leaf
   {
     newn->lightleaves = allocateLA(1);
@@ -375,6 +344,55 @@ Tree* copy_tree_rapidTI_rec(Tree* newt, Node* oldn, Node* newn) {
   }
 }
 
+/*
+Replicate only the parts of the given tree important to the computation of
+the rapid Transfer Index (don't copy things like hashtables).
+*/
+Tree* copy_tree_rapidTI(Tree* oldt) {
+  Tree* newt = (Tree*) malloc(sizeof(Tree));
+  newt->arena = NULL;
+
+    //Initialize unused stuff:
+  newt->taxa_names = NULL;
+  newt->taxname_lookup_table = NULL;
+  newt->post_order = newt->post_order_from = NULL;
+  newt->next_avail_node_id = newt->next_avail_edge_id = newt->length_hashtables
+                           = newt->next_avail_taxon_id = 0;
+
+    //Initialize used stuff:
+  newt->nb_taxa = oldt->nb_taxa;
+  newt->a_nodes = (Node**) calloc(2*newt->nb_taxa-1, sizeof(Node*));
+  newt->nb_nodes = oldt->nb_nodes;
+  newt->a_edges = (Edge**) calloc(2*newt->nb_taxa-2, sizeof(Edge*));
+  newt->nb_edges = oldt->nb_edges;
+
+    //Copy basic root variables:
+  newt->node0 = copy_node_rapidTI(oldt->node0);
+  newt->a_nodes[newt->node0->id] = newt->node0;
+
+    //Copy all the nodes (and structure) of the tree, parents before children
+    //(the reversed post-order), then the light leaves of the complete subtrees:
+  Node **order = get_post_order(oldt);
+  for(int j = oldt->nb_nodes-1; j >= 0; j--)
+    copy_children_rapidTI(newt, order[j], newt->a_nodes[order[j]->id]);
+  for(int j = 0; j < oldt->nb_nodes; j++)
+    copy_lightleaves_rapidTI(newt->a_nodes[order[j]->id]);
+
+  //for(int i=0; i < newt->nb_nodes; i++)
+  //  fprintf(stderr, "node: %p\n", (void*)newt->a_nodes[i]);
+  //  //print_node(newt->a_nodes[i]);
+
+  newt->leaves = allocateLA(oldt->leaves->n);
+  for(int i=0; i < oldt->leaves->i; i++)
+  {
+    addLeafLA(newt->leaves, newt->a_nodes[oldt->leaves->a[i]->id]);
+    assert(newt->leaves->a[i]->id == oldt->leaves->a[i]->id &&
+           newt->leaves->a[i]->nneigh == 1);
+  }
+
+  return newt;
+}
+
 /*
 Copy the Edge data essential to the rapid Transfer Index calculations.
 */
@@ -384,7 +402,6 @@ Edge* copy_edge_rapidTI(Edge *old, Node *parent, Node *child) {
   new->id = old->id;
   new->left = parent;
   new->right = child;
-  new->transfer_index = old->transfer_index;
   new->brlen = old->brlen;                           //Unused
   new->branch_support = old->branch_support;         //Unused
   new->subtype_counts[0] = old->subtype_counts[0];   //Unused
@@ -408,6 +425,7 @@ Node* copy_node_rapidTI(Node* old) {
   if(old->name) new->name = strdup(old->name); else new->name = NULL;
   new->comment = NULL;          //Ignore this
   new->id = old->id;
+  new->taxon_id = old->taxon_id;
   new->nneigh = degree;
   new->neigh = malloc(degree * sizeof(Node*));
   new->br = malloc(degree * sizeof(Edge*));
@@ -418,10 +436,8 @@ Node* copy_node_rapidTI(Node* old) {
   new->diff = old->diff;
   new->d_min = old->d_min;
   new->d_max = old->d_max;
-  new->ti_min = old->ti_min;
-  new->ti_max = old->ti_max;
   new->lightleaves = NULL;     //Fill once leaves exist
-  new->heavychild = NULL;      //Set this in copy_tree_rapidTI_rec
+  new->heavychild = NULL;      //Set this in copy_children_rapidTI
   new->other = NULL;           //To be set with set_leaf_bijection()
 
   return new;
@@ -437,6 +453,7 @@ Node* graft_new_node_on_branch(Edge* target_edge, Tree* tree, double ratio_from_
 	  fprintf(stderr,"Error : got a NULL tree pointer. Aborting.\n");
 	  Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
 	}
+	invalidate_post_order(tree);
 
 	if(ratio_from_left <= 0 && ratio_from_left >= 1) {
 	  fprintf(stderr,"Error : invalid ratio %.2f for branch grafting. Aborting.\n", ratio_from_left);
@@ -585,6 +602,7 @@ void collapse_branch(Edge* branch, Tree* tree) {
 	int i, j, n1 = node1->nneigh, n2 = node2->nneigh;
 	if (n1 == 1 || n2 == 1) { fprintf(stderr,"Warning: %s() won't collapse terminal edges.\n",__FUNCTION__); return; }
 	int degree = n1+n2-2;
+	invalidate_post_order(tree);
 	/* (1) */
 	/* Node* new = new_node("collapsed", tree, n1 + n2 - 2); */ /* we cannot use that because we want to reuse n1's spot in tree->a_nodes */
 	Node* new = (Node*) malloc(sizeof(Node));
@@ -592,6 +610,7 @@ void collapse_branch(Edge* branch, Tree* tree) {
 	new->neigh = malloc(degree * sizeof(Node*));
 	new->br = malloc(degree * sizeof(Edge*));
 	new->id = node1->id; /* because we are going to store the node at this index in tree->a_nodes */
+	new->taxon_id = -1;
 	new->name = strdup("collapsed");
 	new->comment = NULL;
 	new->mheight = min_int(node1->mheight, node2->mheight);
@@ -687,6 +706,7 @@ void remove_taxon(int taxon_id, Tree* tree){
   int e_to_remove_global_index = 0;
   int n_to_remove_global_index = 0;
   int connect_node_global_index = -1;
+  invalidate_post_order(tree);
   int r_edge_global_index = -1;
 
   char **new_taxa_names;
@@ -821,11 +841,10 @@ void remove_taxon(int taxon_id, Tree* tree){
   }
   tree->length_hashtables = (int)((tree->nb_taxa-1) / ceil(log10((double)(tree->nb_taxa-1))));
   for(i=0;i<tree->nb_edges;i++){
-    tree->a_edges[i]->hashtbl[0] = create_id_hash_table(tree->length_hashtables);
-    tree->a_edges[i]->hashtbl[1] = create_id_hash_table(tree->length_hashtables);
+    tree->a_edges[i]->hashtbl[0] = create_id_hash_table(tree->nb_taxa-1);
+    tree->a_edges[i]->hashtbl[1] = create_id_hash_table(tree->nb_taxa-1);
   }
   tree->nb_taxa--;
-  ntax--;
   update_hashtables_post_alltree(tree);
   update_hashtables_pre_alltree(tree);
   update_node_heights_post_alltree(tree);
@@ -863,6 +882,8 @@ void recompute_identifiers(Tree *tree){
 
   int i, j;
 
+  invalidate_post_order(tree);
+
   for(i=0;i<tree->nb_edges;i++){
     if(tree->a_edges[i]!=NULL){
       new_nb_edges++;
@@ -921,6 +942,7 @@ void recompute_identifiers(Tree *tree){
    => recompute_identifiers()
 */
 void remove_single_node(Tree *tree, Node *connect_node){
+  invalidate_post_order(tree);
 
   Edge *l_edge = connect_node->br[0];
   Edge *r_edge = connect_node->br[1];
@@ -1073,8 +1095,8 @@ void shuffle_taxa(Tree *tree){
     free_id_hashtable(tree->a_edges[i]->hashtbl[1]);
   }
   for(i=0;i<tree->nb_edges;i++){
-    tree->a_edges[i]->hashtbl[0] = create_id_hash_table(tree->length_hashtables);
-    tree->a_edges[i]->hashtbl[1] = create_id_hash_table(tree->length_hashtables);
+    tree->a_edges[i]->hashtbl[0] = create_id_hash_table(tree->nb_taxa);
+    tree->a_edges[i]->hashtbl[1] = create_id_hash_table(tree->nb_taxa);
   }
 
   update_hashtables_post_alltree(tree);
@@ -1126,24 +1148,19 @@ void reroot_acceptable(Tree* t) {
 
 
 void reorient_edges(Tree *t){
-  int i=0;
-  for(i=0; i < t->node0->nneigh; i++)
-    reorient_edges_recur(t->node0->neigh[i], t->node0, t->node0->br[i]);
-}
-
-void reorient_edges_recur(Node *n, Node *prev, Edge *e){
+  /* the edges are oriented from node0: left is the neighbour towards node0, right its descendant */
   int i;
-  /* We reorient the edge */
-  if(e->left == n && e->right == prev){
-    e->left = prev;
-    e->right= n;
-  }else{
-    assert(e->left == prev && e->right == n); /* descendant */
-  }
-    
-  for(i = 0; i < n->nneigh ; i++){
-    if(n->neigh[i] != prev){
-      reorient_edges_recur(n->neigh[i], n, n->br[i]);
+  invalidate_post_order(t); /* node0 may have changed */
+  Node **order = get_post_order(t);
+  for(i=0; i < t->nb_nodes; i++){
+    Node *n = order[i], *prev = t->post_order_from[i];
+    if(prev == NULL) continue; /* node0 */
+    Edge *e = n->br[dir_a_to_b(n, prev)];
+    if(e->left == n && e->right == prev){
+      e->left = prev;
+      e->right= n;
+    }else{
+      assert(e->left == prev && e->right == n); /* descendant */
     }
   }
 }
@@ -1163,6 +1180,7 @@ void unrooted_to_rooted(Tree* t) {
 	/* we create a new root node whose left son will be what was in dir0 from the old root, and right son will be the old root. */
 	Node* new_root = new_node("root", t, 2); /* will have only two neighbours */
 	t->node0 = new_root;
+	invalidate_post_order(t);
 	
 
 	Edge* new_br = new_edge(t); /* this branch will have length MIN_BRLEN and links the new root to the old root as its right son */
@@ -1240,6 +1258,22 @@ int copy_nh_stream_into_str(FILE* nh_stream, char* big_string) {
 /* actually parsing a tree */
 
 
+/* the trees parsed in an arena have all their structures allocated in it (see free_tree) */
+
+static inline void* tree_malloc(Tree* t, size_t size) {
+	return (t->arena ? arena_alloc(t->arena, size) : malloc(size));
+}
+
+static inline void* tree_calloc(Tree* t, size_t nmemb, size_t size) {
+	return (t->arena ? arena_calloc(t->arena, nmemb, size) : calloc(nmemb, size));
+}
+
+static inline char* tree_strdup(Tree* t, const char* str) {
+	return (t->arena ? arena_strdup(t->arena, str) : strdup(str));
+}
+
+
+
 void process_name_and_brlen(Node* son_node, Edge* edge, Tree* current_tree, char* in_str, int begin, int end) {
 	/* looks into in_str[begin..end] for the branch length of the "father" edge
 	   and updates the edge and node structures accordingly */
@@ -1271,14 +1305,19 @@ void process_name_and_brlen(Node* son_node, Edge* edge, Tree* current_tree, char
 
 	name_begin = (closing_par == -1 ? begin : closing_par + 1);
 	if (opening_bracket != -1) name_end = opening_bracket - 1; else name_end = (colon == -1 ? end : colon - 1);
+	/* the string may come unmodified from the file: whitespaces around the name are not part of it */
+	while (name_begin <= name_end && isspace(in_str[name_begin])) name_begin++;
+	while (name_end >= name_begin && isspace(in_str[name_end])) name_end--;
 	/* but now if the name starts and ends with single or double quotes, remove them */
 	if (in_str[name_begin] == in_str[name_end] && ( in_str[name_begin] == '"' || in_str[name_begin] == '\'' )) { name_begin++; name_end--; }
 	name_length = name_end - name_begin + 1;
 	effective_length = (name_length > MAX_NAMELENGTH ? MAX_NAMELENGTH : name_length);
 	if (name_length >= 1) {
-		son_node->name = (char*) malloc((effective_length+1) * sizeof(char));
-		strncpy(son_node->name, in_str+name_begin, effective_length);
-		son_node->name[effective_length] = '\0'; /* terminating the string */
+		/* whitespaces inside the name are dropped, as when the tree string is read from a stream */
+		son_node->name = (char*) tree_malloc(current_tree, (effective_length+1) * sizeof(char));
+		for (i = name_begin, name_length = 0; i <= name_end && name_length < effective_length; i++)
+			if (!isspace(in_str[i])) son_node->name[name_length++] = in_str[i];
+		son_node->name[name_length] = '\0'; /* terminating the string */
 	}
 
 
@@ -1306,21 +1345,22 @@ Node* create_son_and_connect_to_father(Node* current_node, Tree* current_tree, i
 	}
 
 	int i;
-	Node* son = (Node*) malloc(sizeof(Node));
+	Node* son = (Node*) tree_malloc(current_tree, sizeof(Node));
 	son->id = current_tree->next_avail_node_id++;
+	son->taxon_id = -1;
 	current_tree->a_nodes[son->id] = son;
 	current_tree->nb_nodes++;
 
 	son->name = son->comment = NULL;
 	son->mheight = MAX_MHEIGHT;
 
-	Edge* edge = (Edge*) malloc(sizeof(Edge));
+	Edge* edge = (Edge*) tree_malloc(current_tree, sizeof(Edge));
 	edge->id = current_tree->next_avail_edge_id++;
 	current_tree->a_edges[edge->id] = edge;
 	current_tree->nb_edges++;
 
-	edge->hashtbl[0] = create_id_hash_table(current_tree->length_hashtables);
-	edge->hashtbl[1] = create_id_hash_table(current_tree->length_hashtables);
+	/* the bitsets are only created by complete_parse_nh_buffer, when they are needed */
+	edge->hashtbl[0] = edge->hashtbl[1] = NULL;
 
 	// for (i=0; i<2; i++) edge->subtype_counts[i] = (int*) calloc(NUM_SUBTYPES, sizeof(int));
 	for (i=0; i<2; i++) edge->subtype_counts[i] = NULL; /* subtypes.c will have to create that space */
@@ -1379,14 +1419,18 @@ void parse_substring_into_node(char* in_str, int begin, int end, Node* current_n
 
 	/* allocating the data structures for the current node */
 	current_node->nneigh = (nb_commas==0 ? 1 : nb_commas + 1 + has_father);
-	current_node->neigh = malloc(current_node->nneigh * sizeof(Node*));
-	current_node->br = malloc(current_node->nneigh * sizeof(Edge*));
+	current_node->neigh = tree_malloc(current_tree, current_node->nneigh * sizeof(Node*));
+	current_node->br = tree_malloc(current_tree, current_node->nneigh * sizeof(Edge*));
 	
 	if (nb_commas == 0) { /* leaf: no recursive call */
 		/* this means there is no split here, terminal node: we know that the current node is a leaf.
 		   Its name is already there in node->name, we just have to update the taxname table and all info related
 		   to the fact that we have a taxon here. */
 		/* that's also the moment when we check that there are no two identical taxa on different leaves of the tree */
+		if (current_node->name == NULL) { /* empty leaf, or node with a single son, as "(A)" */
+		  fprintf(stderr,"Fatal error: leaf with no name. Aborting.\n");
+		  Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+		}
 		for(i=0;i < current_tree->next_avail_taxon_id; i++) {
 			if (!strcmp(current_node->name, current_tree->taxa_names[i])) {
 			  fprintf(stderr,"Fatal error: duplicate taxon %s.\n", current_node->name);
@@ -1394,7 +1438,7 @@ void parse_substring_into_node(char* in_str, int begin, int end, Node* current_n
 				} /* end if */
 		} /* end for */
 
-		current_tree->taxa_names[current_tree->next_avail_taxon_id++] = strdup(current_node->name);
+		current_tree->taxa_names[current_tree->next_avail_taxon_id++] = tree_strdup(current_tree, current_node->name);
 
 	} else { /* at least one comma, so at least two sons: */
 		for (i=0; i <= nb_commas; i++) { /* e.g. three iterations for two commas */
@@ -1422,22 +1466,135 @@ void parse_substring_into_node(char* in_str, int begin, int end, Node* current_n
 
 
 
+int parse_substring_into_tree_linear(char* in_str, int begin, int end, Tree* current_tree) {
+	/* Non-recursive, linear-time equivalent of parse_substring_into_node(in_str, begin, end, current_tree->node0, 0, current_tree):
+	   the tree built is exactly the same (node and edge ids in pre-order, same directions, names and branch lengths).
+	   parse_substring_into_node rescans the substring of each node at each level, hence a worst case in O(length * depth),
+	   and recurses once per node.
+
+	   (1) a first pass on the string, with an explicit stack of open parentheses, discovers the nodes in pre-order:
+	       for each node we record its father, its number of sons and the boundaries of its "name:length" label.
+	   (2) the nodes and edges are then created in pre-order, so that they get the same ids as in the recursive parser.
+
+	   Returns 0 (and builds nothing) on the inputs where the recursive parser does something special
+	   (nodes with a single son, empty leaves, unbalanced parentheses): these are left to parse_substring_into_node. */
+
+	int max_nodes = 2 * current_tree->nb_taxa - 1; /* size of a_nodes: more nodes means single-son nodes */
+	int* father = (int*) malloc(max_nodes * sizeof(int));
+	int* nb_sons = (int*) malloc(max_nodes * sizeof(int));
+	int* label_begin = (int*) malloc(max_nodes * sizeof(int));
+	int* label_end = (int*) malloc(max_nodes * sizeof(int));
+	int* open_nodes = (int*) malloc(max_nodes * sizeof(int)); /* the stack of nodes whose closing parenthesis has not been seen */
+	int top = 0, nb_nodes = 1, ok = 1;
+	int i = begin, k, j;
+	Node* son;
+	map_t taxa_seen;
+
+	/* (1) FIRST PASS: discovering the structure */
+	father[0] = -1; nb_sons[0] = 0; open_nodes[0] = 0;
+	while (ok) {
+		/* beginning of a new son of open_nodes[top] */
+		while (i <= end && isspace(in_str[i])) i++;
+		if (nb_nodes == max_nodes) { ok = 0; break; }
+		k = nb_nodes++;
+		father[k] = open_nodes[top]; nb_sons[open_nodes[top]]++; nb_sons[k] = 0;
+		if (i <= end && in_str[i] == '(') { open_nodes[++top] = k; i++; continue; }
+
+		/* this son is a leaf: its label goes up to the next comma or closing parenthesis */
+		label_begin[k] = i;
+		while (i <= end && in_str[i] != ',' && in_str[i] != ')') i++;
+		label_end[k] = i-1;
+		if (label_end[k] < label_begin[k]) { ok = 0; break; }
+
+		/* closing all the nodes that end here, until the next comma */
+		while (i <= end && in_str[i] == ')') {
+			if (top == 0) { ok = 0; break; }
+			k = open_nodes[top--];
+			if (nb_sons[k] < 2) { ok = 0; break; }
+			label_begin[k] = ++i;
+			while (i <= end && in_str[i] != ',' && in_str[i] != ')') i++;
+			label_end[k] = i-1;
+		}
+		if (!ok) break;
+		if (i > end) break; /* end of the string */
+		i++; /* skipping the comma */
+	}
+	if (top != 0 || nb_sons[0] < 2) ok = 0;
+
+	if (!ok) {
+		free(father); free(nb_sons); free(label_begin); free(label_end); free(open_nodes);
+		return 0;
+	}
+
+	/* (2) SECOND PASS: creating the nodes and edges in pre-order. nb_sons is reused to count the directions already filled. */
+	current_tree->node0->nneigh = nb_sons[0];
+	current_tree->node0->neigh = tree_malloc(current_tree, nb_sons[0] * sizeof(Node*));
+	current_tree->node0->br = tree_malloc(current_tree, nb_sons[0] * sizeof(Edge*));
+	nb_sons[0] = 0; /* the root has no father: its sons start at direction 0 */
+
+	taxa_seen = hashmap_new(); /* to check that there are no two identical taxa on different leaves of the tree */
+	for (k = 1; k < nb_nodes; k++) {
+		Node* current_node = current_tree->a_nodes[father[k]];
+		int direction = nb_sons[father[k]]++;
+		son = create_son_and_connect_to_father(current_node, current_tree, direction /* dir from current */,
+							in_str, label_begin[k], label_end[k]);
+		j = (nb_sons[k] == 0 ? 1 : nb_sons[k] + 1); /* the sons plus the father */
+		son->nneigh = j;
+		son->neigh = tree_malloc(current_tree, j * sizeof(Node*));
+		son->br = tree_malloc(current_tree, j * sizeof(Edge*));
+		son->neigh[0] = current_node;
+		son->br[0] = current_node->br[direction];
+		nb_sons[k] = 1; /* its sons start at direction 1 */
+
+		if (j == 1) { /* leaf */
+			any_t previous;
+			if (son->name == NULL) {
+			  fprintf(stderr,"Fatal error: leaf with no name. Aborting.\n");
+			  Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+			}
+			if (hashmap_get(taxa_seen, son->name, &previous) == MAP_OK) {
+			  fprintf(stderr,"Fatal error: duplicate taxon %s.\n", son->name);
+			  Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+			}
+			hashmap_put(taxa_seen, son->name, NULL);
+			current_tree->taxa_names[current_tree->next_avail_taxon_id++] = tree_strdup(current_tree, son->name);
+		}
+	}
+	hashmap_free(taxa_seen);
+
+	free(father); free(nb_sons); free(label_begin); free(label_end); free(open_nodes);
+	return 1;
+} /* end parse_substring_into_tree_linear */
+
+
+
 Tree* parse_nh_string(char* in_str) {
+	return parse_nh_buffer(in_str, (int) strlen(in_str), NULL);
+} /* end parse_nh_string */
+
+
+Tree* parse_nh_buffer(char* in_str, int in_length, Arena* arena) {
+	return parse_nh_buffer_with(in_str, in_length, arena, NH_PARSER_ANY);
+} /* end parse_nh_buffer */
+
+
+Tree* parse_nh_buffer_with(char* in_str, int in_length, Arena* arena, nh_parser_t parser) {
 	/* this function allocates, populates and returns a new tree. */
 	/* returns NULL if the file doesn't correspond to NH format */
-	int in_length = (int) strlen(in_str);
+	/* in_str[0..in_length-1] needs not be null-terminated, and may contain whitespaces (e.g. when it points into a mapped file) */
+	/* if arena is not NULL, the whole tree is allocated in it */
 	int i; /* loop counter */
 	int begin, end; /* to delimitate the string to further process */
 	int n_otu = 0;
 
 	/* SYNTACTIC CHECKS on the input string */ 	
-	i = 0; while (isspace(in_str[i])) i++;
-	if (in_str[i] != '(') { fprintf(stderr,"Error: tree doesn't start with an opening parenthesis.\n"); return NULL; }
+	i = 0; while (i < in_length && isspace(in_str[i])) i++;
+	if (i == in_length || in_str[i] != '(') { fprintf(stderr,"Error: tree doesn't start with an opening parenthesis.\n"); return NULL; }
 	else begin = i+1;
 	/* begin: AFTER the very first parenthesis */
 
 	i = in_length-1;
-	while (isspace(in_str[i])) i--;
+	while (i > 0 && isspace(in_str[i])) i--;
 	if (in_str[i] != ';') { fprintf(stderr,"Error: tree doesn't end with a semicolon.\n"); return NULL; }
 	while (in_str[--i] != ')') ;
 	end = i-1;
@@ -1448,38 +1605,38 @@ Tree* parse_nh_string(char* in_str) {
 	for (i = 0; i < in_length; i++) if (in_str[i] == ',') n_otu++;
 	n_otu++;
 
-	/* immediately, we set the global variable ntax. TODO: see if we can simply get rid of this global var. */
-	ntax = n_otu;
-
 
 
 	/************************************
 	initialisation of the tree structure 
 	*************************************/
-	Tree *t = (Tree *) malloc(sizeof(Tree));
+	Tree *t = (Tree *) (arena ? arena_alloc(arena, sizeof(Tree)) : malloc(sizeof(Tree)));
+	t->arena = arena;
 	/* in a rooted binary tree with n taxa, (2n-2) branches and (2n-1) nodes in total.
 	  this is the maximum we can have. multifurcations will reduce the number of nodes and branches, so set the data structures to the max size */
 	t->nb_taxa = n_otu;
-	t->leaves = allocateLA(n_otu);
+	t->leaves = allocateLA_in_arena(arena, n_otu);
 
-	t->a_nodes = (Node**) calloc(2*n_otu-1, sizeof(Node*));
+	t->a_nodes = (Node**) tree_calloc(t, 2*n_otu-1, sizeof(Node*));
 	t->nb_nodes = 1; /* for the moment we only have the node0 node. */
 
-	t->a_edges = (Edge**) calloc(2*n_otu-2, sizeof(Edge*));
+	t->a_edges = (Edge**) tree_calloc(t, 2*n_otu-2, sizeof(Edge*));
 	t->nb_edges = 0; /* none at the moment */
 	
-	t->node0 = (Node*) malloc(sizeof(Node));
+	t->node0 = (Node*) tree_malloc(t, sizeof(Node));
 	t->a_nodes[0] = t->node0;
 
 	t->node0->id = 0;
+	t->node0->taxon_id = -1;
 	t->node0->name = NULL;
 	t->node0->comment = NULL;
 
 	t->node0->mheight = MAX_MHEIGHT;
-	t->taxa_names = (char**) malloc(n_otu * sizeof(char*));
+	t->taxa_names = (char**) tree_malloc(t, n_otu * sizeof(char*));
 	t->length_hashtables = (int) (n_otu / ceil(log10((double)n_otu)));
 
 	t->taxname_lookup_table = NULL;
+	t->post_order = t->post_order_from = NULL;
 
 	t->next_avail_node_id = 1; /* root node has id 0 */
 	t->next_avail_edge_id = 0; /* no branch added so far */
@@ -1487,7 +1644,16 @@ Tree* parse_nh_string(char* in_str) {
 
 	/* ACTUALLY READING THE TREE... */
 
-	parse_substring_into_node(in_str, begin, end, t->node0, 0 /* no father node */, t);
+	if (parser == NH_PARSER_RECURSIVE || !parse_substring_into_tree_linear(in_str, begin, end, t)) {
+		if (parser == NH_PARSER_LINEAR) { /* nothing was built in the tree yet */
+			if (arena == NULL) {
+				freeLA(t->leaves);
+				free(t->a_nodes); free(t->a_edges); free(t->node0); free(t->taxa_names); free(t);
+			}
+			return NULL;
+		}
+		parse_substring_into_node(in_str, begin, end, t->node0, 0 /* no father node */, t);
+	}
 
 	/* SANITY CHECKS AFTER READING THE TREE */
 
@@ -1509,24 +1675,60 @@ Tree* parse_nh_string(char* in_str) {
 
 	return t;
 
-} /* end parse_nh_string */
+} /* end parse_nh_buffer_with */
 
 
 Tree *complete_parse_nh(char* big_string, char*** taxname_lookup_table,
                         bool skip_hashtables) {
+	return complete_parse_nh_buffer(big_string, (int) strlen(big_string), taxname_lookup_table, NULL, skip_hashtables, NULL);
+}
+
+
+Tree *complete_parse_nh_buffer(char* buffer, int length, char*** taxname_lookup_table, map_t taxid_map,
+                               bool skip_hashtables, Arena* arena) {
 	/* trick: iff taxname_lookup_table is NULL, we set it according to the tree read, otherwise we use it as the reference taxname lookup table */
-	int i;
- 	Tree* mytree = parse_nh_string(big_string); 
+ 	Tree* mytree = parse_nh_buffer(buffer, length, arena); 
 	if(mytree == NULL) { fprintf(stderr,"Not a syntactically correct NH tree.\n"); return NULL; }
 
 	if(*taxname_lookup_table == NULL)
 	  *taxname_lookup_table = build_taxname_lookup_table(mytree);
 	mytree->taxname_lookup_table = *taxname_lookup_table;
 
+	/* leaf names are resolved once here, so that the taxa are then handled by their ids */
+	if(taxid_map) set_leaf_taxon_ids(mytree, taxid_map);
+	else {
+	  map_t tmp_map = build_taxid_hashmap(*taxname_lookup_table, mytree->nb_taxa);
+	  set_leaf_taxon_ids(mytree, tmp_map);
+	  free_taxid_hashmap(tmp_map);
+	}
+
+	prepare_parsed_tree(mytree, skip_hashtables);
+	return mytree;
+}
+
+
+void prepare_parsed_tree(Tree* mytree, bool skip_hashtables) {
+	int i;
 	update_bootstrap_supports_from_node_names(mytree);
 
-  // Skip these (quadratic-time operations) for the rapid TBE calculation:
+  // Skip these (quadratic-time and quadratic-space operations) for the rapid TBE calculation:
   if(!skip_hashtables) {
+	  /* the bitsets are indexed by taxon ids */
+	  for (i = 0; i < mytree->nb_nodes; i++)
+	  	if (mytree->a_nodes[i]->nneigh == 1 && mytree->a_nodes[i]->taxon_id < 0) {
+	  		fprintf(stderr,"Fatal error : taxon %s not found! Aborting.\n", mytree->a_nodes[i]->name);
+	  		Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+	  	}
+	  for (i = 0; i < mytree->nb_edges; i++) {
+	  	if (mytree->arena) {
+	  		mytree->a_edges[i]->hashtbl[0] = create_id_hash_table_in_arena(mytree->arena, mytree->nb_taxa);
+	  		mytree->a_edges[i]->hashtbl[1] = create_id_hash_table_in_arena(mytree->arena, mytree->nb_taxa);
+	  	} else {
+	  		mytree->a_edges[i]->hashtbl[0] = create_id_hash_table(mytree->nb_taxa);
+	  		mytree->a_edges[i]->hashtbl[1] = create_id_hash_table(mytree->nb_taxa);
+	  	}
+	  }
+
 	  update_hashtables_post_alltree(mytree);
 	  update_hashtables_pre_alltree(mytree);
 
@@ -1546,7 +1748,7 @@ Tree *complete_parse_nh(char* big_string, char*** taxname_lookup_table,
 	     we have the equal_or_complement function to compare hashtables */
 
 	  for (i = 0; i < mytree->nb_edges; i++) {
-	  	free_id_hashtable(mytree->a_edges[i]->hashtbl[0]); 
+	  	if (!mytree->arena) free_id_hashtable(mytree->a_edges[i]->hashtbl[0]); 
 	  	mytree->a_edges[i]->hashtbl[0] = NULL;
 	  }
 
@@ -1555,8 +1757,6 @@ Tree *complete_parse_nh(char* big_string, char*** taxname_lookup_table,
   }
 
   prepare_rapid_TI(mytree);  //Set up for rapid Transfer Index computation.
-
-	return mytree;
 }
 
 
@@ -1599,6 +1799,19 @@ int free_hashmap_data(any_t arg,any_t key, any_t elemt){
   return MAP_OK;
 }
 
+void set_leaf_taxon_ids(Tree* tree, map_t taxid_map){
+  int i;
+  any_t val;
+  for(i=0;i<tree->nb_nodes;i++){
+    Node* n = tree->a_nodes[i];
+    if(n->nneigh != 1) continue;
+    if(hashmap_get(taxid_map, n->name, &val) == MAP_OK)
+      n->taxon_id = *((int*) val);
+    else
+      n->taxon_id = -1;
+  }
+}
+
 char** get_taxname_lookup_table(Tree* tree) {
 	return tree->taxname_lookup_table;
 }
@@ -1640,22 +1853,97 @@ void regraft_branch_on_node(Edge* edge, Node* target_node, int dir) {
 ***************************************************************/
 
 /* in all cases below we accept that origin can be NULL:
-   this describes the situation where we are on the pseudoroot node. */
+   this describes the situation where we are on the pseudoroot node.
+   None of them recurses: the nodes are visited in the order of a post-order array (see get_post_order), so that
+   the deepest (caterpillar) trees do not overflow the stacks of the threads. */
+
+static int fill_post_order(Node* current, Node* origin, Node** order, Node** from, int capacity) {
+	/* puts into order the nodes of the subtree of current (not including origin) in the order of a recursive
+	   post-order traversal, and into from[i] the neighbour of order[i] towards current (origin for current).
+	   An explicit stack replaces the recursion. Returns the number of nodes, at most capacity. */
+	int count = 0, top = 1;
+	Node** stack_node = (Node**) malloc(capacity * sizeof(Node*));
+	int* stack_dir = (int*) malloc(capacity * sizeof(int)); /* direction from the node to its origin, -1 for the pseudoroot */
+	int* stack_next = (int*) malloc(capacity * sizeof(int)); /* number of its sons already pushed */
+	if (!stack_node || !stack_dir || !stack_next) {
+	  fprintf(stderr,"Error: cannot allocate a traversal of %d nodes\n", capacity);
+	  Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+	}
 
-void post_order_traversal_recur(Node* current, Node* origin, Tree* tree, void (*func)(Node*, Node*, Tree*)) {
-	/* does the post order traversal on current Node and its "descendants" (i.e. not including origin, who is a neighbour of current */
-	int i, n = current->nneigh;
-	int cur_to_orig = (origin ? dir_a_to_b(current, origin) : -1); /* direction from the current node to the origin of the traversal */
+	stack_node[0] = current;
+	stack_dir[0] = (origin ? dir_a_to_b(current, origin) : -1);
+	stack_next[0] = 0;
+	while (top > 0) {
+		Node* node = stack_node[top-1];
+		int n = node->nneigh, dir = stack_dir[top-1];
+		if (stack_next[top-1] < (dir == -1 ? n : n-1)) { /* a son left: sons first */
+			int i = stack_next[top-1]++;
+			Node* son = (dir == -1 ? node->neigh[i] : node->neigh[(dir+1+i)%n]);
+			if (top == capacity) break;
+			stack_node[top] = son;
+			stack_dir[top] = dir_a_to_b(son, node);
+			stack_next[top] = 0;
+			top++;
+		} else { /* and then the node itself */
+			if (count == capacity) break;
+			order[count] = node;
+			from[count++] = (top > 1 ? stack_node[top-2] : origin);
+			top--;
+		}
+	}
+	if (top > 0) {
+	  fprintf(stderr,"Fatal error : more than %d nodes in the traversal.\n", capacity);
+	  Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+	}
 
-	/* process children first */
-	if (cur_to_orig == -1) { /* current is the pseudoroot node */
-		for(i=0; i < n; i++) post_order_traversal_recur(current->neigh[i], current, tree, func);
-	} else {
-		for(i=1; i < n; i++) post_order_traversal_recur(current->neigh[(cur_to_orig+i)%n], current, tree, func); /* no iter when n==1 (leaf) */
+	free(stack_node);
+	free(stack_dir);
+	free(stack_next);
+	return count;
+}
+
+Node** get_post_order(Tree* tree) {
+	if (tree->post_order == NULL) {
+		tree->post_order = (Node**) tree_malloc(tree, tree->nb_nodes * sizeof(Node*));
+		tree->post_order_from = (Node**) tree_malloc(tree, tree->nb_nodes * sizeof(Node*));
+		if (fill_post_order(tree->node0, NULL, tree->post_order, tree->post_order_from, tree->nb_nodes) != tree->nb_nodes) {
+		  fprintf(stderr,"Fatal error : some nodes of the tree are not connected to its root.\n");
+		  Generic_Exit(__FILE__,__LINE__,__FUNCTION__,EXIT_FAILURE);
+		}
 	}
+	return tree->post_order;
+}
 
-	/* and then in any case, call the function on the current node */
-	func(current, origin /* may be NULL, it's up to func to deal with that properly */, tree);
+void invalidate_post_order(Tree* tree) {
+	if (!tree->arena) {
+		free(tree->post_order);
+		free(tree->post_order_from);
+	}
+	tree->post_order = tree->post_order_from = NULL;
+}
+
+static Node** subtree_post_order(Node* current, Node* origin, Tree* tree, Node*** from, int* nb) {
+	/* the post-order of the subtree of current: the one of the tree from the pseudoroot, or a new one that
+	   the caller frees (the nodes, then their origins, in the same array) */
+	if (current == tree->node0 && origin == NULL) {
+		Node** order = get_post_order(tree);
+		*from = tree->post_order_from;
+		*nb = tree->nb_nodes;
+		return order;
+	}
+	Node** order = (Node**) malloc(2 * tree->nb_nodes * sizeof(Node*));
+	*from = order + tree->nb_nodes;
+	*nb = fill_post_order(current, origin, order, *from, tree->nb_nodes);
+	return order;
+}
+
+void post_order_traversal_recur(Node* current, Node* origin, Tree* tree, void (*func)(Node*, Node*, Tree*)) {
+	/* does the post order traversal on current Node and its "descendants" (i.e. not including origin, who is a neighbour of current */
+	Node** from;
+	int i, nb;
+	Node** order = subtree_post_order(current, origin, tree, &from, &nb);
+	for (i = 0; i < nb; i++) func(order[i], from[i] /* may be NULL, it's up to func to deal with that properly */, tree);
+	if (order != tree->post_order) free(order);
 }
 
 void post_order_traversal(Tree* t, void (*func)(Node*, Node*, Tree*)) {
@@ -1665,18 +1953,11 @@ void post_order_traversal(Tree* t, void (*func)(Node*, Node*, Tree*)) {
 /* Post order traversal with any data that can be passed to the recur function */
 void post_order_traversal_data_recur(Node* current, Node* origin, Tree* tree, void* data, void (*func)(Node*, Node*, Tree*, void*)) {
   /* does the post order traversal on current Node and its "descendants" (i.e. not including origin, who is a neighbour of current */
-  int i, n = current->nneigh;
-  int cur_to_orig = (origin ? dir_a_to_b(current, origin) : -1); /* direction from the current node to the origin of the traversal */
-
-  /* process children first */
-  if (cur_to_orig == -1) { /* current is the pseudoroot node */
-    for(i=0; i < n; i++) post_order_traversal_data_recur(current->neigh[i], current, tree, data, func);
-  } else {
-    for(i=1; i < n; i++) post_order_traversal_data_recur(current->neigh[(cur_to_orig+i)%n], current, tree, data, func); /* no iter when n==1 (leaf) */
-  }
-
-  /* and then in any case, call the function on the current node */
-  func(current, origin /* may be NULL, it's up to func to deal with that properly */, tree, data);
+  Node** from;
+  int i, nb;
+  Node** order = subtree_post_order(current, origin, tree, &from, &nb);
+  for (i = 0; i < nb; i++) func(order[i], from[i] /* may be NULL, it's up to func to deal with that properly */, tree, data);
+  if (order != tree->post_order) free(order);
 }
 
 void post_order_traversal_data(Tree* t, void* data, void (*func)(Node*, Node*, Tree*,void*)) {
@@ -1684,19 +1965,13 @@ void post_order_traversal_data(Tree* t, void* data, void (*func)(Node*, Node*, T
 }
 
 void pre_order_traversal_recur(Node* current, Node* origin, Tree* tree, void (*func)(Node*, Node*, Tree*)) {
-	/* does the pre order traversal on current Node and its "descendants" (i.e. not including origin, who is a neighbour of current */
-	int i, n = current->nneigh;
-	int cur_to_orig = (origin ? dir_a_to_b(current, origin) : -1); /* direction from the current node to the origin of the traversal */
-
-	/* in any case, call the function on the current node first */
-	func(current, origin /* may be NULL, it's up to func to deal with that properly */, tree);
-
-	/* if current is not a leaf, process its children */
-	if (cur_to_orig == -1) { /* current is the pseudoroot node */
-		for(i=0; i < n; i++) pre_order_traversal_recur(current->neigh[i], current, tree, func);
-	} else {
-		for(i=1; i < n; i++) pre_order_traversal_recur(current->neigh[(cur_to_orig+i)%n], current, tree, func); /* no iter when n==1 (leaf) */
-	}
+	/* does the pre order traversal on current Node and its "descendants" (i.e. not including origin, who is a neighbour of current:
+	   the reversed post-order, each node coming before its sons (the sons of a node are visited from the last one) */
+	Node** from;
+	int i, nb;
+	Node** order = subtree_post_order(current, origin, tree, &from, &nb);
+	for (i = nb-1; i >= 0; i--) func(order[i], from[i] /* may be NULL, it's up to func to deal with that properly */, tree);
+	if (order != tree->post_order) free(order);
 }
 
 
@@ -1706,19 +1981,12 @@ void pre_order_traversal(Tree* t, void (*func)(Node*, Node*, Tree*)) {
 
 /* Pre order traversal with any data that can be passed to the recur function */
 void pre_order_traversal_data_recur(Node* current, Node* origin, Tree* tree, void* data, void (*func)(Node*, Node*, Tree*, void*)) {
-	/* does the pre order traversal on current Node and its "descendants" (i.e. not including origin, who is a neighbour of current */
-	int i, n = current->nneigh;
-	int cur_to_orig = (origin ? dir_a_to_b(current, origin) : -1); /* direction from the current node to the origin of the traversal */
-
-	/* in any case, call the function on the current node first */
-	func(current, origin /* may be NULL, it's up to func to deal with that properly */, tree, data);
-
-	/* if current is not a leaf, process its children */
-	if (cur_to_orig == -1) { /* current is the pseudoroot node */
-	  for(i=0; i < n; i++) pre_order_traversal_data_recur(current->neigh[i], current, tree, data, func);
-	} else {
-	  for(i=1; i < n; i++) pre_order_traversal_data_recur(current->neigh[(cur_to_orig+i)%n], current, tree, data, func); /* no iter when n==1 (leaf) */
-	}
+	/* does the pre order traversal on current Node and its "descendants" (see pre_order_traversal_recur) */
+	Node** from;
+	int i, nb;
+	Node** order = subtree_post_order(current, origin, tree, &from, &nb);
+	for (i = nb-1; i >= 0; i--) func(order[i], from[i] /* may be NULL, it's up to func to deal with that properly */, tree, data);
+	if (order != tree->post_order) free(order);
 }
 
 
@@ -1730,8 +1998,10 @@ void pre_order_traversal_data(Tree* t, void* data, void (*func)(Node*, Node*, Tr
 /* BOOTSTRAP SUPPORT UTILITIES */
 
 void update_bootstrap_supports_from_node_names(Tree* tree) {
-	/* this calls the recursive function to update all branch bootstrap supports, originally imported as internal node names from the NH file */
-	pre_order_traversal(tree,&update_bootstrap_supports_doer);
+	/* this updates all branch bootstrap supports, originally imported as internal node names from the NH file */
+	Node** order = get_post_order(tree);
+	int i;
+	for (i = tree->nb_nodes-1; i >= 0; i--) update_bootstrap_supports_doer(order[i], tree->post_order_from[i], tree);
 }
 
 void update_bootstrap_supports_doer(Node* current, Node* origin, Tree* tree) {
@@ -1797,19 +2067,25 @@ void update_node_depths_pre_doer(Node* target, Node* orig, Tree* t) {
 
 
 void update_node_heights_post_alltree(Tree* tree) {
-	post_order_traversal(tree, &update_node_heights_post_doer);
+	Node** order = get_post_order(tree);
+	int i;
+	for (i = 0; i < tree->nb_nodes; i++) update_node_heights_post_doer(order[i], tree->post_order_from[i], tree);
 } /* end of update_node_heights_post_alltree */
 
 
 void update_node_heights_pre_alltree(Tree* tree) {
-	pre_order_traversal(tree, &update_node_heights_pre_doer);
+	Node** order = get_post_order(tree);
+	int i;
+	for (i = tree->nb_nodes-1; i >= 0; i--) update_node_heights_pre_doer(order[i], tree->post_order_from[i], tree);
 } /* end of update_node_heights_pre_alltree */
 
 /*
 Set the depth of all the nodes of the tree.
 */
 void prepare_rapid_TI_pre(Tree* tree) {
-	pre_order_traversal(tree, &update_node_depths_pre_doer);
+	Node** order = get_post_order(tree);
+	int i;
+	for (i = tree->nb_nodes-1; i >= 0; i--) update_node_depths_pre_doer(order[i], tree->post_order_from[i], tree);
 } /* end of update_node_depths_pre_alltree */
 
 
@@ -1858,7 +2134,8 @@ void update_hashtables_post_doer(Node* current, Node* orig, Tree* t) {
 	if (n == 1) {
 		assert(br->right == current);
 		/* add the id of the taxon to the right hashtable of the branch */
-		add_id(br->hashtbl[1],get_tax_id_from_tax_name(current->name, t->taxname_lookup_table, t->nb_taxa));
+		add_id(br->hashtbl[1], current->taxon_id >= 0 ? current->taxon_id
+		       : get_tax_id_from_tax_name(current->name, t->taxname_lookup_table, t->nb_taxa));
 	}
 } /* end update_hashtables_post_doer */
 
@@ -1891,11 +2168,15 @@ void update_hashtables_pre_doer(Node* current, Node* orig, Tree* t) {
 
 
 void update_hashtables_post_alltree(Tree* tree) {
-	post_order_traversal(tree, &update_hashtables_post_doer);
+	Node** order = get_post_order(tree);
+	int i;
+	for (i = 0; i < tree->nb_nodes; i++) update_hashtables_post_doer(order[i], tree->post_order_from[i], tree);
 } /* end of update_hashtables_post_alltree */
 
 void update_hashtables_pre_alltree(Tree* tree) {
-	pre_order_traversal(tree, &update_hashtables_pre_doer);
+	Node** order = get_post_order(tree);
+	int i;
+	for (i = tree->nb_nodes-1; i >= 0; i--) update_hashtables_pre_doer(order[i], tree->post_order_from[i], tree);
 } /* end of update_hashtables_pre_alltree */
 
 
@@ -1903,8 +2184,9 @@ void update_hashtables_pre_alltree(Tree* tree) {
 /* UNION AND INTERSECT CALCULATIONS (FOR THE TRANSFER METHOD) */
 
 void update_i_c_post_order_ref_tree(Tree* ref_tree, Node* orig, Node* target, Tree* boot_tree, short unsigned** i_matrix, short unsigned** c_matrix) {
-	/* this function does the post-order traversal (recursive from the pseudoroot to the leaves, updating knowledge for the subtrees)
-	   of the reference tree, examining only leaves (terminal edges) of the bootstrap tree.
+	/* this function is the step of the post-order traversal (from the leaves to the pseudoroot, updating knowledge for the subtrees)
+	   of the reference tree on one of its nodes, examining only leaves (terminal edges) of the bootstrap tree.
+	   The sons of target must have been updated before (see update_all_i_c_post_order_ref_tree).
 	   It sends a probe from the orig node to the target node (nodes in ref_tree), calculating I_ij and C_ij
 	   (see Brehelin, Gascuel, Martin 2008). */
 	int j, k, dir, orig_to_target, target_to_orig;
@@ -1950,7 +2232,6 @@ void update_i_c_post_order_ref_tree(Tree* ref_tree, Node* orig, Node* target, Tr
 
 		for (k = 1; k < target->nneigh; k++) {
 			dir = (target_to_orig + k) % target->nneigh; /* direction from target to one of its "sons" (== not orig) */
-			update_i_c_post_order_ref_tree(ref_tree, target, target->neigh[dir], boot_tree, i_matrix, c_matrix);
 			edge_id2 = target->br[dir]->id;
 			for (j=0; j < boot_tree->nb_edges; j++) { /* for all the terminal edges of boot_tree */ 
 				if(boot_tree->a_edges[j]->right->nneigh != 1) continue;
@@ -1971,9 +2252,11 @@ void update_i_c_post_order_ref_tree(Tree* ref_tree, Node* orig, Node* target, Tr
 
 void update_all_i_c_post_order_ref_tree(Tree* ref_tree, Tree* boot_tree, short unsigned** i_matrix, short unsigned** c_matrix) {
 	/* this function is the first step of the union and intersection calculations */
-	Node* root = ref_tree->node0;
-	int i, n = root->nneigh;
-	for(i=0; i<n; i++) update_i_c_post_order_ref_tree(ref_tree, root, root->neigh[i], boot_tree, i_matrix, c_matrix);
+	Node** order = get_post_order(ref_tree);
+	int i;
+	for(i=0; i < ref_tree->nb_nodes; i++)
+		if (ref_tree->post_order_from[i] != NULL) /* not the pseudoroot */
+			update_i_c_post_order_ref_tree(ref_tree, ref_tree->post_order_from[i], order[i], boot_tree, i_matrix, c_matrix);
 } /* end update_all_i_c_post_order_ref_tree */
 
 
@@ -1981,14 +2264,17 @@ void update_all_i_c_post_order_ref_tree(Tree* ref_tree, Tree* boot_tree, short u
 
 
 void update_i_c_post_order_boot_tree(Tree* ref_tree, Tree* boot_tree, Node* orig, Node* target, short unsigned** i_matrix, short unsigned** c_matrix,
-				     short unsigned** hamming, short unsigned* min_dist, short unsigned* min_dist_edge) {
+				     short unsigned* min_dist, short unsigned* min_dist_edge) {
 	/* here we implement the second part of the Brehelin/Gascuel/Martin algorithm:
-	   post-order traversal of the bootstrap tree, and numerical recurrence. */
+	   post-order traversal of the bootstrap tree, and numerical recurrence.
+	   This is its step on the node target, whose sons must have been updated before (see update_all_i_c_post_order_boot_tree). */
 	/* in this function, orig and target are nodes of boot_tree (aka T_boot). */
 	/* min_dist is an array whose size is equal to the number of edges in T_ref.
 	   It gives for each edge of T_ref its min distance to a split in T_boot. */
 
 	int i, j, dir, orig_to_target, target_to_orig;
+	int hamming; /* distance between the cluster i of T_ref and the cluster edge_id of T_boot: each one is only
+			used to update the min, so that there is no need to keep a whole matrix of them */
 	Edge* my_br; /* branch of the boot tree connecting orig to target */
 	int edge_id /* its id */, edge_id2 /* id of descending branches. */;
 	int N = ref_tree->nb_taxa;
@@ -2001,7 +2287,7 @@ void update_i_c_post_order_boot_tree(Tree* ref_tree, Tree* boot_tree, Node* orig
 
 	if(target->nneigh != 1) {
 		/* because nothing to do in the case where target is a leaf: intersection and union already ok. */
-		/* otherwise, keep on posttraversing in all other directions */
+		/* otherwise, sum the rows of the other directions */
 
 		/* first initialise (zero) the cells we are going to update */
 		for (i=0; i < ref_tree->nb_edges; i++) i_matrix[i][edge_id] = c_matrix[i][edge_id] = 0;
@@ -2009,8 +2295,6 @@ void update_i_c_post_order_boot_tree(Tree* ref_tree, Tree* boot_tree, Node* orig
 		for(j=1;j<target->nneigh;j++) {
 			dir = (target_to_orig + j) % target->nneigh;
 			edge_id2 = target->br[dir]->id;
-			update_i_c_post_order_boot_tree(ref_tree, boot_tree, target, target->neigh[dir],
-							i_matrix, c_matrix, hamming, min_dist, min_dist_edge);
 			for (i=0; i < ref_tree->nb_edges; i++) { /* for all the edges of ref_tree */ 
 				i_matrix[i][edge_id] += i_matrix[i][edge_id2];
 				c_matrix[i][edge_id] += c_matrix[i][edge_id2];
@@ -2021,18 +2305,18 @@ void update_i_c_post_order_boot_tree(Tree* ref_tree, Tree* boot_tree, Node* orig
 
 	for (i=0; i<ref_tree->nb_edges; i++) { /* for all the edges of ref_tree */ 
 		/* at this point we can calculate in all cases (internal branch or not) the Hamming distance at [i][edge_id], */
-		hamming[i][edge_id] = /* card of union minus card of intersection */ 
+		hamming = /* card of union minus card of intersection */ 
 			ref_tree->a_edges[i]->hashtbl[1]->num_items /* #taxa in the cluster i of T_ref */
 			+ c_matrix[i][edge_id] /* #taxa in cluster edge_id of T_boot BUT NOT in cluster i of T_ref */
 			- i_matrix[i][edge_id]; /* #taxa in the intersection of the two clusters */
 
 		/* NEW!! Let's immediately calculate the right ditance, taking into account the fact that the true disance is min (dist, N-dist) */
-		if (hamming[i][edge_id] > N/2 /* floor value */) hamming[i][edge_id] = N - hamming[i][edge_id];
+		if (hamming > N/2 /* floor value */) hamming = N - hamming;
 		
 
 		/*   and update the min of all Hamming (TRANSFER) distances hamming[i][j] over all j */
-		if (hamming[i][edge_id] < min_dist[i]){
-			min_dist[i] = hamming[i][edge_id];
+		if (hamming < min_dist[i]){
+			min_dist[i] = hamming;
 			min_dist_edge[i] = edge_id;
 		}
 			
@@ -2042,11 +2326,13 @@ void update_i_c_post_order_boot_tree(Tree* ref_tree, Tree* boot_tree, Node* orig
 
 
 void update_all_i_c_post_order_boot_tree(Tree* ref_tree, Tree* boot_tree, short unsigned** i_matrix, short unsigned** c_matrix,
-					 short unsigned** hamming, short unsigned* min_dist, short unsigned* min_dist_edge) {
+					 short unsigned* min_dist, short unsigned* min_dist_edge) {
 	/* this function is the second step of the union and intersection calculations */
-	Node* root = boot_tree->node0;
-	int i, n = root->nneigh;
-	for(i=0 ; i<n ; i++) update_i_c_post_order_boot_tree(ref_tree, boot_tree, root, root->neigh[i], i_matrix, c_matrix, hamming, min_dist, min_dist_edge);
+	Node** order = get_post_order(boot_tree);
+	int i;
+	for(i=0 ; i < boot_tree->nb_nodes; i++)
+		if (boot_tree->post_order_from[i] != NULL) /* not the pseudoroot */
+			update_i_c_post_order_boot_tree(ref_tree, boot_tree, boot_tree->post_order_from[i], order[i], i_matrix, c_matrix, min_dist, min_dist_edge);
 
 	/* and then some checks to make sure everything went ok */
 	for(i=0; i<ref_tree->nb_edges; i++) {
@@ -2081,26 +2367,50 @@ void write_nh_tree(Tree* tree, FILE* stream) {
 
 /* the following function writes the subtree having root "node" and not including "node_from". */
 void write_subtree_to_stream(Node* node, Node* node_from, FILE* stream) {
-	int i, direction_to_exclude, n = node->nneigh;
+	/* the nodes whose subtree is being written are on an explicit stack, with the direction to exclude and the number
+	   of sons already written, so that the depth of the tree is not limited by the stack of the thread */
+	int capacity = 64, top = 1;
 	if (node == NULL || node_from == NULL) return;
-
-	if(n == 1) {
-		/* terminal node */
-		fprintf(stream, "%s:%f", (node->name ? node->name : ""), node->br[0]->brlen); /* distance to father */
-	} else {
-	        direction_to_exclude = dir_a_to_b(node, node_from);	
-
-		putc('(', stream);
-		/* we have to write (n-1) subtrees in total. The last print is not followed by a comma */
-		for(i=1; i < n-1; i++) {
-			write_subtree_to_stream(node->neigh[(direction_to_exclude+i) % n], node, stream); /* a son */
-			putc(',', stream);
+	Node** stack_node = (Node**) malloc(capacity * sizeof(Node*));
+	int* stack_dir = (int*) malloc(capacity * sizeof(int));
+	int* stack_next = (int*) malloc(capacity * sizeof(int));
+	stack_node[0] = node;
+	stack_dir[0] = dir_a_to_b(node, node_from);
+	stack_next[0] = 1;
+
+	while (top > 0) {
+		Node* current = stack_node[top-1];
+		int n = current->nneigh, direction_to_exclude = stack_dir[top-1], i = stack_next[top-1];
+
+		if(n == 1) {
+			/* terminal node */
+			fprintf(stream, "%s:%f", (current->name ? current->name : ""), current->br[0]->brlen); /* distance to father */
+			top--;
+		} else if (i < n) {
+			/* we have to write (n-1) subtrees in total. The last print is not followed by a comma */
+			putc(i == 1 ? '(' : ',', stream);
+			stack_next[top-1]++;
+			if (top == capacity) {
+				capacity *= 2;
+				stack_node = (Node**) realloc(stack_node, capacity * sizeof(Node*));
+				stack_dir = (int*) realloc(stack_dir, capacity * sizeof(int));
+				stack_next = (int*) realloc(stack_next, capacity * sizeof(int));
+			}
+			Node* son = current->neigh[(direction_to_exclude+i) % n];
+			stack_node[top] = son;
+			stack_dir[top] = dir_a_to_b(son, current);
+			stack_next[top] = 1;
+			top++;
+		} else {
+			putc(')', stream);
+			fprintf(stream, "%s:%f", (current->name ? current->name : ""), current->br[0]->brlen); /* distance to father */
+			top--;
 		}
-		write_subtree_to_stream(node->neigh[(direction_to_exclude+i) % n], node, stream); /* last son */
-		putc(')', stream);
-		fprintf(stream, "%s:%f", (node->name ? node->name : ""), node->br[0]->brlen); /* distance to father */
 	}
 
+	free(stack_node);
+	free(stack_dir);
+	free(stack_next);
 } /* end write_subtree_to_stream */
 		
 
@@ -2131,7 +2441,10 @@ void free_node(Node* node) {
 
 void free_tree(Tree* tree) {
 	if (tree == NULL) return;
+	/* everything is in the arena, which is reset (or freed) by its owner once the tree is not needed anymore */
+	if (tree->arena) return;
 	int i;
+	invalidate_post_order(tree);
 	for (i=0; i < tree->nb_nodes; i++) free_node(tree->a_nodes[i]);
 	for (i=0; i < tree->nb_edges; i++) free_edge(tree->a_edges[i]);
 	free(tree->a_nodes);
@@ -2191,12 +2504,11 @@ Tree * gen_rand_tree(int nbr_taxa, char **taxa_names){
   }
 
   my_tree->length_hashtables = (int) (my_tree->nb_taxa / ceil(log10((double)my_tree->nb_taxa)));
-  ntax = nbr_taxa;
   my_tree->taxname_lookup_table = build_taxname_lookup_table(my_tree);
   
   for(i_edge=0;i_edge<my_tree->nb_edges;i_edge++){
-    my_tree->a_edges[i_edge]->hashtbl[0] = create_id_hash_table(my_tree->length_hashtables);
-    my_tree->a_edges[i_edge]->hashtbl[1] = create_id_hash_table(my_tree->length_hashtables);
+    my_tree->a_edges[i_edge]->hashtbl[0] = create_id_hash_table(my_tree->nb_taxa);
+    my_tree->a_edges[i_edge]->hashtbl[1] = create_id_hash_table(my_tree->nb_taxa);
   }
 
   update_hashtables_post_alltree(my_tree);
@@ -2248,6 +2560,25 @@ LeafArray* allocateLA(int n) {
   return la;
 }
 
+/*
+Allocate a LeafArray of this size in the given arena (with malloc if arena is
+NULL).
+*/
+LeafArray* allocateLA_in_arena(Arena* arena, int n) {
+  if(arena == NULL)
+    return allocateLA(n);
+
+  LeafArray *la = arena_alloc(arena, sizeof(LeafArray));
+  if(n)
+    la->a = arena_calloc(arena, n, sizeof(Node*));
+  else
+    la->a = NULL;
+
+  la->n = n;
+  la->i = 0;
+  return la;
+}
+
 
 /*
 Add a leaf to the leaf array.
@@ -2311,7 +2642,6 @@ LeafArray* concatinateLA(LeafArray *la1, LeafArray *la2, bool freemem) {
 void prepare_rapid_TI(Tree* mytree) {
 	prepare_rapid_TI_pre(mytree);  //Node depths for rapid Transfer Index (TI).
 	prepare_rapid_TI_post(mytree); //Node variables for rapid Transfer Index (TI).
-  sortLA(mytree->leaves);
 }
 
 
@@ -2394,14 +2724,15 @@ LeafArray* get_leaves_in_light_subtree(Node *u)
 Find the heaviest child of this node (set u->heavychild), set u->lightleaves
 to point to a LeafArray with all leaves not in the heavychild.
 
-@warning  user responsible for memory of lightleaves (use freeLA())
+@warning  user responsible for memory of lightleaves (use freeLA()), unless
+          they are allocated in an arena
 */
-void setup_heavy_light_subtrees(Node *u)
+void setup_heavy_light_subtrees(Node *u, Arena *arena)
 {
   if(u->nneigh == 1)           //leaf
   {
     u->heavychild = NULL;
-    u->lightleaves = allocateLA(0);
+    u->lightleaves = allocateLA_in_arena(arena, 0);
     return;
   }
 
@@ -2415,16 +2746,18 @@ void setup_heavy_light_subtrees(Node *u)
   {
     if(u->heavychild->subtreesize < u->neigh[i]->subtreesize)
       u->heavychild = u->neigh[i];
-    i++;
   }
 
-    //Concatinate LeafArrays from light children:
-  u->lightleaves = allocateLA(0);
+    //Concatinate the leaves from light children, in a single LeafArray:
+  int nblight = 0;
   for(int i = startind; i < u->nneigh; i++)
     if(u->neigh[i] != u->heavychild)
-      u->lightleaves = concatinateLA(u->lightleaves,
-                                     get_leaves_in_subtree(u->neigh[i]),
-                                     true);
+      nblight += u->neigh[i]->subtreesize;
+
+  u->lightleaves = allocateLA_in_arena(arena, nblight);
+  for(int i = startind; i < u->nneigh; i++)
+    if(u->neigh[i] != u->heavychild)
+      add_leaves_in_subtree(u->neigh[i], u->lightleaves);
 }
 
 
@@ -2442,24 +2775,35 @@ LeafArray* get_leaves_in_subtree(Node *u)
 }
 
 /*
-Add a leave to the leafarray, otherwise recurse.
+Add the leaves of the subtree of u to the leafarray, in the order of a recursive
+traversal.  The subtree is walked with the parent pointers (neigh[0]), without
+recursing and without a stack: going down to the first leaf, and then up to the
+next sibling.
 */
 void add_leaves_in_subtree(Node *u, LeafArray *leafarray)
 {
-  if(u->nneigh == 1)  //leaf
-  {
-    addLeafLA(leafarray, u);
-    return;
-  }
-  if(u->depth == 0)   //root
-  {
-    add_leaves_in_subtree(u->neigh[0], leafarray);
-    add_leaves_in_subtree(u->neigh[0], leafarray);
-  }
-  else
+  Node *w = u;
+  while(1)
   {
-    add_leaves_in_subtree(u->neigh[1], leafarray);
-    add_leaves_in_subtree(u->neigh[2], leafarray);
+    while(w->nneigh != 1)                       //Down to the first leaf
+      w = w->neigh[w->depth == 0 ? 0 : 1];
+    addLeafLA(leafarray, w);
+
+    while(w != u)                               //Up to the next sibling
+    {
+      Node *p = w->neigh[0];
+      int i = p->depth == 0 ? 0 : 1;
+      while(p->neigh[i] != w)
+        i++;
+      if(i+1 < p->nneigh)
+      {
+        w = p->neigh[i+1];
+        break;
+      }
+      w = p;
+    }
+    if(w == u)
+      return;
   }
 }
 
@@ -2531,7 +2875,7 @@ void prepare_rapid_TI_doer(Node* target, Node* orig, Tree* t) {
   target->d_lazy = target->subtreesize;
   target->d_max = target->subtreesize;
   target->d_min = 1;
-  setup_heavy_light_subtrees(target);
+  setup_heavy_light_subtrees(target, t->arena);
 }
 
 
@@ -2542,7 +2886,9 @@ all Nodes in the tree.
 @warning  assumes binary rooted tree.
 */
 void prepare_rapid_TI_post(Tree* tree) {
-  post_order_traversal(tree, &prepare_rapid_TI_doer);
+  Node **order = get_post_order(tree);
+  for(int i=0; i < tree->nb_nodes; i++)
+    prepare_rapid_TI_doer(order[i], tree->post_order_from[i], tree);
 }
 
 
@@ -2563,14 +2909,6 @@ void print_node(const Node* n) {
   fprintf(stderr, "node id: %i name: %s |L|: %i depth: %i\n", n->id,
           name, n->subtreesize, n->depth);
 }
-void print_node_TI(const Node* n) {
-  char *name = "----";
-  if(n->nneigh == 1)  //a leaf
-    name = n->name;
-  fprintf(stderr,
-          "node id: %i name: %s |L|: %i depth: %i TImin: %i TImax: %i\n",
-          n->id, name, n->subtreesize, n->depth, n->ti_min, n->ti_max);
-}
 
 void print_node_TIvars(const Node* n) {
   fprintf(stderr, "d_min: %i d_max: %i d_lazy: %i diff: %i\n", n->d_min,
@@ -2586,16 +2924,6 @@ void print_nodes(Node **nodes, const int n)
   for(int i=0; i < n; i++)
     print_node(nodes[i]);
 }
-/*
-Print the nodes from the given Node* array (with the transfer index).
-*/
-void print_nodes_TI(Node **nodes, const int n)
-{
-  fprintf(stderr, "Nodes:\n");
-  for(int i=0; i < n; i++)
-    print_node_TI(nodes[i]);
-}
-
 /*
 Print the TI variables for the given nodes from alt_tree.
 */
@@ -2649,7 +2977,7 @@ Return <0 if n1 should go before, 0 if equal, and 1 if n1 should go after n2.
 */
 int compare_nodes_bitarray(const void *l1, const void *l2) {
     //Test the relationship between succesive longs:
-  for(int chunk = 0; chunk < nbchunks_bitarray; chunk++) {
+  for(int chunk = 0; chunk < nbchunks_bitarray((*(Node**)l1)->br[0]->hashtbl[1]->nb_taxa); chunk++) {
     unsigned long chunk1 = (*(Node**)l1)->br[0]->hashtbl[1]->bitarray[chunk];
     unsigned long chunk2 = (*(Node**)l2)->br[0]->hashtbl[1]->bitarray[chunk];
     if(chunk1 < chunk2)
@@ -2717,6 +3045,7 @@ Node* reroot_tree_at(Tree *t, Node *l) {
 	Node* oldroot = t->node0;
 	Node* newroot = new_node("root", t, 2);
 	t->node0 = newroot;
+	invalidate_post_order(t);
 	
 	Edge* edge = l->br[0];       //The parent branch to the leaf
   edge->right = edge->left;
@@ -29,6 +29,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "hashtables_bfields.h"	/* for the hashtables to store taxa names on the branches */
 #include "hashmap.h"
 #include "io.h"
+#include "arena.h"
 #include <ctype.h>
 #include <stdbool.h>
 #include <string.h>
@@ -68,6 +69,7 @@ typedef struct __Node {
 	char* name;       /* Only set if this is a leaf node. */
 	char* comment;		/* for further use: store any comment (e.g. from NHX format) */
 	int id;			      /* unique id attributed to the node (index of node into a_nodes array*/
+	int taxon_id;		/* for a leaf, index of its name in the taxname lookup table (see set_leaf_taxon_ids), -1 if unknown */
 	short int nneigh;	/* number of neighbours */
 	struct __Node** neigh;	/* neighbour nodes */
 	struct __Edge** br;	/* corresponding branches going from this node */
@@ -82,9 +84,8 @@ typedef struct __Node {
    int d_min;       // Minimum TI found in this subtree
    int d_max;       // Maximum TI found in this subtree (used for unrooted TI)
 
-         // Variables used for rapid transfer index calculation on ref_tree:
-   int ti_min;       // The (rooted) transfer index for this node.
-   int ti_max;       // The (rooted) maximum transfer distance for this subtree.
+         // Variables used for rapid transfer index calculation on ref_tree
+         // (the values computed for an alt_tree are in a RapidTIContext):
    LeafArray* lightleaves;   // The leaves in the light children.
    Node* heavychild; // The heaviest child
    Node* other;      // Corresponding leaf in another tree (see set_leaf_bijection())
@@ -110,9 +111,6 @@ typedef struct __Edge {
 				      		   we then immediately set the branch length to MIN_BRLEN */
 	short int has_branch_support; 	
 	int topo_depth;				/* the topological depth is the number of taxa on the lightest side of the bipar */
-
-         // Variables used for rapid transfer index calculation on ref_tree:
-   int transfer_index;  // The (unrooted) transfer index for this edge.
 } Edge;
 
 
@@ -132,6 +130,11 @@ typedef struct __Tree {
 
          // Variables used for rapid transfer index calculation:
 	LeafArray* leaves;	           // array of Node pointers sorted by name
+
+	Node** post_order;	/* the nodes in post-order from node0 (see get_post_order), NULL until it is computed */
+	Node** post_order_from;	/* post_order_from[i] is the neighbour of post_order[i] towards node0, NULL for node0 */
+
+	Arena* arena;	/* if not NULL, all the structures of the tree are allocated in this arena */
 } Tree;
 	
 
@@ -167,10 +170,6 @@ Node* graft_new_node_on_branch(Edge* target_edge, Tree* tree, double ratio_from_
 the rapid Transfer Index.
 */
 Tree* copy_tree_rapidTI(Tree* t);
-/* Copy the children of the old Node to the new Node.
-@warning  assumes new is already innitialized with copy_node_rapidTI()
-*/
-Tree* copy_tree_rapidTI_rec(Tree* t, Node* oldn, Node* newn);
 /* Copy the Edge data essential to the rapid Transfer Index calculations.
 */
 Edge* copy_edge_rapidTI(Edge *old, Node *parent, Node *child);
@@ -229,7 +228,6 @@ void unrooted_to_rooted(Tree* t);
 
 /* To be called after a reroot*/
 void reorient_edges(Tree *t);
-void reorient_edges_recur(Node *n, Node *prev, Edge *e);
 
 /* utility functions to deal with NH files */
 unsigned int tell_size_of_one_tree(char* filename);
@@ -239,17 +237,44 @@ int copy_nh_stream_into_str(FILE* nh_stream, char* big_string);
 void process_name_and_brlen(Node* son_node, Edge* edge, Tree* current_tree, char* in_str, int begin, int end);
 Node* create_son_and_connect_to_father(Node* current_node, Tree* current_tree, int direction, char* in_str, int begin, int end);
 void parse_substring_into_node(char* in_str, int begin, int end, Node* current_node, int has_father, Tree* current_tree);
+/* linear-time, non-recursive equivalent of parse_substring_into_node for the whole tree.
+   Returns 0 without building anything if the string has to be parsed by parse_substring_into_node */
+int parse_substring_into_tree_linear(char* in_str, int begin, int end, Tree* current_tree);
 Tree* parse_nh_string(char* in_str);
-
-/* complete parse tree: parse NH string, update hashtables and subtype counts */
+/* same as parse_nh_string, on the length first chars of a buffer that needs not be null-terminated.
+   If arena is not NULL, the whole tree is allocated in it: free_tree() then does nothing, the arena has to be reset instead.
+   The edges have no hashtables (hashtbl[0] and hashtbl[1] are NULL). */
+Tree* parse_nh_buffer(char* in_str, int length, Arena* arena);
+/* the parsers of parse_nh_buffer, that can be chosen to compare them (see unit_tests.c): NH_PARSER_ANY is the
+   linear parser, or the recursive one where the linear one gives up, NH_PARSER_LINEAR only the linear one
+   (NULL where it gives up), NH_PARSER_RECURSIVE only parse_substring_into_node */
+typedef enum { NH_PARSER_ANY, NH_PARSER_LINEAR, NH_PARSER_RECURSIVE } nh_parser_t;
+Tree* parse_nh_buffer_with(char* in_str, int length, Arena* arena, nh_parser_t parser);
+
+/* complete parse tree: parse NH string, update hashtables and subtype counts.
+   With skip_hashtables, no hashtable is ever created (the memory stays linear in the number of taxa):
+   the subtree sizes and topological depths are then only set by prepare_rapid_TI. */
 Tree *complete_parse_nh(char* big_string, char*** taxname_lookup_table,
                         bool skip_hashtables);
+/* same as complete_parse_nh, on the length first chars of a buffer that needs not be null-terminated,
+   possibly in an arena (see parse_nh_buffer).
+   taxid_map is the hashmap of the taxname lookup table (see build_taxid_hashmap) used to set the taxon ids of
+   the leaves. If NULL, a temporary one is built for this tree. */
+Tree *complete_parse_nh_buffer(char* buffer, int length, char*** taxname_lookup_table, map_t taxid_map,
+                               bool skip_hashtables, Arena* arena);
+/* the steps of complete_parse_nh_buffer that follow the parsing, once the taxon ids of the leaves are set:
+   bootstrap supports from the node names, bitsets on the edges and node heights (unless skip_hashtables),
+   and preparation of the rapid transfer index */
+void prepare_parsed_tree(Tree* tree, bool skip_hashtables);
 
 
 /* taxname lookup table functions */
 char** build_taxname_lookup_table(Tree* tree);
 map_t build_taxid_hashmap(char** taxname_lookup_table, int nb_taxa);
 void free_taxid_hashmap(map_t taxmap);
+/* sets the taxon_id of all the leaves of the tree from their names, looked up in taxid_map:
+   -1 for the names that are not in it */
+void set_leaf_taxon_ids(Tree* tree, map_t taxid_map);
 int free_hashmap_data(any_t arg,any_t key, any_t elemt);
 
 char** get_taxname_lookup_table(Tree* tree);
@@ -262,6 +287,13 @@ void regraft_branch_on_node(Edge* branch, Node* target_node, int dir);
   ******************* neatly implementing tree traversals ******
 ***************************************************************/
 
+/* None of the traversals recurses. The post-order of the whole tree is computed once (with an explicit stack),
+   and kept in tree->post_order: a pre-order is the same array, read backwards (the sons of a node are then
+   visited from the last one).  The functions that modify the structure of the tree drop it with
+   invalidate_post_order(); get_post_order() computes it again. */
+Node** get_post_order(Tree* tree);
+void invalidate_post_order(Tree* tree);
+
 void post_order_traversal_recur(Node* current, Node* origin, Tree* tree, void (*func)(Node*, Node*, Tree*));
 void post_order_traversal(Tree* t, void (*func)(Node*, Node*, Tree*));
 
@@ -312,8 +344,8 @@ void update_hashtables_pre_alltree(Tree* tree);
 void update_i_c_post_order_ref_tree(Tree* ref_tree, Node* orig, Node* target, Tree* boot_tree, short unsigned** i_matrix, short unsigned** c_matrix);
 void update_all_i_c_post_order_ref_tree(Tree* ref_tree, Tree* boot_tree, short unsigned** i_matrix, short unsigned** c_matrix);
 
-void update_i_c_post_order_boot_tree(Tree* ref_tree, Tree* boot_tree, Node* orig, Node* target, short unsigned** i_matrix, short unsigned** c_matrix, short unsigned** hamming, short unsigned* min_dist, short unsigned* min_dist_edge);
-void update_all_i_c_post_order_boot_tree(Tree* ref_tree, Tree* boot_tree, short unsigned** i_matrix, short unsigned** c_matrix, short unsigned** hamming, short unsigned* min_dist, short unsigned* min_dist_edge);
+void update_i_c_post_order_boot_tree(Tree* ref_tree, Tree* boot_tree, Node* orig, Node* target, short unsigned** i_matrix, short unsigned** c_matrix, short unsigned* min_dist, short unsigned* min_dist_edge);
+void update_all_i_c_post_order_boot_tree(Tree* ref_tree, Tree* boot_tree, short unsigned** i_matrix, short unsigned** c_matrix, short unsigned* min_dist, short unsigned* min_dist_edge);
 
 
 /*Generate Random Tree*/
@@ -355,6 +387,10 @@ typedef struct __LeafArray {
 */
 LeafArray* allocateLA(int n);
 
+/* Allocate a LeafArray of this size in the arena (or with malloc if arena is NULL).
+*/
+LeafArray* allocateLA_in_arena(Arena* arena, int n);
+
 /* Add a leaf to the leaf array.
 */
 void addLeafLA(LeafArray *la, Node *u);
@@ -405,7 +441,7 @@ to point to a LeafArray with all leaves not in the heavychild.
 
 @warning  user responsible for memory of u->lightleaves (use freeLA())
 */
-void setup_heavy_light_subtrees(Node *u);
+void setup_heavy_light_subtrees(Node *u, Arena *arena);
 
 
 /* Return a list of Node pointers to the leaves of this subtree.
@@ -415,7 +451,7 @@ void setup_heavy_light_subtrees(Node *u);
 LeafArray* get_leaves_in_subtree(Node *u);
 
 
-/* Add a leave to the leafarray, otherwise recurse.
+/* Add the leaves of the subtree of u to the leafarray (without recursing).
 */
 void add_leaves_in_subtree(Node *u, LeafArray *leafarray);
 
@@ -450,7 +486,6 @@ void prepare_rapid_TI_post(Tree* tree);
 void print_nodes_post_order(Tree* t);
 void print_node_callback(Node* n, Node* m, Tree* t);
 void print_node(const Node* n);
-void print_node_TI(const Node* n);
 /* Print TI variables for a node in alt_tree.
 */
 void print_node_TIvars(const Node* n);
@@ -458,9 +493,6 @@ void print_node_TIvars(const Node* n);
 /* Print the nodes from the given Node* array.
 */
 void print_nodes(Node **nodes, const int n);
-/* Print the nodes from the given Node* array (with the transfer index).
-*/
-void print_nodes_TI(Node **nodes, const int n);
 /* Print the TI variables for the given nodes from alt_tree.
 */
 void print_nodes_TIvars(Node **nodes, const int n);
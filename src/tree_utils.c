@@ -67,8 +67,8 @@ Tree* gen_random_tree(Tree *tree){
 
   int e;
   for(e=0;e<my_tree->nb_edges;e++){
-    my_tree->a_edges[e]->hashtbl[0] = create_id_hash_table(my_tree->length_hashtables);
-    my_tree->a_edges[e]->hashtbl[1] = create_id_hash_table(my_tree->length_hashtables);
+    my_tree->a_edges[e]->hashtbl[0] = create_id_hash_table(my_tree->nb_taxa);
+    my_tree->a_edges[e]->hashtbl[1] = create_id_hash_table(my_tree->nb_taxa);
   }
 
   /* write_nh_tree(my_tree,stdout); */
@@ -0,0 +1,609 @@
+/*
+
+BOOSTER: BOOtstrap Support by TransfER: 
+BOOSTER is an alternative method to compute bootstrap branch supports 
+in large trees. It uses transfer distance between bipartitions, instead
+of perfect match.
+
+Copyright (C) 2017 Frederic Lemoine, Jean-Baka Domelevo Entfellner, Olivier Gascuel
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+*/
+
+/* Unit tests of the kernels that have several implementations (parsers, vector kernels), which must give the
+   same results, and of the partial result files and binary bootstrap sets: make check.
+   Each test returns EXIT_SUCCESS, or prints what differs and returns EXIT_FAILURE. */
+
+#include "tree.h"
+#include "hamming_simd.h"
+#include "bitset_simd.h"
+#include "partial_result.h"
+#include "bin_trees.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+
+/* name of a tree in the messages of the tests */
+#define SHOWN_LENGTH 60
+
+static int same_string(const char* a, const char* b) {
+  return (a == NULL || b == NULL) ? a == b : !strcmp(a, b);
+}
+
+/* whether the trees t1 and t2 built by two parsers are the same: same nodes and edges with the same ids,
+   names, directions and branch lengths. Prints the first difference */
+static int same_parsed_trees(const Tree* t1, const Tree* t2, const char* nh){
+  int i, j;
+  if(t1->nb_nodes != t2->nb_nodes || t1->nb_edges != t2->nb_edges || t1->nb_taxa != t2->nb_taxa
+     || t1->next_avail_taxon_id != t2->next_avail_taxon_id){
+    fprintf(stderr,"%.*s: %d/%d nodes, %d/%d edges, %d/%d taxa\n", SHOWN_LENGTH, nh, t1->nb_nodes, t2->nb_nodes,
+            t1->nb_edges, t2->nb_edges, t1->next_avail_taxon_id, t2->next_avail_taxon_id);
+    return 0;
+  }
+  for(i = 0; i < t1->next_avail_taxon_id; i++)
+    if(strcmp(t1->taxa_names[i], t2->taxa_names[i])){
+      fprintf(stderr,"%.*s: taxon %d is %s/%s\n", SHOWN_LENGTH, nh, i, t1->taxa_names[i], t2->taxa_names[i]);
+      return 0;
+    }
+  for(i = 0; i < t1->nb_nodes; i++){
+    const Node *n1 = t1->a_nodes[i], *n2 = t2->a_nodes[i];
+    int ok = n1->id == n2->id && n1->nneigh == n2->nneigh && same_string(n1->name, n2->name)
+      && same_string(n1->comment, n2->comment);
+    for(j = 0; ok && j < n1->nneigh; j++)
+      ok = n1->neigh[j]->id == n2->neigh[j]->id && n1->br[j]->id == n2->br[j]->id;
+    if(!ok){
+      fprintf(stderr,"%.*s: node %d differs (%s/%s)\n", SHOWN_LENGTH, nh, i, n1->name, n2->name);
+      return 0;
+    }
+  }
+  for(i = 0; i < t1->nb_edges; i++){
+    const Edge *e1 = t1->a_edges[i], *e2 = t2->a_edges[i];
+    if(e1->id != e2->id || e1->left->id != e2->left->id || e1->right->id != e2->right->id
+       || e1->brlen != e2->brlen || e1->had_zero_length != e2->had_zero_length){
+      fprintf(stderr,"%.*s: edge %d differs\n", SHOWN_LENGTH, nh, i);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* exit status of parse_nh_buffer_with(nh, parser), run in a child process: the parsers exit on some errors.
+   -1 if it was killed by a signal. */
+static int parser_exit_status(const char* nh, nh_parser_t parser){
+  pid_t pid;
+  int status;
+  fflush(stderr);
+  if((pid = fork()) == 0){
+    Arena *arena = arena_new(1 << 16);
+    if(freopen("/dev/null", "w", stderr) == NULL) exit(2);
+    exit(parse_nh_buffer_with((char*) nh, (int) strlen(nh), arena, parser) == NULL ? 3 : EXIT_SUCCESS);
+  }
+  if(pid < 0 || waitpid(pid, &status, 0) != pid) return -1;
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+/* The linear parser (parse_substring_into_tree_linear) builds the same trees as the recursive one, and gives up
+   on the inputs it leaves to the recursive one, which then behaves as it always did */
+int test_linear_parser(){
+  const char* parsed[] = { /* by the linear parser */
+    "(a,b,c);",
+    "((a:1,b:2):3,c:0.5,d:1e-3);",
+    "((a:0,b:0.0):0,(c,d));",
+    "((a,b)0.95:0.1,(c,d)87:1.5,(e,f)inner_name)root:0.2;",
+    "( ( a : 1 ,\n b:2 ) :3 ,\tc , d ) ;",
+    "('taxon one':1,\"taxon two\":2,(c[&&NHX:S=x]:1,d[comment]:2)[&support=1]:0.5);",
+    "(a,b,c,d,e,(f,g,h,i),(j,(k,l,m)));",
+    "((((((a,b),c),d),e),f),g);",
+  };
+  const char* fallbacks[] = { /* left by the linear parser to the recursive one */
+    "((a:1):2,b,c);",		/* single son */
+    "(a,b,(c));",		/* single son, a leaf */
+    "(((a,b)),c,d);",		/* single son, an internal node */
+    "(a,,b);",			/* empty leaf */
+    "(a,b,(c,));",		/* empty leaf at the end of a node */
+    "((a,b),c));",		/* one closing parenthesis too many */
+    "((a,b),(c,d);",		/* one missing */
+  };
+  int i, nb_parsed = sizeof(parsed) / sizeof(char*), nb_fallbacks = sizeof(fallbacks) / sizeof(char*);
+  Arena *arena = arena_new(1 << 16);
+
+  for(i = 0; i < nb_parsed; i++){
+    char *nh = (char*) parsed[i];
+    arena_reset(arena);
+    Tree *linear = parse_nh_buffer_with(nh, (int) strlen(nh), arena, NH_PARSER_LINEAR);
+    Tree *recursive = parse_nh_buffer_with(nh, (int) strlen(nh), arena, NH_PARSER_RECURSIVE);
+    if(linear == NULL || recursive == NULL){
+      fprintf(stderr,"Linear parser Test: %s not parsed by the %s parser\n", nh, linear == NULL ? "linear" : "recursive");
+      arena_free(arena);
+      return EXIT_FAILURE;
+    }
+    if(!same_parsed_trees(linear, recursive, nh)){
+      fprintf(stderr,"Linear parser Test: the linear and recursive parsers differ\n");
+      arena_free(arena);
+      return EXIT_FAILURE;
+    }
+  }
+  arena_free(arena);
+
+  for(i = 0; i < nb_fallbacks; i++){
+    int linear = parser_exit_status(fallbacks[i], NH_PARSER_LINEAR);
+    int any = parser_exit_status(fallbacks[i], NH_PARSER_ANY);
+    int recursive = parser_exit_status(fallbacks[i], NH_PARSER_RECURSIVE);
+    if(linear != 3){
+      fprintf(stderr,"Linear parser Test: %s should be left to the recursive parser (status %d)\n", fallbacks[i], linear);
+      return EXIT_FAILURE;
+    }
+    /* none of these is a tree: the recursive parser rejects them, without crashing */
+    if(any != EXIT_FAILURE || recursive != EXIT_FAILURE){
+      fprintf(stderr,"Linear parser Test: %s gives the status %d/%d instead of %d\n", fallbacks[i], any, recursive, EXIT_FAILURE);
+      return EXIT_FAILURE;
+    }
+  }
+  fprintf(stderr,"Linear parser Test: OK\n");
+  return EXIT_SUCCESS;
+}
+
+
+/* the vector kernels, in the order they are preferred, by all the platforms: the unsupported ones are skipped */
+static const char* hamming_levels[] = { "avx512", "avx2", "sse4.1", "neon" };
+static const char* bitset_levels[] = { "avx2", "popcnt", "neon" };
+#define NB_HAMMING_LEVELS 4
+#define NB_BITSET_LEVELS 3
+
+static void* aligned_cells(int len, size_t cell_size){
+  void *cells = NULL;
+  if(posix_memalign(&cells, 64, len * cell_size) != 0){
+    fprintf(stderr,"Out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  return cells;
+}
+
+/* random cells of the Hamming rows for nb_taxa taxa: the sizes of the clusters (card and c_row) and of their
+   intersections (i_row), such that their union has at most nb_taxa taxa */
+static void random_hamming_rows(int len, int nb_taxa, unsigned int* card, unsigned int* c_row, unsigned int* i_row){
+  int i;
+  for(i = 0; i < len; i++){
+    unsigned int low;
+    card[i] = rand() % (nb_taxa + 1);
+    c_row[i] = rand() % (nb_taxa + 1);
+    low = card[i] + c_row[i] > (unsigned int) nb_taxa ? card[i] + c_row[i] - nb_taxa : 0;
+    i_row[i] = low + rand() % ((card[i] < c_row[i] ? card[i] : c_row[i]) - low + 1);
+  }
+}
+
+/* The vector kernels of hamming_simd.c supported by the cpu give the same rows as the scalar ones, for rows of
+   any number of edges (the rows are padded to 64 bytes, see tbe_workspace.h) */
+int test_hamming_kernels(){
+  const int nb_edges[] = { 1, 7, 15, 16, 17, 31, 33, 100, 257, 1000 };
+  int l, k, i, nb_tested = 0;
+  srand(1);
+  for(l = 0; l < NB_HAMMING_LEVELS; l++){
+    if(!hamming_use_kernels(hamming_levels[l])) continue;
+    nb_tested++;
+    for(k = 0; k < (int) (sizeof(nb_edges) / sizeof(int)); k++){
+      int len = (nb_edges[k] + 31) / 32 * 32; /* 32 cells of 16 bits, or 2 x 16 cells of 32 bits: 64 bytes */
+      int nb_taxa = 2 + rand() % 3000, edge_id = rand() % 60000;
+      unsigned int *card = aligned_cells(len, sizeof(int)), *c_row = aligned_cells(len, sizeof(int));
+      unsigned int *i_row = aligned_cells(len, sizeof(int));
+      unsigned int *dist32[2], *edge32[2], *sum32[2];
+      unsigned short *card16 = aligned_cells(len, sizeof(short)), *c16 = aligned_cells(len, sizeof(short));
+      unsigned short *i16 = aligned_cells(len, sizeof(short));
+      unsigned short *dist16[2], *edge16[2], *sum16[2];
+      int v, ok = 1;
+      random_hamming_rows(len, nb_taxa, card, c_row, i_row);
+      for(v = 0; v < 2; v++){
+        dist32[v] = aligned_cells(len, sizeof(int)); edge32[v] = aligned_cells(len, sizeof(int)); sum32[v] = aligned_cells(len, sizeof(int));
+        dist16[v] = aligned_cells(len, sizeof(short)); edge16[v] = aligned_cells(len, sizeof(short)); sum16[v] = aligned_cells(len, sizeof(short));
+      }
+      for(i = 0; i < len; i++){
+        card16[i] = card[i]; c16[i] = c_row[i]; i16[i] = i_row[i];
+        dist32[0][i] = dist32[1][i] = dist16[0][i] = dist16[1][i] = rand() % (nb_taxa / 2 + 1);
+        edge32[0][i] = edge32[1][i] = edge16[0][i] = edge16[1][i] = rand() % 60000;
+        sum32[0][i] = sum32[1][i] = sum16[0][i] = sum16[1][i] = rand() % 30000;
+      }
+      /* v = 0: scalar, v = 1: the vector kernels */
+      for(v = 0; v < 2; v++){
+        hamming_use_kernels(v == 0 ? "scalar" : hamming_levels[l]);
+        hamming_min_row(card16, c16, i16, nb_taxa, edge_id, dist16[v], edge16[v], len);
+        hamming_min_row32(card, c_row, i_row, nb_taxa, edge_id, dist32[v], edge32[v], len);
+        hamming_add_rows(sum16[v], c16, len);
+        hamming_add_rows32(sum32[v], c_row, len);
+      }
+      for(i = 0; i < len && ok; i++)
+        ok = dist16[0][i] == dist16[1][i] && edge16[0][i] == edge16[1][i] && sum16[0][i] == sum16[1][i]
+          && dist32[0][i] == dist32[1][i] && edge32[0][i] == edge32[1][i] && sum32[0][i] == sum32[1][i];
+      free(card); free(c_row); free(i_row); free(card16); free(c16); free(i16);
+      for(v = 0; v < 2; v++){
+        free(dist32[v]); free(edge32[v]); free(sum32[v]); free(dist16[v]); free(edge16[v]); free(sum16[v]);
+      }
+      if(!ok){
+        fprintf(stderr,"Hamming kernels Test: the %s kernels differ from the scalar ones at cell %d of %d edges\n",
+                hamming_levels[l], i - 1, nb_edges[k]);
+        return EXIT_FAILURE;
+      }
+    }
+  }
+  fprintf(stderr,"Hamming kernels Test (%d vector kernels): OK\n", nb_tested);
+  return EXIT_SUCCESS;
+}
+
+static unsigned long random_word(){
+  unsigned long w = 0;
+  int i;
+  for(i = 0; i < (int) sizeof(unsigned long); i++) w = (w << 8) | (rand() & 0xff);
+  return w;
+}
+
+/* The vector kernels of bitset_simd.c supported by the cpu give the same counts as the scalar ones, for any
+   number of bits, whatever the bits beyond it */
+int test_bitset_kernels(){
+  const int word_bits = 8 * sizeof(unsigned long);
+  int l, nbits, i, nb_tested = 0;
+  srand(2);
+  for(l = 0; l < NB_BITSET_LEVELS; l++){
+    if(!bitset_use_kernels(bitset_levels[l])) continue;
+    nb_tested++;
+    for(nbits = 1; nbits <= 20 * word_bits; nbits += 1 + rand() % 37){
+      int nwords = (nbits + word_bits - 1) / word_bits, v;
+      unsigned long *a = malloc(nwords * sizeof(unsigned long)), *b = malloc(nwords * sizeof(unsigned long));
+      unsigned long *dst[2];
+      int xor_count[2], added[2];
+      for(i = 0; i < nwords; i++){
+        a[i] = random_word();
+        b[i] = (rand() % 4 == 0) ? a[i] : random_word(); /* some equal words */
+      }
+      for(v = 0; v < 2; v++){
+        dst[v] = malloc(nwords * sizeof(unsigned long));
+        memcpy(dst[v], b, nwords * sizeof(unsigned long));
+        bitset_use_kernels(v == 0 ? "scalar" : bitset_levels[l]);
+        xor_count[v] = bitset_xor_count(a, b, nbits);
+        added[v] = bitset_or_count_added(dst[v], a, nwords);
+      }
+      i = xor_count[0] == xor_count[1] && added[0] == added[1] && !memcmp(dst[0], dst[1], nwords * sizeof(unsigned long));
+      free(a); free(b); free(dst[0]); free(dst[1]);
+      if(!i){
+        fprintf(stderr,"Bitset kernels Test: the %s kernels differ from the scalar ones on %d bits\n", bitset_levels[l], nbits);
+        return EXIT_FAILURE;
+      }
+    }
+  }
+  fprintf(stderr,"Bitset kernels Test (%d vector kernels): OK\n", nb_tested);
+  return EXIT_SUCCESS;
+}
+
+
+/* whether the results a and b hold the same values */
+static int same_partial_results(const PartialResult* a, const PartialResult* b){
+  int i, j;
+  if(strcmp(a->algo, b->algo) || a->nb_taxa != b->nb_taxa || a->nb_edges != b->nb_edges || a->fingerprint != b->fingerprint
+     || a->num_trees != b->num_trees || a->trees_read != b->trees_read || a->has_squares != b->has_squares
+     || a->has_stats != b->has_stats || a->has_per_branch != b->has_per_branch)
+    return 0;
+  for(i = 0; i < a->nb_edges; i++)
+    if(a->sums[i] != b->sums[i] || (a->has_squares && a->sums_sq[i] != b->sums_sq[i])) return 0;
+  for(j = 0; a->has_stats && j < a->nb_taxa; j++)
+    if(a->moved_species_counts[j] != b->moved_species_counts[j]) return 0;
+  for(i = 0; a->has_per_branch && i < a->nb_edges; i++)
+    for(j = 0; j < a->nb_taxa; j++)
+      if(a->moved_species_counts_per_branch[i][j] != b->moved_species_counts_per_branch[i][j]) return 0;
+  return 1;
+}
+
+/* a result of algo on ref_tree with random values */
+static PartialResult* random_partial_result(const char* algo, Tree* ref_tree, int stats, int per_branch){
+  PartialResult *res = new_partial_result(algo, ref_tree, stats, per_branch);
+  int i, j;
+  res->num_trees = 1 + rand() % 1000;
+  res->trees_read = 2 * res->num_trees + rand() % 10;
+  for(i = 0; i < res->nb_edges; i++){
+    res->sums[i] = rand() % 100000;
+    if(res->has_squares) res->sums_sq[i] = (long) rand() * 1000;
+  }
+  for(j = 0; res->has_stats && j < res->nb_taxa; j++) res->moved_species_counts[j] = rand() / (double) RAND_MAX * 1000;
+  for(i = 0; res->has_per_branch && i < res->nb_edges; i++)
+    for(j = 0; j < res->nb_taxa; j++) res->moved_species_counts_per_branch[i][j] = rand() % 1000;
+  return res;
+}
+
+/* exit status of run(filename), run in a child process whose stderr goes to the file errors: the functions
+   that read files exit on their errors. -1 if it was killed by a signal. */
+static int child_exit_status(void (*run)(const char*), const char* filename, const char* errors){
+  pid_t pid;
+  int status;
+  fflush(stderr);
+  if((pid = fork()) == 0){
+    if(freopen(errors, "w", stderr) == NULL) exit(2);
+    run(filename);
+    exit(EXIT_SUCCESS);
+  }
+  if(pid < 0 || waitpid(pid, &status, 0) != pid) return -1;
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static void run_read_partial_results(const char* filename){
+  int nb;
+  read_partial_results(filename, &nb);
+}
+
+/* whether the file holds the given text */
+static int file_contains(const char* filename, const char* text){
+  char buffer[4096];
+  FILE *f = fopen(filename, "r");
+  size_t nb = f ? fread(buffer, 1, sizeof(buffer) - 1, f) : 0;
+  if(f) fclose(f);
+  buffer[nb] = '\0';
+  return strstr(buffer, text) != NULL;
+}
+
+/* The partial result files (write_partial_results, read_partial_results) give back the results written, of the
+   current version and of the versions 1 and 2 that are still read, and their merge is the sum of the results.
+   A truncated file is rejected */
+int test_partial_results(){
+  char tree_string[] = "((a:1,b:1):1,(c:1,d:1):1,(e:1,(f:1,g:1):1):1);";
+  char **taxname_lookup_table = NULL;
+  char filename[] = "/tmp/booster_unit_tests_XXXXXX", errors[sizeof(filename) + 4];
+  Tree *ref_tree = complete_parse_nh(tree_string, &taxname_lookup_table, false);
+  PartialResult *written[3], **read, *merged;
+  int nb, i, j, fd, ok;
+  FILE *f;
+  srand(3);
+  if((fd = mkstemp(filename)) < 0){
+    fprintf(stderr,"Partial results Test: cannot create a temporary file\n");
+    return EXIT_FAILURE;
+  }
+  close(fd);
+  sprintf(errors, "%s.err", filename);
+
+  /* write -> read */
+  written[0] = random_partial_result("tbe", ref_tree, 1, 1);
+  written[1] = random_partial_result("rtbe", ref_tree, 1, 0);
+  written[2] = random_partial_result("fbp", ref_tree, 0, 0);
+  write_partial_results(written, 3, filename);
+  read = read_partial_results(filename, &nb);
+  ok = nb == 3;
+  for(i = 0; ok && i < 3; i++) ok = same_partial_results(written[i], read[i]);
+  if(!ok){
+    fprintf(stderr,"Partial results Test: the results read differ from the ones written\n");
+    return EXIT_FAILURE;
+  }
+
+  /* merge: the sums of both results, and the largest trees_read */
+  merged = random_partial_result("tbe", ref_tree, 1, 1);
+  merge_partial_result(read[0], merged);
+  ok = read[0]->num_trees == written[0]->num_trees + merged->num_trees
+    && read[0]->trees_read == (written[0]->trees_read > merged->trees_read ? written[0]->trees_read : merged->trees_read);
+  for(i = 0; ok && i < ref_tree->nb_edges; i++){
+    ok = read[0]->sums[i] == written[0]->sums[i] + merged->sums[i]
+      && read[0]->sums_sq[i] == written[0]->sums_sq[i] + merged->sums_sq[i];
+    for(j = 0; ok && j < ref_tree->nb_taxa; j++)
+      ok = read[0]->moved_species_counts_per_branch[i][j]
+        == written[0]->moved_species_counts_per_branch[i][j] + merged->moved_species_counts_per_branch[i][j];
+  }
+  for(j = 0; ok && j < ref_tree->nb_taxa; j++)
+    ok = read[0]->moved_species_counts[j] == written[0]->moved_species_counts[j] + merged->moved_species_counts[j];
+  free_partial_result(merged);
+  for(i = 0; i < 3; i++){
+    free_partial_result(written[i]);
+    free_partial_result(read[i]);
+  }
+  free(read);
+  if(!ok){
+    fprintf(stderr,"Partial results Test: the merged result is not the sum of the results\n");
+    return EXIT_FAILURE;
+  }
+
+  /* the files of the versions 1 (no trees read, no squares) and 2 (no squares) */
+  for(i = 1; i <= 2; i++){
+    f = fopen(filename, "w");
+    fprintf(f, "#booster partial result\nversion %d\nalgo rtbe\ntaxa 7\nedges 11\nfingerprint %llx\ntrees 5\n%s"
+            "stats 0\nper_branch 0\n", i, ref_tree_fingerprint(ref_tree), i == 1 ? "" : "read 9\n");
+    for(j = 0; j < 11; j++) fprintf(f, "%d\n", j);
+    fclose(f);
+    read = read_partial_results(filename, &nb);
+    ok = nb == 1 && !strcmp(read[0]->algo, "rtbe") && read[0]->num_trees == 5 && read[0]->trees_read == (i == 1 ? 0 : 9)
+      && !read[0]->has_squares && read[0]->sums_sq == NULL && !read[0]->has_stats && read[0]->sums[10] == 10;
+    free_partial_result(read[0]);
+    free(read);
+    if(!ok){
+      fprintf(stderr,"Partial results Test: the file of version %d is not read as it was written\n", i);
+      return EXIT_FAILURE;
+    }
+  }
+
+  /* a file cut in the middle of its sums */
+  written[0] = random_partial_result("fbp", ref_tree, 0, 0);
+  write_partial_results(written, 1, filename);
+  free_partial_result(written[0]);
+  {
+    char content[4096];
+    size_t length;
+    f = fopen(filename, "r");
+    length = fread(content, 1, sizeof(content), f);
+    fclose(f);
+    f = fopen(filename, "w");
+    fwrite(content, 1, length - 8, f); /* the last sums are missing */
+    fclose(f);
+  }
+  ok = child_exit_status(run_read_partial_results, filename, errors) == EXIT_FAILURE && file_contains(errors, "truncated sums");
+  unlink(filename);
+  unlink(errors);
+  for(i = 0; i < ref_tree->nb_taxa; i++) free(taxname_lookup_table[i]);
+  free(taxname_lookup_table);
+  free_tree(ref_tree);
+  if(!ok){
+    fprintf(stderr,"Partial results Test: a truncated file is not rejected\n");
+    return EXIT_FAILURE;
+  }
+  fprintf(stderr,"Partial results Test: OK\n");
+  return EXIT_SUCCESS;
+}
+
+static void run_nh_reader_open(const char* filename){
+  nh_reader_open(filename);
+}
+
+/* the next record of the binary bootstrap set, copied at an 8-byte aligned address where it can be modified.
+   Sets *length */
+static char* copy_bin_record(NHReader* reader, int* length){
+  char *record = nh_reader_next(reader, length), *copy;
+  if(record == NULL || posix_memalign((void**) &copy, 8, *length) != 0) return NULL;
+  memcpy(copy, record, *length);
+  nh_reader_release(reader, record);
+  return copy;
+}
+
+/* The trees of a binary bootstrap set (bin_trees.c) are the ones that were written, and the corrupted sets
+   are rejected: a misaligned index when the set is opened, a father after its son or a duplicate taxon when
+   the record is loaded */
+int test_bin_trees(){
+  char* trees[] = {
+    "((a:1,b:0):2,(c:0.5,d:1.5,e:1e-3):0,f:1);",
+    "(f:1,e:2,(d:3,(c:4,(b:5,a:6):7):8):9);",
+    "((c,b,a),(f,(e,d)));",
+  };
+  int nb_trees = sizeof(trees) / sizeof(char*);
+  char filename[] = "/tmp/booster_unit_tests_XXXXXX", errors[sizeof(filename) + 4];
+  char **taxname_lookup_table = NULL, *record;
+  Arena *arena = arena_new(1 << 16);
+  Tree *tree, *loaded;
+  BinTreesWriter *writer;
+  NHReader *reader;
+  BinTaxa *taxa;
+  map_t taxid_map;
+  int i, k, fd, length, nb_nodes, ok = 1;
+  if((fd = mkstemp(filename)) < 0){
+    fprintf(stderr,"Binary trees Test: cannot create a temporary file\n");
+    return EXIT_FAILURE;
+  }
+  close(fd);
+  sprintf(errors, "%s.err", filename);
+
+  /* the taxa of the first tree are the ones of the "reference" */
+  tree = complete_parse_nh(trees[0], &taxname_lookup_table, true);
+  taxid_map = build_taxid_hashmap(taxname_lookup_table, tree->nb_taxa);
+  free_tree(tree);
+  writer = new_bin_trees_writer(filename);
+  for(i = 0; i < nb_trees; i++){
+    arena_reset(arena);
+    bin_trees_write(writer, parse_nh_buffer(trees[i], (int) strlen(trees[i]), arena));
+  }
+  close_bin_trees_writer(writer);
+
+  /* read back: the same trees as the parser gives */
+  reader = nh_reader_open(filename);
+  taxa = new_bin_taxa(reader, taxid_map);
+  ok = reader->format == NH_BINARY && taxa != NULL;
+  for(i = 0; ok && i < nb_trees; i++){
+    arena_reset(arena);
+    record = nh_reader_next(reader, &length);
+    tree = complete_parse_nh_buffer(trees[i], (int) strlen(trees[i]), &taxname_lookup_table, taxid_map, true, arena);
+    loaded = record ? load_bin_tree(record, length, taxa, true, arena) : NULL;
+    ok = loaded != NULL && same_parsed_trees(tree, loaded, trees[i]);
+    for(k = 0; ok && k < tree->nb_nodes; k++) ok = tree->a_nodes[k]->taxon_id == loaded->a_nodes[k]->taxon_id;
+    if(record) nh_reader_release(reader, record);
+  }
+  nh_reader_close(reader);
+  if(!ok){
+    fprintf(stderr,"Binary trees Test: tree %d of the binary set differs from the one written\n", i - 1);
+    return EXIT_FAILURE;
+  }
+
+  /* corrupted records: node 2 is its own father, then the second leaf has the taxon of the first one */
+  reader = nh_reader_open(filename);
+  for(i = 0; i < 2 && ok; i++){
+    int32_t *father, *taxon, first_leaf = -1;
+    arena_reset(arena);
+    record = copy_bin_record(reader, &length);
+    memcpy(&nb_nodes, record, sizeof(int32_t));
+    father = (int32_t*) (record + 2 * sizeof(int32_t) + nb_nodes * sizeof(double));
+    taxon = father + nb_nodes;
+    if(i == 0) father[2] = 2;
+    else
+      for(k = 0; k < nb_nodes; k++){
+        if(taxon[k] < 0) continue;
+        if(first_leaf < 0) first_leaf = taxon[k];
+        else { taxon[k] = first_leaf; break; }
+      }
+    ok = load_bin_tree(record, length, taxa, true, arena) == NULL;
+    free(record);
+  }
+  nh_reader_close(reader);
+  if(!ok){
+    fprintf(stderr,"Binary trees Test: the record with a %s is not rejected\n", i == 1 ? "bad father" : "duplicate taxon");
+    return EXIT_FAILURE;
+  }
+
+  /* the first record, moved by 4 bytes in the index */
+  {
+    FILE *f = fopen(filename, "r+b");
+    NHBinaryHeader header;
+    int64_t offset;
+    ok = f != NULL && fread(&header, sizeof(header), 1, f) == 1 && fseek(f, header.index_offset, SEEK_SET) == 0
+      && fread(&offset, sizeof(offset), 1, f) == 1;
+    offset += 4;
+    ok = ok && fseek(f, header.index_offset, SEEK_SET) == 0 && fwrite(&offset, sizeof(offset), 1, f) == 1;
+    if(f) fclose(f);
+  }
+  ok = ok && child_exit_status(run_nh_reader_open, filename, errors) == EXIT_FAILURE
+    && file_contains(errors, "truncated or corrupted");
+  unlink(filename);
+  unlink(errors);
+  free_bin_taxa(taxa);
+  free_taxid_hashmap(taxid_map);
+  for(i = 0; i < 6; i++) free(taxname_lookup_table[i]);
+  free(taxname_lookup_table);
+  arena_free(arena);
+  if(!ok){
+    fprintf(stderr,"Binary trees Test: a binary set with a misaligned record is not rejected\n");
+    return EXIT_FAILURE;
+  }
+  fprintf(stderr,"Binary trees Test: OK\n");
+  return EXIT_SUCCESS;
+}
+
+
+int main(int argc, char** argv){
+  int exit_code = test_linear_parser();
+  if(exit_code != EXIT_SUCCESS){
+    return(exit_code);
+  }
+
+  exit_code = test_hamming_kernels();
+  if(exit_code != EXIT_SUCCESS){
+    return(exit_code);
+  }
+
+  exit_code = test_bitset_kernels();
+  if(exit_code != EXIT_SUCCESS){
+    return(exit_code);
+  }
+
+  exit_code = test_partial_results();
+  if(exit_code != EXIT_SUCCESS){
+    return(exit_code);
+  }
+
+  exit_code = test_bin_trees();
+  if(exit_code != EXIT_SUCCESS){
+    return(exit_code);
+  }
+
+  return(exit_code);
+}